@@ -26,7 +26,7 @@ brushlib = {}
 AMBIENT_LIGHT = {}
 
 
-function raw_add_brush(brush)
+local function prepare_brush(brush)
   -- check for obsolete crud
   for _,C in pairs(brush) do
     assert(not C.x_offset)
@@ -40,6 +40,13 @@ function raw_add_brush(brush)
 
   brush[1].ambient = AMBIENT_LIGHT[1]
 
+  return brush
+end
+
+
+function raw_add_brush(brush)
+  brush = prepare_brush(brush)
+
   gui.add_brush(brush)
 
   if GAME.add_brush_func then
@@ -48,6 +55,26 @@ function raw_add_brush(brush)
 end
 
 
+function raw_add_brushes(list)
+  -- same as calling raw_add_brush() on each one, but the brushes
+  -- are passed to the CSG code in a single call.
+
+  local prepared = {}
+
+  for _,B in ipairs(list) do
+    table.insert(prepared, prepare_brush(B))
+  end
+
+  gui.add_brushes(prepared)
+
+  if GAME.add_brush_func then
+    for _,B in ipairs(prepared) do
+      GAME.add_brush_func(B)
+    end
+  end
+end
+
+
 function raw_add_entity(ent)
   -- skip unknown entities (from wad-fab loader)
   if not ent.id or (ent.id and ent.id == 0) then return end
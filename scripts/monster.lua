@@ -1194,9 +1194,15 @@ function Monster_fill_room(R)
       local pdx = math.sin(ang * math.pi / 180) * 48
       local pdy = math.cos(ang * math.pi / 180) * 48
 
-      if gui.trace_ray(mx, my, mz, ax + pdx, ay + pdy, az, "v") and
-         gui.trace_ray(mx, my, mz, ax - pdx, ay - pdy, az, "v")
-      then
+      local rays =
+      {
+        mx, my, mz, ax + pdx, ay + pdy, az,
+        mx, my, mz, ax - pdx, ay - pdy, az
+      }
+
+      local hits = gui.trace_rays(rays, "v")
+
+      if hits[1] and hits[2] then
         spot.ambush = ambush_focus
       end
       ::continue::
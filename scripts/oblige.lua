@@ -1648,6 +1648,8 @@ function ob_build_cool_shit()
   assert(OB_CONFIG.game)
 
   if OB_CONFIG.engine == "vanilla" then
+    -- SLUMP's random streams are keyed by the twister seed, so seed it here too
+    gui.rand_seed(OB_CONFIG.seed)
     ob_invoke_hook("setup")
     return "ok" 
   end -- Skip the rest if using Vanilla Doom/SLUMP
@@ -767,12 +767,16 @@ function Fab_render(fab)
     fab_map = "object"
   end
 
+  local brushes = {}
+
   for _,B in pairs(fab.brushes) do
     if B[1].m ~= "spot" then
-      raw_add_brush(B)
+      table.insert(brushes, B)
     end
   end
 
+  raw_add_brushes(brushes)
+
   for _,M in pairs(fab.models) do
     raw_add_model(M)
   end
@@ -1062,6 +1066,9 @@ DOOM_TWO_SIDED_FLAG = 0x04
 function Fab_load_wad(def)
   local fab
 
+  -- the whole wad-fab map, from gui.wadfab_export()
+  local wad
+
 
   local function convert_offset(raw_val)
     if raw_val == nil then return nil end
@@ -1098,14 +1105,14 @@ function Fab_load_wad(def)
     local side
     local line
 
-    if C.side then side = gui.wadfab_get_side(C.side) end
-    if C.line then line = gui.wadfab_get_line(C.line) end
+    if C.side then side = wad.sides[C.side + 1] end
+    if C.line then line = wad.lines[C.line + 1] end
 
     -- get other sector (which the polygon side faces)
     local other_sec
 
     if line and side and side.sector then
-      other_sec = gui.wadfab_get_sector(side.sector)
+      other_sec = wad.sectors[side.sector + 1]
     end
 
     local flags = (line and line.flags) or 0
@@ -1208,14 +1215,14 @@ function Fab_load_wad(def)
     local side
     local line
 
-    if C.side then side = gui.wadfab_get_side(C.side) end
-    if C.line then line = gui.wadfab_get_line_hexen(C.line) end
+    if C.side then side = wad.sides[C.side + 1] end
+    if C.line then line = wad.lines[C.line + 1] end
 
     -- get other sector (which the polygon side faces)
     local other_sec
 
     if line and side and side.sector then
-      other_sec = gui.wadfab_get_sector(side.sector)
+      other_sec = wad.sectors[side.sector + 1]
     end
 
     local flags = (line and line.flags) or 0
@@ -1654,12 +1661,12 @@ function Fab_load_wad(def)
     local z
 
     do
-      local side1 = gui.wadfab_get_side(L.left)
-      local side2 = gui.wadfab_get_side(L.right)
+      local side1 = wad.sides[L.left + 1]
+      local side2 = wad.sides[L.right + 1]
       assert(side1 and side2)
 
-      local S1 = gui.wadfab_get_sector(side1.sector)
-      local S2 = gui.wadfab_get_sector(side2.sector)
+      local S1 = wad.sectors[side1.sector + 1]
+      local S2 = wad.sectors[side2.sector + 1]
       assert(S1 and S2)
 
       local z1 = S1.floor_h
@@ -1684,14 +1691,14 @@ function Fab_load_wad(def)
     end
 
     for pass = 1, 2 do
-      local side = gui.wadfab_get_side(sel(pass == 1, L.right, L.left))
+      local side = wad.sides[sel(pass == 1, L.right, L.left) + 1]
       assert(side)
 
       -- check for a railing texture on this side
       local tex = side.mid_tex
       if tex == nil or tex == "" or tex == "-" then goto continue end
 
-      local S = gui.wadfab_get_sector(side.sector)
+      local S = wad.sectors[side.sector + 1]
       assert(S)
 
       local x1, y1 = L.x1, L.y1
@@ -1742,65 +1749,45 @@ function Fab_load_wad(def)
     -- [ if map is not specified, use "*" to load the first one ]
     gui.wadfab_load(filename, def.map or "*")
 
-    local E
-
-    for thing_idx = 0,9999 do
-      if OB_CONFIG.game == "hexen" then
-        E = gui.wadfab_get_thing_hexen(thing_idx)
-      else
-        E = gui.wadfab_get_thing(thing_idx)
-      end
+    wad = gui.wadfab_export(OB_CONFIG.game == "hexen")
 
-      -- nil result marks the end
-      if not E then break; end
+    gui.wadfab_free()
 
+    for _,E in ipairs(wad.things) do
       handle_entity(fab, E)
     end
 
-    for poly_idx = 0,9999 do
-      local sec_idx, coords = gui.wadfab_get_polygon(poly_idx)
-
-      -- nil result marks the end
-      if not sec_idx then break; end
-
+    for _,P in ipairs(wad.polygons) do
       -- negative value means "void" space
-      if sec_idx < 0 then
-        create_void_brush(coords)
+      if P.sector < 0 then
+        create_void_brush(P.coords)
         goto continue
       end
 
-      local S = gui.wadfab_get_sector(sec_idx)
+      local S = wad.sectors[P.sector + 1]
       assert(S)
 
-      create_brush(S, coords, 1)  -- floor
-      create_brush(S, coords, 2)  -- ceil
+      -- sectors are shared between polygons, but light brushes
+      -- modify theirs
+      if S.special == WADFAB_LIGHT_BRUSH then
+        S = table.copy(S)
+      end
 
-      -- check for 3D floors
-      for fl_idx = 0,9 do
-        local exfl = gui.wadfab_get_3d_floor(poly_idx, fl_idx)
-        if not exfl then break; end
+      create_brush(S, P.coords, 1)  -- floor
+      create_brush(S, P.coords, 2)  -- ceil
 
-        create_3d_floor(exfl, coords)
+      -- check for 3D floors
+      for _,exfl in ipairs(P.floors or {}) do
+        create_3d_floor(exfl, P.coords)
       end
       ::continue::
     end
-    
-    local L
-
-    for line_idx = 0,9999 do
-      if OB_CONFIG.game == "hexen" then
-        L = gui.wadfab_get_line_hexen(line_idx)
-      else
-        L = gui.wadfab_get_line(line_idx)
-      end
-
-      -- nil result marks the end
-      if not L then break; end
 
+    for _,L in ipairs(wad.lines) do
       handle_railing(fab, L)
     end
 
-    gui.wadfab_free()
+    wad = nil
 
     Fab_determine_bbox(fab)
 
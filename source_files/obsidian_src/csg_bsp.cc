@@ -19,6 +19,9 @@
 //------------------------------------------------------------------------
 
 #include <algorithm>
+#include <atomic>
+#include <climits>
+#include <mutex>
 
 #include "csg_local.h"
 #include "csg_main.h"
@@ -27,6 +30,7 @@
 #include "hdr_fltk.h"
 #include "hdr_lua.h"
 #include "headers.h"
+#include "lib_parallel.h"
 #include "lib_util.h"
 #include "m_lua.h"
 #include "main.h"
@@ -37,16 +41,23 @@ static bool csg_is_clip_hull;
 
 static std::vector<region_c *> dead_regions;
 
+static unsigned int partition_serial = 0;
+
 class partition_c {
    public:
     double x1, y1;
     double x2, y2;
 
+    // creation order, gives HandleOverlaps() a stable ordering.
+    // this is set when added to 'all_partitions'.
+    unsigned int serial;
+
    public:
     partition_c(double _x1, double _y1, double _x2, double _y2)
-        : x1(_x1), y1(_y1), x2(_x2), y2(_y2) {}
+        : x1(_x1), y1(_y1), x2(_x2), y2(_y2), serial(0) {}
 
-    partition_c(const snag_c *S) : x1(S->x1), y1(S->y1), x2(S->x2), y2(S->y2) {}
+    partition_c(const snag_c *S)
+        : x1(S->x1), y1(S->y1), x2(S->x2), y2(S->y2), serial(0) {}
 
     ~partition_c() {}
 };
@@ -529,7 +540,7 @@ struct csg_brush_ptr_Compare {
         }
 
         // tie breaker
-        return A < B;
+        return A->serial < B->serial;
     }
 };
 
@@ -643,6 +654,53 @@ std::vector<region_c *> all_regions;
 
 bsp_node_c *bsp_root;
 
+// the things created while splitting a group.  Both halves of a group
+// may be split in parallel, so instead of the global lists they go
+// here, and get added to the global lists in the same order as a
+// serial split would have done.
+class split_output_c {
+   public:
+    std::vector<region_c *> regions;
+    std::vector<partition_c *> partitions;
+
+    // number of snags in each degenerated region, for the warnings
+    std::vector<int> degenerates;
+
+    int lost_entities = 0;
+
+   public:
+    void Append(split_output_c &other) {
+        regions.insert(regions.end(), other.regions.begin(),
+                       other.regions.end());
+        partitions.insert(partitions.end(), other.partitions.begin(),
+                          other.partitions.end());
+        degenerates.insert(degenerates.end(), other.degenerates.begin(),
+                           other.degenerates.end());
+
+        lost_entities += other.lost_entities;
+    }
+
+    void Flush() {
+        for (region_c *R : regions) {
+            all_regions.push_back(R);
+        }
+
+        for (partition_c *part : partitions) {
+            part->serial = partition_serial++;
+
+            all_partitions.push_back(part);
+        }
+
+        for (int num_snags : degenerates) {
+            LogPrintf("WARNING: region degenerated ({} snags)\n", num_snags);
+        }
+
+        if (lost_entities > 0) {
+            DebugPrintf("SplitGroup: lost {} entities\n", lost_entities);
+        }
+    }
+};
+
 //------------------------------------------------------------------------
 
 static void QuantizeVert(const brush_vert_c *V, int *qx, int *qy) {
@@ -916,7 +974,7 @@ static void DivideOneSnag(snag_c *S, partition_c *part, region_c *front,
 }
 
 static void DivideOneRegion(region_c *R, partition_c *part, group_c &front,
-                            group_c &back) {
+                            group_c &back, split_output_c &out) {
     SYS_ASSERT(!R->snags.empty());
 
     int side = R->TestSide(part);
@@ -933,7 +991,7 @@ static void DivideOneRegion(region_c *R, partition_c *part, group_c &front,
 
     region_c *N = new region_c(*R);
 
-    all_regions.push_back(N);
+    out.regions.push_back(N);
 
     // iterate over a swapped-out version of the region's snags
     // (so we can safely add certain ones back into R->snags)
@@ -972,14 +1030,14 @@ static void DivideOneRegion(region_c *R, partition_c *part, group_c &front,
 
     if (R->snags.size() < 3) {
         R->degenerate = true;
-        LogPrintf("WARNING: region degenerated ({} snags)\n", R->snags.size());
+        out.degenerates.push_back((int)R->snags.size());
     } else {
         front.AddRegion(R);
     }
 
     if (N->snags.size() < 3) {
         N->degenerate = true;
-        LogPrintf("WARNING: region degenerated ({} snags)\n", N->snags.size());
+        out.degenerates.push_back((int)N->snags.size());
     } else {
         back.AddRegion(N);
     }
@@ -1006,19 +1064,21 @@ static region_c *MergeGroup(group_c &group) {
     return R;
 }
 
-static partition_c *AddPartition(const snag_c *S) {
-    all_partitions.push_back(new partition_c(S));
+static partition_c *AddPartition(const snag_c *S, split_output_c &out) {
+    out.partitions.push_back(new partition_c(S));
 
-    return all_partitions.back();
+    return out.partitions.back();
 }
 
-static partition_c *AddPartition(double x1, double y1, double x2, double y2) {
-    all_partitions.push_back(new partition_c(x1, y1, x2, y2));
+static partition_c *AddPartition(double x1, double y1, double x2, double y2,
+                                 split_output_c &out) {
+    out.partitions.push_back(new partition_c(x1, y1, x2, y2));
 
-    return all_partitions.back();
+    return out.partitions.back();
 }
 
-static partition_c *ChoosePartition(group_c &group, bool *reached_chunk) {
+static partition_c *ChoosePartition(group_c &group, bool *reached_chunk,
+                                    split_output_c &out) {
     if (!*reached_chunk) {
         // seed-wise binary subdivision thang
         //
@@ -1046,10 +1106,10 @@ static partition_c *ChoosePartition(group_c &group, bool *reached_chunk) {
         if (sw >= 2 || sh >= 2) {
             if (sw >= sh) {
                 double px = (sx1 + sw / 2) * CHUNK_SIZE;
-                return AddPartition(px, gy1, px, MAX(gy2, gy1 + 4));
+                return AddPartition(px, gy1, px, MAX(gy2, gy1 + 4), out);
             } else {
                 double py = (sy1 + sh / 2) * CHUNK_SIZE;
-                return AddPartition(gx1, py, MAX(gx2, gx1 + 4), py);
+                return AddPartition(gx1, py, MAX(gx2, gx1 + 4), py, out);
             }
         }
 
@@ -1079,7 +1139,7 @@ static partition_c *ChoosePartition(group_c &group, bool *reached_chunk) {
             // we prefer an axis-aligned node
             if (S->x1 == S->x2 || S->y1 == S->y2) {
                 // look no further
-                return AddPartition(S);
+                return AddPartition(S, out);
             }
 
             poss = S;
@@ -1087,7 +1147,7 @@ static partition_c *ChoosePartition(group_c &group, bool *reached_chunk) {
     }
 
     if (poss) {
-        return AddPartition(poss);
+        return AddPartition(poss, out);
     }
 
     return NULL;
@@ -1104,16 +1164,30 @@ static void DivideOneEntity(csg_entity_c *E, partition_c *part, group_c &front,
     }
 }
 
-static void SplitGroup(group_c &group, bool reached_chunk, region_c **leaf_out,
-                       bsp_node_c **node_out) {
+// how many more threads (besides the one calling CSG_BSP) SplitGroup()
+// may start, so the split never runs on more than PAR_NumWorkers().
+static std::atomic<int> split_threads_left;
+
+static bool TakeSplitThread() {
+    int left = split_threads_left.load();
+
+    while (left > 0) {
+        if (split_threads_left.compare_exchange_weak(left, left - 1)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void SplitGroup(group_c &group, bool reached_chunk,
+                       region_c **leaf_out, bsp_node_c **node_out,
+                       split_output_c &out) {
     *leaf_out = NULL;
     *node_out = NULL;
 
     if (group.regs.empty()) {
-        if (!group.ents.empty()) {
-            DebugPrintf("SplitGroup: lost {} entities\n", group.ents.size());
-        }
-
+        out.lost_entities += (int)group.ents.size();
         return;
     }
 
@@ -1122,7 +1196,7 @@ static void SplitGroup(group_c &group, bool reached_chunk, region_c **leaf_out,
     //       region will usually be "split" multiple times where everything
     //       goes to the front and nothing to the back.
     //
-    partition_c *part = ChoosePartition(group, &reached_chunk);
+    partition_c *part = ChoosePartition(group, &reached_chunk, out);
 
     if (part) {
         //    fprintf(stderr, "Partition: %p (%1.2f %1.2f) --> (%1.2f %1.2f)\n",
@@ -1133,7 +1207,7 @@ static void SplitGroup(group_c &group, bool reached_chunk, region_c **leaf_out,
         group_c back;
 
         for (unsigned int i = 0; i < group.regs.size(); i++) {
-            DivideOneRegion(group.regs[i], part, front, back);
+            DivideOneRegion(group.regs[i], part, front, back, out);
         }
 
         for (unsigned int k = 0; k < group.ents.size(); k++) {
@@ -1146,9 +1220,30 @@ static void SplitGroup(group_c &group, bool reached_chunk, region_c **leaf_out,
         bsp_node_c *front_node;
         bsp_node_c *back_node;
 
-        // recursively handle each side
-        SplitGroup(front, reached_chunk, &front_leaf, &front_node);
-        SplitGroup(back, reached_chunk, &back_leaf, &back_node);
+        // recursively handle each side.  the two sides do not depend
+        // on each other, so above the chunk level the back half gets a
+        // thread of its own while there is one to spare.  with two or
+        // more workers PAR_ForEach(2) starts exactly one thread.
+        if (!reached_chunk && TakeSplitThread()) {
+            split_output_c back_out;
+
+            PAR_ForEach(2, [&](int index, int worker) {
+                if (index == 0) {
+                    SplitGroup(front, reached_chunk, &front_leaf,
+                               &front_node, out);
+                } else {
+                    SplitGroup(back, reached_chunk, &back_leaf, &back_node,
+                               back_out);
+                }
+            });
+
+            split_threads_left++;
+
+            out.Append(back_out);
+        } else {
+            SplitGroup(front, reached_chunk, &front_leaf, &front_node, out);
+            SplitGroup(back, reached_chunk, &back_leaf, &back_node, out);
+        }
 
         // don't create a node unless there is something on both sides
         if (!(front_leaf || front_node)) {
@@ -1180,7 +1275,137 @@ static void SplitGroup(group_c &group, bool reached_chunk, region_c **leaf_out,
 
 //------------------------------------------------------------------------
 
-static void MergeSnags(snag_c *A, snag_c *B) {
+// a change to a region's snags, see overlap_list_c
+struct snag_change_t {
+    region_c *region;
+    snag_c *snag;
+
+    // false when the snag was merged away, it gets freed too
+    bool added;
+};
+
+// the snags which lie on a single partition.  Each partition is done
+// separately (and in parallel), so instead of touching the regions
+// (which can have snags on several partitions) the changes are kept
+// here, and applied once all the earlier partitions have been done.
+class overlap_list_c {
+   public:
+    // split pieces get added to the end, merged snags become NULL
+    std::vector<snag_c *> snags;
+
+    std::vector<snag_change_t> changes;
+
+   private:
+    // a binary tree over the list positions, where each node has the
+    // range of along values covered by the snags beneath it.  This
+    // lets us find the snags which overlap a given one without testing
+    // every pair.  Leaves begin at index 'num_leaf'.
+    int num_leaf = 0;
+
+    std::vector<int> min_along;
+    std::vector<int> max_along;
+
+   public:
+    void BuildIndex() {
+        num_leaf = 1;
+
+        while (num_leaf < (int)snags.size() * 2) {
+            num_leaf *= 2;
+        }
+
+        min_along.assign(num_leaf * 2, INT_MAX);
+        max_along.assign(num_leaf * 2, INT_MIN);
+
+        for (unsigned int pos = 0; pos < snags.size(); pos++) {
+            SetLeaf((int)pos);
+        }
+
+        for (int node = num_leaf - 1; node > 0; node--) {
+            PullUp(node);
+        }
+    }
+
+    // must be called whenever the snag at a position is changed
+    void UpdateIndex(int pos) {
+        if (num_leaf == 0) {
+            return;
+        }
+
+        if (pos >= num_leaf) {
+            BuildIndex();
+            return;
+        }
+
+        SetLeaf(pos);
+
+        for (int node = (num_leaf + pos) / 2; node > 0; node /= 2) {
+            PullUp(node);
+        }
+    }
+
+    // finds the first snag at or after 'from' whose along range
+    // overlaps the snag at position 'pos', returns -1 if none.
+    int NextOverlap(int from, int pos) const {
+        // without an index, every snag is a candidate
+        if (num_leaf == 0) {
+            return (from < (int)snags.size()) ? from : -1;
+        }
+
+        const snag_c *A = snags[pos];
+
+        int lo = MIN(A->q_along1, A->q_along2);
+        int hi = MAX(A->q_along1, A->q_along2);
+
+        return DoNextOverlap(1, 0, num_leaf, from, lo, hi);
+    }
+
+   private:
+    void SetLeaf(int pos) {
+        const snag_c *S = snags[pos];
+        int leaf = num_leaf + pos;
+
+        if (S) {
+            min_along[leaf] = MIN(S->q_along1, S->q_along2);
+            max_along[leaf] = MAX(S->q_along1, S->q_along2);
+        } else {
+            min_along[leaf] = INT_MAX;
+            max_along[leaf] = INT_MIN;
+        }
+    }
+
+    void PullUp(int node) {
+        min_along[node] = MIN(min_along[node * 2], min_along[node * 2 + 1]);
+        max_along[node] = MAX(max_along[node * 2], max_along[node * 2 + 1]);
+    }
+
+    int DoNextOverlap(int node, int node_lo, int node_hi, int from, int lo,
+                      int hi) const {
+        if (node_hi <= from) {
+            return -1;
+        }
+
+        // same test as in TestOverlap()
+        if (min_along[node] >= hi || max_along[node] <= lo) {
+            return -1;
+        }
+
+        if (node >= num_leaf) {
+            return node - num_leaf;
+        }
+
+        int mid = (node_lo + node_hi) / 2;
+
+        int result = DoNextOverlap(node * 2, node_lo, mid, from, lo, hi);
+
+        if (result < 0) {
+            result = DoNextOverlap(node * 2 + 1, mid, node_hi, from, lo, hi);
+        }
+
+        return result;
+    }
+};
+
+static void MergeSnags(snag_c *A, snag_c *B, overlap_list_c &list) {
     SYS_ASSERT(A->region);
     SYS_ASSERT(B->region);
 
@@ -1197,7 +1422,7 @@ static void MergeSnags(snag_c *A, snag_c *B) {
         B->partner->partner = NULL;
     }
 
-    B->region->RemoveSnag(B);
+    list.changes.push_back({B->region, B, false});
 }
 
 static void PartnerSnags(snag_c *A, snag_c *B) {
@@ -1205,13 +1430,12 @@ static void PartnerSnags(snag_c *A, snag_c *B) {
     B->partner = A;
 }
 
-static bool SplitSnag(snag_c *S, double ix, double iy,
-                      std::vector<snag_c *> &overlap_list) {
+static bool SplitSnag(snag_c *S, double ix, double iy, overlap_list_c &list) {
     snag_c *T = S->Cut(ix, iy);
 
-    S->region->AddSnag(T);
+    list.changes.push_back({T->region, T, true});
 
-    overlap_list.push_back(T);
+    list.snags.push_back(T);
 
     S->CalcAlongs();
     T->CalcAlongs();
@@ -1219,9 +1443,9 @@ static bool SplitSnag(snag_c *S, double ix, double iy,
     return true;
 }
 
-static bool TestOverlap(std::vector<snag_c *> &list, int i, int k) {
-    snag_c *A = list[i];
-    snag_c *B = list[k];
+static bool TestOverlap(overlap_list_c &list, int i, int k) {
+    snag_c *A = list.snags[i];
+    snag_c *B = list.snags[k];
 
     if (!A || !B) {
         return false;
@@ -1264,11 +1488,10 @@ static bool TestOverlap(std::vector<snag_c *> &list, int i, int k) {
 
     // same direction?
     if (A->q_along1 == B->q_along1) {
-        MergeSnags(A, B);
+        MergeSnags(A, B, list);
 
-        // remove B from list and free it
-        delete B;
-        list[k] = NULL;
+        // remove B from list (it gets freed later)
+        list.snags[k] = NULL;
 
         return true;
     } else {
@@ -1279,16 +1502,17 @@ static bool TestOverlap(std::vector<snag_c *> &list, int i, int k) {
     }
 }
 
-static void ProcessOverlapList(std::vector<snag_c *> &overlap_list) {
-    ///??  partition_c *part = overlap_list[0]->on_node;
-
-    //  fprintf(stderr, "ProcessOverlapList: %u snags\n", overlap_list.size());
+static void ProcessOverlapList(overlap_list_c &list) {
+    std::vector<snag_c *> &snags = list.snags;
 
-    for (unsigned int i = 0; i < overlap_list.size(); i++) {
-        overlap_list[i]->CalcAlongs();
+    for (unsigned int i = 0; i < snags.size(); i++) {
+        snags[i]->CalcAlongs();
     }
 
-    // TODO: sort list by MIN(q_along), take advantage of that
+    // small lists are quicker to check without an index
+    if (snags.size() >= 32) {
+        list.BuildIndex();
+    }
 
     int changes;
 
@@ -1296,36 +1520,48 @@ static void ProcessOverlapList(std::vector<snag_c *> &overlap_list) {
         changes = 0;
 
 #if 0
-		for (int z = 0 ; z < (int)overlap_list.size() ; z++)
+		for (int z = 0 ; z < (int)snags.size() ; z++)
 			fprintf(stderr, "    snag %p : (%1.0f %1.0f) --> (%1.0f %1.0f)  partner %p\n",
-					overlap_list[z],
-					overlap_list[z] ? overlap_list[z]->x1 : 0,
-					overlap_list[z] ? overlap_list[z]->y1 : 0,
-					overlap_list[z] ? overlap_list[z]->x2 : 0,
-					overlap_list[z] ? overlap_list[z]->y2 : 0,
-					overlap_list[z] ? overlap_list[z]->partner : NULL);
+					snags[z],
+					snags[z] ? snags[z]->x1 : 0,
+					snags[z] ? snags[z]->y1 : 0,
+					snags[z] ? snags[z]->x2 : 0,
+					snags[z] ? snags[z]->y2 : 0,
+					snags[z] ? snags[z]->partner : NULL);
 #endif
 
         // Note that new snags may get added (due to splits) while we are
         // iterating over them.  Removed snags become NULL in the list.
+        //
+        // Only the pairs which overlap are visited, but in the same
+        // order as testing every pair would, so the results are the
+        // same (and do not depend on the other partitions).
 
-        for (int i = 0; i < (int)overlap_list.size(); i++) {
-            for (int k = i + 1; k < (int)overlap_list.size(); k++) {
-                if (TestOverlap(overlap_list, i, k)) {
+        for (int i = 0; i < (int)snags.size(); i++) {
+            if (!snags[i]) {
+                continue;
+            }
+
+            for (int k = list.NextOverlap(i + 1, i); k >= 0;
+                 k = list.NextOverlap(k + 1, i)) {
+                int old_size = (int)snags.size();
+
+                if (TestOverlap(list, i, k)) {
                     changes++;
                 }
+
+                list.UpdateIndex(i);
+                list.UpdateIndex(k);
+
+                for (int pos = old_size; pos < (int)snags.size(); pos++) {
+                    list.UpdateIndex(pos);
+                }
             }
         }
 
     } while (changes > 0);
 }
 
-struct snag_on_node_Compare {
-    inline bool operator()(const snag_c *A, const snag_c *B) const {
-        return A->on_node < B->on_node;
-    }
-};
-
 static void CollectAllSnags(std::vector<snag_c *> &list) {
     for (unsigned int i = 0; i < all_regions.size(); i++) {
         region_c *R = all_regions[i];
@@ -1344,41 +1580,100 @@ static void CollectAllSnags(std::vector<snag_c *> &list) {
     }
 }
 
+static void ApplyOverlapList(overlap_list_c &list) {
+    for (const snag_change_t &change : list.changes) {
+        if (change.added) {
+            change.region->AddSnag(change.snag);
+        } else {
+            change.region->RemoveSnag(change.snag);
+            delete change.snag;
+        }
+    }
+
+    // free the memory now
+    list = overlap_list_c();
+}
+
 static void HandleOverlaps() {
-    // process each set of snags which lie on the same partition
-    // (determined by sorting the snags by their 'on_node' pointer).
+    // process each set of snags which lie on the same partition,
+    // ordered by the 'serial' of the partition.
 
     std::vector<snag_c *> all_snags;
 
     CollectAllSnags(all_snags);
 
-    std::sort(all_snags.begin(), all_snags.end(), snag_on_node_Compare());
+    unsigned int min_serial = UINT_MAX;
+    unsigned int max_serial = 0;
 
-    unsigned int i, k;
-    unsigned int total = all_snags.size();
+    for (const snag_c *S : all_snags) {
+        if (S->on_node) {
+            min_serial = MIN(min_serial, S->on_node->serial);
+            max_serial = MAX(max_serial, S->on_node->serial);
+        }
+    }
+
+    if (min_serial > max_serial) {
+        return;
+    }
 
-    for (i = 0; i < total; i = k + 1) {
-        k = i;
+    // bucket the snags by partition, keeping them in the same order
+    std::vector<unsigned int> first(max_serial - min_serial + 2, 0);
 
-        while (k + 1 < total &&
-               all_snags[k + 1]->on_node == all_snags[k]->on_node) {
-            k++;
+    for (const snag_c *S : all_snags) {
+        if (S->on_node) {
+            first[S->on_node->serial - min_serial + 1] += 1;
         }
+    }
 
-        // fprintf(stderr, "ON NODE %p : %u snags\n", all_snags[i]->on_node,
-        // k-i+1);
+    int num_lists = 0;
 
-        if (k > i && all_snags[i]->on_node) {
-            // copy into a new list, a place where split pieces can go
-            std::vector<snag_c *> overlap_list;
+    for (unsigned int b = 1; b < first.size(); b++) {
+        if (first[b] > 1) {
+            num_lists++;
+        }
 
-            for (; i <= k; i++) {
-                overlap_list.push_back(all_snags[i]);
-            }
+        first[b] += first[b - 1];
+    }
+
+    std::vector<snag_c *> sorted(first.back());
+    std::vector<unsigned int> next(first.begin(), first.end() - 1);
 
-            ProcessOverlapList(overlap_list);
+    for (snag_c *S : all_snags) {
+        if (S->on_node) {
+            sorted[next[S->on_node->serial - min_serial]++] = S;
         }
     }
+
+    // copy each set into a new list, a place where split pieces can go
+    std::vector<overlap_list_c> lists(num_lists);
+
+    num_lists = 0;
+
+    for (unsigned int b = 0; b + 1 < first.size(); b++) {
+        if (first[b + 1] - first[b] > 1) {
+            lists[num_lists++].snags.assign(sorted.begin() + first[b],
+                                            sorted.begin() + first[b + 1]);
+        }
+    }
+
+    // the changes to the regions are applied in the same order as a
+    // serial pass would, by whichever worker finishes the next list.
+    std::mutex apply_mutex;
+    std::vector<bool> finished(lists.size(), false);
+    unsigned int next_apply = 0;
+
+    PAR_ForEach((int)lists.size(), [&](int index, int worker) {
+        ProcessOverlapList(lists[index]);
+
+        std::lock_guard<std::mutex> lock(apply_mutex);
+
+        finished[index] = true;
+
+        while (next_apply < lists.size() && finished[next_apply]) {
+            ApplyOverlapList(lists[next_apply]);
+            next_apply++;
+        }
+    });
 }
 
 static void AddBoundingRegion(group_c &group) {
@@ -1713,7 +2008,10 @@ static void SpreadReachability(void) {
     //            further.  Then all gaps without the flag are
     //            unreachable and should be filled.
 
-    // firstly, allow brushes to force reachable flag
+    // firstly, allow brushes to force reachable flag, and collect
+    // the gaps which start out reachable.
+
+    std::vector<gap_c *> work;
 
     for (unsigned int i = 0; i < all_regions.size(); i++) {
         region_c *R = all_regions[i];
@@ -1721,39 +2019,44 @@ static void SpreadReachability(void) {
         for (unsigned int k = 0; k < R->gaps.size(); k++) {
             gap_c *G = R->gaps[k];
 
-            if (!(G->bottom->t.face.getStr("reachable")).empty() ||
-                !(G->top->b.face.getStr("reachable")).empty()) {
+            if (!(G->bottom->t.face.getStr(ATOM_reachable)).empty() ||
+                !(G->top->b.face.getStr(ATOM_reachable)).empty()) {
                 G->reachable = true;
             }
+
+            if (G->reachable) {
+                work.push_back(G);
+            }
         }
     }
 
-    int changes;
+    // secondly, a breadth-first spread, which visits each gap once.
+    // the number of rounds is (at most) how many times the whole map
+    // would need to be rescanned until nothing changed.
 
-    do {
-        changes = 0;
+    int rounds = 0;
+    size_t round_end = 0;
 
-        for (unsigned int i = 0; i < all_regions.size(); i++) {
-            region_c *R = all_regions[i];
-
-            for (unsigned int k = 0; k < R->gaps.size(); k++) {
-                gap_c *G = R->gaps[k];
+    for (size_t pos = 0; pos < work.size(); pos++) {
+        if (pos == round_end) {
+            rounds++;
+            round_end = work.size();
+        }
 
-                if (!G->reachable) {
-                    continue;
-                }
+        gap_c *G = work[pos];
 
-                for (unsigned int n = 0; n < G->neighbors.size(); n++) {
-                    gap_c *H = G->neighbors[n];
+        for (unsigned int n = 0; n < G->neighbors.size(); n++) {
+            gap_c *H = G->neighbors[n];
 
-                    if (!H->reachable) {
-                        H->reachable = true;
-                        changes++;
-                    }
-                }
+            if (!H->reachable) {
+                H->reachable = true;
+                work.push_back(H);
             }
         }
-    } while (changes > 0);
+    }
+
+    DebugPrintf("SpreadReachability: {} gaps reachable, {} rounds\n",
+                work.size(), rounds);
 }
 
 static void RemoveUnusedGaps() {
@@ -1911,6 +2214,16 @@ void CSG_BSP(double grid, bool is_clip_hull) {
 
     csg_is_clip_hull = is_clip_hull;
 
+    // time taken by each phase, logged at the end
+    u32_t phase_time[6];
+    u32_t last_time = TimeGetMillies();
+
+    auto end_phase = [&](int phase) {
+        u32_t now = TimeGetMillies();
+        phase_time[phase] = now - last_time;
+        last_time = now;
+    };
+
     group_c root;
 
     // create a region for every brush
@@ -1925,9 +2238,18 @@ void CSG_BSP(double grid, bool is_clip_hull) {
     // create a rectangle region around whole map
     AddBoundingRegion(root);
 
+    end_phase(0);
+
     region_c *bsp_leaf;
 
-    SplitGroup(root, false /* reached_chunk */, &bsp_leaf, &bsp_root);
+    split_threads_left = PAR_NumWorkers() - 1;
+
+    split_output_c split_out;
+
+    SplitGroup(root, false /* reached_chunk */, &bsp_leaf, &bsp_root,
+               split_out);
+
+    split_out.Flush();
 
     // all valid maps will get a root node -- this is only for sanity
     if (!bsp_root) {
@@ -1936,8 +2258,12 @@ void CSG_BSP(double grid, bool is_clip_hull) {
 
     bsp_root->ComputeBBox();
 
+    end_phase(1);
+
     HandleOverlaps();
 
+    end_phase(2);
+
     RemoveDeadRegions();
 
     for (unsigned int i = 0; i < all_regions.size(); i++) {
@@ -1948,21 +2274,80 @@ void CSG_BSP(double grid, bool is_clip_hull) {
         R->ClockwiseSnags();
     }
 
+    end_phase(3);
+
     CSG_SwallowBrushes();
 
+    end_phase(4);
+
     CSG_DiscoverGaps();
 
+    end_phase(5);
+
+    LogPrintf(
+        "CSG BSP: {} regions, times (ms): create {}, split {}, overlaps {}, "
+        "tidy {}, swallow {}, gaps {}\n",
+        all_regions.size(), phase_time[0], phase_time[1], phase_time[2],
+        phase_time[3], phase_time[4], phase_time[5]);
+
 #if 0
 	fprintf(stderr, "CSG BSP Tree:\n");
 	DumpCSGTree(bsp_root);
 #endif
 }
 
+// points closer than this to a partition are looked for on both sides,
+// since ContainsPoint() allows a little slop around each region.
+#define POINT_PART_EPSILON 1.0
+
+static void PointInRegion_Visit(const bsp_node_c *node, region_c *leaf,
+                                double x, double y, region_c **found,
+                                int *count) {
+    if (leaf) {
+        if (!leaf->degenerate && leaf->ContainsPoint(x, y)) {
+            if (*count == 0) {
+                *found = leaf;
+            }
+            *count += 1;
+        }
+        return;
+    }
+
+    if (!node) {
+        return;
+    }
+
+    double d = PerpDist(x, y, node->x1, node->y1, node->x2, node->y2);
+
+    if (d > -POINT_PART_EPSILON) {
+        PointInRegion_Visit(node->front_node, node->front_leaf, x, y, found,
+                            count);
+    }
+    if (d < POINT_PART_EPSILON) {
+        PointInRegion_Visit(node->back_node, node->back_leaf, x, y, found,
+                            count);
+    }
+}
+
 region_c *CSG_PointInRegion(double x, double y) {
+    // descend the BSP tree, which normally finds a single region
+    region_c *found = NULL;
+    int count = 0;
+
+    PointInRegion_Visit(bsp_root, NULL, x, y, &found, &count);
+
+    if (count == 1) {
+        return found;
+    }
+
+    // the point lies on the boundary between regions (or was not
+    // found at all), so fall back to checking every region, which
+    // prefers the earliest one.  Degenerate regions are skipped here
+    // too, so both paths agree.
     for (unsigned int i = 0; i < all_regions.size(); i++) {
         region_c *R = all_regions[i];
 
-        if (R->ContainsPoint(x, y)) {
+        if (!R->degenerate && R->ContainsPoint(x, y)) {
             return R;
         }
     }
@@ -2054,7 +2439,7 @@ void CSG_TestRegions_Doom() {
         if (R->brushes.size() > 0) {
             csg_brush_c *B = R->brushes[0];
 
-            flat = B->t.face.getStr("tex", "FLAT10");
+            flat = B->t.face.getStr(ATOM_tex, "FLAT10");
         }
 
         int sec_id = DM_NumSectors();
@@ -19,6 +19,9 @@
 //------------------------------------------------------------------------
 
 #include <algorithm>
+#include <chrono>
+#include <deque>
+#include <unordered_map>
 
 #include "csg_local.h"
 #include "csg_main.h"
@@ -162,6 +165,7 @@ class sector_c {
           misc_flags(0),
           valid_count(0),
           light2(0),
+          sound_area(0),
           unused(false),
           is_cave(false),
           exfloors(),
@@ -229,6 +233,43 @@ class sector_c {
     int Write();
 };
 
+// hashes the fields which sector_c::MatchMost() compares, so sectors
+// can be looked up by those fields.
+struct sector_match_hash_t {
+    size_t operator()(const sector_c *S) const {
+        size_t hash = 0;
+
+        auto mix = [&hash](size_t value) {
+            hash ^= value + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+        };
+
+        mix(S->f_h);
+        mix(S->c_h);
+        mix(S->light);
+        mix(S->special);
+        mix(S->tag);
+        mix(S->sound_area);
+
+        // textures are compared without case
+        for (char ch : S->f_tex) {
+            mix(std::tolower((unsigned char)ch));
+        }
+        mix(0);
+
+        for (char ch : S->c_tex) {
+            mix(std::tolower((unsigned char)ch));
+        }
+
+        return hash;
+    }
+};
+
+struct sector_match_equal_t {
+    bool operator()(const sector_c *A, const sector_c *B) const {
+        return A->MatchMost(B);
+    }
+};
+
 class vertex_c {
    public:
     int x, y;
@@ -744,6 +785,11 @@ static std::vector<sidedef_c *> sidedefs;
 static std::vector<sector_c *> sectors;
 
 static std::vector<dummy_sector_c *> dummies;
+
+// the extrafloor dummies which are not full yet, for Dummy_FindMatch()
+static std::unordered_map<const sector_c *, std::deque<dummy_sector_c *>,
+                          sector_match_hash_t, sector_match_equal_t>
+    dummy_index;
 static std::vector<extrafloor_c *> exfloors;
 static std::vector<fs_thing_t> fs_things;
 
@@ -765,10 +811,10 @@ static void LightInSector(sector_c *S, region_c *R, csg_property_set_c *f_face,
     // handle "fx_delta" property for light effects
 
     if (S->special) {
-        int delta = c_face->getInt("fx_delta");
+        int delta = c_face->getInt(ATOM_fx_delta);
 
         if (delta == 0) {
-            delta = f_face->getInt("fx_delta");
+            delta = f_face->getInt(ATOM_fx_delta);
         }
 
         if (delta > 0) {
@@ -804,8 +850,8 @@ static void MakeSector(region_c *R) {
     csg_property_set_c *c_face = &T->b.face;
 
     // determine floor and ceiling heights
-    double f_delta = f_face->getDouble("delta_z");
-    double c_delta = c_face->getDouble("delta_z");
+    double f_delta = f_face->getDouble(ATOM_delta_z);
+    double c_delta = c_face->getDouble(ATOM_delta_z);
 
     S->f_h = I_ROUND(B->t.z + f_delta);
     S->c_h = I_ROUND(T->b.z + c_delta);
@@ -820,11 +866,11 @@ static void MakeSector(region_c *R) {
         S->c_h = S->f_h;
     }
 
-    S->f_tex = f_face->getStr("tex", dummy_plane_tex);
-    S->c_tex = c_face->getStr("tex", dummy_plane_tex);
+    S->f_tex = f_face->getStr(ATOM_tex, dummy_plane_tex);
+    S->c_tex = c_face->getStr(ATOM_tex, dummy_plane_tex);
 
-    int f_mark = f_face->getInt("mark");
-    int c_mark = c_face->getInt("mark");
+    int f_mark = f_face->getInt(ATOM_mark);
+    int c_mark = c_face->getInt(ATOM_mark);
 
     S->mark = f_mark ? f_mark : c_mark;
 
@@ -833,11 +879,11 @@ static void MakeSector(region_c *R) {
     S->is_cave = (f_face->getInt("is_cave") > 0);
 
     // floors have priority over ceilings
-    int f_special = f_face->getInt("special");
-    int c_special = c_face->getInt("special");
+    int f_special = f_face->getInt(ATOM_special);
+    int c_special = c_face->getInt(ATOM_special);
 
-    int f_tag = f_face->getInt("tag");
-    int c_tag = c_face->getInt("tag");
+    int f_tag = f_face->getInt(ATOM_tag);
+    int c_tag = c_face->getInt(ATOM_tag);
 
     if (f_special || !c_special) {
         S->special = f_special;
@@ -944,8 +990,27 @@ static void GrabNeighborFloors() {
     }
 }
 
-static int CoalescePass() {
-    int changes = 0;
+// finds the set which a sector belongs to.  The root of each set is
+// always the lowest sector in it, and that is the one which is kept.
+static int CoalesceFind(std::vector<int> &parent, int index) {
+    while (parent[index] != index) {
+        parent[index] = parent[parent[index]];
+        index = parent[index];
+    }
+
+    return index;
+}
+
+static void CoalesceSectors() {
+    // every region has its own sector at this point.  Sectors merge
+    // with a neighbor when ShouldMerge() holds, which gives the same
+    // result as merging pairs over and over until nothing changes.
+
+    std::vector<int> parent(sectors.size());
+
+    for (unsigned int i = 0; i < sectors.size(); i++) {
+        parent[i] = (int)i;
+    }
 
     for (auto *R : all_regions) {
         if (R->index < 0) {
@@ -971,26 +1036,39 @@ static int CoalescePass() {
             sector_c *D2 = sectors[N->index];
 
             if (D2->ShouldMerge(D1)) {
-                D2->MarkUnused();
-
-                N->index = R->index;
+                int root1 = CoalesceFind(parent, R->index);
+                int root2 = CoalesceFind(parent, N->index);
 
-                D1->is_cave |= D2->is_cave;
-
-                changes++;
+                parent[MAX(root1, root2)] = MIN(root1, root2);
             }
         }
     }
 
-    // fprintf(stderr, "DM_CoalescePass  changes:%d\n", changes);
+    int changes = 0;
 
-    return changes;
-}
+    for (auto *R : all_regions) {
+        if (R->index < 0) {
+            continue;
+        }
 
-static void CoalesceSectors() {
-    while (CoalescePass() > 0) {
+        int root = CoalesceFind(parent, R->index);
+
+        if (root != R->index) {
+            sector_c *D1 = sectors[root];
+            sector_c *D2 = sectors[R->index];
+
+            D2->MarkUnused();
+
+            R->index = root;
+
+            D1->is_cave |= D2->is_cave;
+
+            changes++;
+        }
     }
 
+    DebugPrintf("CoalesceSectors: {} sectors merged\n", changes);
+
     GrabNeighborFloors();
 
     // Note: we cannot remove & delete the unused sectors since the
@@ -1086,10 +1164,10 @@ static sidedef_c *MakeSidedef(linedef_c *L, sector_c *sec, sector_c *back,
         if (!lower) {
             SD->mid = dummy_tex;
         } else {
-            SD->mid = lower->face.getStr("tex", dummy_tex);
+            SD->mid = lower->face.getStr(ATOM_tex, dummy_tex);
 
-            int ox = lower->face.getInt("u1", IVAL_NONE);
-            int oy = lower->face.getInt("v1", IVAL_NONE);
+            int ox = lower->face.getInt(ATOM_u1, IVAL_NONE);
+            int oy = lower->face.getInt(ATOM_v1, IVAL_NONE);
 
             if (ox != IVAL_NONE) {
                 SD->x_offset = CalcXOffset(snag, lower, ox);
@@ -1119,13 +1197,13 @@ static sidedef_c *MakeSidedef(linedef_c *L, sector_c *sec, sector_c *back,
         int u_oy = IVAL_NONE;
 
         if (rail) {
-            std::string rail_tex = rail->face.getStr("tex", "");
+            std::string rail_tex = rail->face.getStr(ATOM_tex, "");
 
             if (!rail_tex.empty()) {
                 SD->mid = rail_tex;
 
-                r_ox = rail->face.getInt("u1", IVAL_NONE);
-                r_oy = rail->face.getInt("v1", 0);
+                r_ox = rail->face.getInt(ATOM_u1, IVAL_NONE);
+                r_oy = rail->face.getInt(ATOM_v1, 0);
 
                 // adjust Y-offset for higher floor than expected
                 int sec_max_z = MAX(sec->f_h, back->f_h);
@@ -1135,16 +1213,16 @@ static sidedef_c *MakeSidedef(linedef_c *L, sector_c *sec, sector_c *back,
         }
 
         if (lower) {
-            l_ox = lower->face.getInt("u1", IVAL_NONE);
+            l_ox = lower->face.getInt(ATOM_u1, IVAL_NONE);
             // on a moving brush, default Y offset is zero
             l_oy = lower->face.getInt(
-                "v1", l_brush->props.getInt("mover") ? 0 : IVAL_NONE);
+                ATOM_v1, l_brush->props.getInt(ATOM_mover) ? 0 : IVAL_NONE);
         }
 
         if (upper) {
-            u_ox = upper->face.getInt("u1", IVAL_NONE);
+            u_ox = upper->face.getInt(ATOM_u1, IVAL_NONE);
             u_oy = upper->face.getInt(
-                "v1", u_brush->props.getInt("mover") ? 0 : IVAL_NONE);
+                ATOM_v1, u_brush->props.getInt(ATOM_mover) ? 0 : IVAL_NONE);
         }
 
         if (back && back->f_h > sec->f_h && !rail && l_oy != IVAL_NONE) {
@@ -1176,8 +1254,8 @@ static sidedef_c *MakeSidedef(linedef_c *L, sector_c *sec, sector_c *back,
             upper = u_brush->verts[0];
         }
 
-        SD->lower = lower->face.getStr("tex", dummy_tex);
-        SD->upper = upper->face.getStr("tex", dummy_tex);
+        SD->lower = lower->face.getStr(ATOM_tex, dummy_tex);
+        SD->upper = upper->face.getStr(ATOM_tex, dummy_tex);
     }
 
     SD->y_offset = NormalizeYOffset(SD->y_offset);
@@ -1216,7 +1294,7 @@ static csg_property_set_c *FindTrigger(snag_c *S, sector_c *front,
                 continue;
             }
 
-            if ((V->face.getStr("special")).empty()) {
+            if ((V->face.getStr(ATOM_special)).empty()) {
                 continue;
             }
 
@@ -1255,21 +1333,21 @@ static csg_property_set_c *FindSpecial(snag_c *S, region_c *R1, region_c *R2) {
 
             V = test_S->FindBrushVert(test_R->gaps.front()->bottom);
 
-            if (V && !(V->face.getStr("special")).empty() &&
+            if (V && !(V->face.getStr(ATOM_special)).empty() &&
                 V->parent->bkind != BKIND_Trigger) {
                 return &V->face;
             }
 
             V = test_S->FindBrushVert(test_R->gaps.back()->top);
 
-            if (V && !(V->face.getStr("special")).empty() &&
+            if (V && !(V->face.getStr(ATOM_special)).empty() &&
                 V->parent->bkind != BKIND_Trigger) {
                 return &V->face;
             }
         } else {
             // check every brush_vert in the snag
             for (auto *V : test_S->sides) {
-                if (V && !(V->face.getStr("special")).empty() &&
+                if (V && !(V->face.getStr(ATOM_special)).empty() &&
                     V->parent->bkind != BKIND_Trigger) {
                     return &V->face;
                 }
@@ -1300,7 +1378,7 @@ static brush_vert_c *FindRail(const snag_c *S, const region_c *R,
             continue;
         }
 
-        if (!(V->face.getStr("tex", "")).empty()) {
+        if (!(V->face.getStr(ATOM_tex, "")).empty()) {
             return V;  // found it!
         }
     }
@@ -1320,7 +1398,7 @@ static void DeterminePegging(linedef_c *L, region_c *front, region_c *back,
     if (!back || back->gaps.empty()) {
         csg_brush_c *T = front->gaps.back()->top;
 
-        if (T->props.getInt("mover")) {
+        if (T->props.getInt(ATOM_mover)) {
             L->flags |= MLF_LowerUnpeg;
         }
 
@@ -1349,8 +1427,8 @@ static void DeterminePegging(linedef_c *L, region_c *front, region_c *back,
         L->flags |= MLF_LowerUnpeg;
     }
 
-    if ((/*  back->c_h < front->c_h && */ T2->props.getInt("mover")) ||
-        (/* front->c_h <  back->c_h && */ T1->props.getInt("mover"))) {
+    if ((/*  back->c_h < front->c_h && */ T2->props.getInt(ATOM_mover)) ||
+        (/* front->c_h <  back->c_h && */ T1->props.getInt(ATOM_mover))) {
         // pegged upper
     } else {
         L->flags |= MLF_UpperUnpeg;
@@ -1403,8 +1481,8 @@ static void MakeLine(region_c *R, snag_c *S) {
     int L_tag = 0;
 
     if (spec) {
-        L_special = spec->getInt("special");
-        L_tag = spec->getInt("tag");
+        L_special = spec->getInt(ATOM_special);
+        L_tag = spec->getInt(ATOM_tag);
     }
 
     // trigger brushes are secondary to specials on brush verts
@@ -1412,8 +1490,8 @@ static void MakeLine(region_c *R, snag_c *S) {
     if (L_special == 0 && trig) {
         use_trig = true;
 
-        L_special = trig->getInt("special");
-        L_tag = trig->getInt("tag");
+        L_special = trig->getInt(ATOM_special);
+        L_tag = trig->getInt(ATOM_tag);
     }
 
     // skip the line if same on both sides, except when it has a rail or special
@@ -1482,13 +1560,13 @@ static void MakeLine(region_c *R, snag_c *S) {
     }
 
     if (f_rail) {
-        L->flags |= f_rail->face.getInt("flags");
+        L->flags |= f_rail->face.getInt(ATOM_flags);
     }
     if (b_rail) {
-        L->flags |= b_rail->face.getInt("flags");
+        L->flags |= b_rail->face.getInt(ATOM_flags);
     }
     if (spec) {
-        L->flags |= spec->getInt("flags");
+        L->flags |= spec->getInt(ATOM_flags);
     }
 
     if (L->special == LIN_FAKE_UNPEGGED) {
@@ -2145,23 +2223,26 @@ static dummy_sector_c *Dummy_New(Doom::sector_c *sec,
 }
 
 static dummy_sector_c *Dummy_FindMatch(Doom::sector_c *new_sec) {
-    for (unsigned int i = 0; i < Doom::dummies.size(); i++) {
-        dummy_sector_c *dum = Doom::dummies[i];
+    // the dummies which are not full yet, oldest first
+    auto &list = Doom::dummy_index[new_sec];
 
-        if (dum->isFull()) {
-            continue;
-        }
+    while (!list.empty() && list.front()->isFull()) {
+        list.pop_front();
+    }
 
-        if (new_sec->MatchMost(dum->sector)) {
-            // won't need the newly created sector now
-            new_sec->MarkUnused();
+    if (!list.empty()) {
+        // won't need the newly created sector now
+        new_sec->MarkUnused();
 
-            return dum;
-        }
+        return list.front();
     }
 
     // create a new one
-    return Dummy_New(new_sec);
+    dummy_sector_c *dum = Dummy_New(new_sec);
+
+    list.push_back(dum);
+
+    return dum;
 }
 
 //------------------------------------------------------------------------
@@ -2178,9 +2259,9 @@ static void SolidExtraFloor(sector_c *sec, gap_c *gap1, gap_c *gap2) {
 
     EF->line_special = ef_solid_type;
 
-    EF->u_special = gap2->bottom->b.face.getInt("special");
-    EF->u_light = gap2->bottom->b.face.getInt("light", sec->light - 24);
-    EF->u_tag = gap2->bottom->b.face.getInt("tag");
+    EF->u_special = gap2->bottom->b.face.getInt(ATOM_special);
+    EF->u_light = gap2->bottom->b.face.getInt(ATOM_light, sec->light - 24);
+    EF->u_tag = gap2->bottom->b.face.getInt(ATOM_tag);
 
     if (EF->u_light < 112) {
         EF->u_light = 112;
@@ -2189,23 +2270,23 @@ static void SolidExtraFloor(sector_c *sec, gap_c *gap1, gap_c *gap2) {
     if (sec->misc_flags & SEC_FLOOR_SPECIAL) {
         if (ef_solid_type == 281)  // Legacy mode
         {
-            EF->u_special = gap2->bottom->t.face.getInt("special");
+            EF->u_special = gap2->bottom->t.face.getInt(ATOM_special);
         } else  // EDGE mode
         {
             EF->u_special = sec->special;
-            sec->special = gap2->bottom->t.face.getInt("special");
+            sec->special = gap2->bottom->t.face.getInt(ATOM_special);
         }
     }
 
     EF->top_h = I_ROUND(gap2->bottom->t.z);
     EF->bottom_h = I_ROUND(gap1->top->b.z);
 
-    EF->top = gap2->bottom->t.face.getStr("tex", dummy_plane_tex);
-    EF->bottom = gap1->top->b.face.getStr("tex", dummy_plane_tex);
+    EF->top = gap2->bottom->t.face.getStr(ATOM_tex, dummy_plane_tex);
+    EF->bottom = gap1->top->b.face.getStr(ATOM_tex, dummy_plane_tex);
 
     brush_vert_c *V = gap2->bottom->verts[0];
 
-    EF->wall = V->face.getStr("tex", dummy_wall_tex);
+    EF->wall = V->face.getStr(ATOM_tex, dummy_wall_tex);
 }
 
 static void LiquidExtraFloor(sector_c *sec, csg_brush_c *liquid) {
@@ -2220,9 +2301,9 @@ static void LiquidExtraFloor(sector_c *sec, csg_brush_c *liquid) {
 
     EF->line_special = ef_liquid_type;
 
-    EF->u_special = liquid->t.face.getInt("special");
-    EF->u_light = liquid->t.face.getInt("light", 144);
-    EF->u_tag = liquid->t.face.getInt("tag");
+    EF->u_special = liquid->t.face.getInt(ATOM_special);
+    EF->u_light = liquid->t.face.getInt(ATOM_light, 144);
+    EF->u_tag = liquid->t.face.getInt(ATOM_tag);
 
     if (EF->line_special == 301)  // Legacy style
     {
@@ -2234,12 +2315,12 @@ static void LiquidExtraFloor(sector_c *sec, csg_brush_c *liquid) {
         EF->top_h = EF->bottom_h + 128;  // not significant
     }
 
-    EF->top = liquid->t.face.getStr("tex", dummy_plane_tex);
+    EF->top = liquid->t.face.getStr(ATOM_tex, dummy_plane_tex);
     EF->bottom = EF->top;
 
     brush_vert_c *V = liquid->verts[0];
 
-    EF->wall = V->face.getStr("tex", dummy_wall_tex);
+    EF->wall = V->face.getStr(ATOM_tex, dummy_wall_tex);
 }
 
 static void ExtraFloors(sector_c *S, region_c *R) {
@@ -2627,8 +2708,8 @@ static void WriteThing(sector_c *S, csg_entity_c *E) {
     // parse entity properties
     int angle = E->props.getInt("angle");
     int tid = E->props.getInt("tid");
-    int special = E->props.getInt("special");
-    int options = E->props.getInt("flags", MTF_ALL_SKILLS);
+    int special = E->props.getInt(ATOM_special);
+    int options = E->props.getInt(ATOM_flags, MTF_ALL_SKILLS);
 
     if (sub_format == SUBFMT_Hexen) {
         if ((options & MTF_HEXEN_CLASSES) == 0) {
@@ -2746,6 +2827,7 @@ void FreeStuff() {
 
     exfloors.clear();
     dummies.clear();
+    dummy_index.clear();
 
     fs_things.clear();
 
@@ -2786,5 +2868,108 @@ void CSG_DOOM_Write() {
     Doom::FreeStuff();
 }
 
+//------------------------------------------------------------------------
+//  DUMMY SECTOR BENCHMARK
+//------------------------------------------------------------------------
+
+// the linear scan which Dummy_FindMatch() used before the index,
+// kept as the reference for CSG_DOOM_BenchDummies().
+static dummy_sector_c *Dummy_FindMatchLinear(Doom::sector_c *new_sec) {
+    for (dummy_sector_c *dum : Doom::dummies) {
+        if (!dum->isFull() && new_sec->MatchMost(dum->sector)) {
+            new_sec->MarkUnused();
+            return dum;
+        }
+    }
+
+    return Dummy_New(new_sec);
+}
+
+// makes 'count' extrafloor sectors the way SolidExtraFloor() does,
+// spread over count / 10 different setups, and finds a dummy sector
+// for each one.  Returns the time taken in milliseconds, and which
+// dummy (by creation order) each extrafloor went to.
+static double BenchDummyPass(int count, bool linear, std::vector<int> &used) {
+    const int setups = MAX(1, count / 10);
+
+    std::string wall_tex = "STONE2";
+
+    std::vector<dummy_sector_c *> found(count);
+
+    Doom::FreeStuff();
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < count; i++) {
+        const int setup = i % setups;
+
+        Doom::sector_c *new_sec = new Doom::sector_c;
+
+        Doom::sectors.push_back(new_sec);
+
+        new_sec->f_h = (setup % 64) * 8;
+        new_sec->c_h = new_sec->f_h + 64 + (setup / 64) * 8;
+
+        new_sec->f_tex = (setup & 1) ? "FLAT1" : "FLAT5_4";
+        new_sec->c_tex = "CEIL3_5";
+
+        new_sec->light = 160;
+
+        dummy_sector_c *dum = linear ? Dummy_FindMatchLinear(new_sec)
+                                     : Dummy_FindMatch(new_sec);
+
+        dum->AddInfo(wall_tex, 281, 0, 0);
+
+        found[i] = dum;
+    }
+
+    auto finish = std::chrono::steady_clock::now();
+
+    std::unordered_map<const dummy_sector_c *, int> order;
+
+    for (unsigned int k = 0; k < Doom::dummies.size(); k++) {
+        order[Doom::dummies[k]] = (int)k;
+    }
+
+    used.resize(count);
+
+    for (int i = 0; i < count; i++) {
+        used[i] = order[found[i]];
+    }
+
+    Doom::FreeStuff();
+
+    return std::chrono::duration<double, std::milli>(finish - start).count();
+}
+
+bool CSG_DOOM_BenchDummies(int count) {
+    std::vector<int> linear_used;
+    std::vector<int> indexed_used;
+
+    double linear_time = 0;
+    double indexed_time = 0;
+
+    // best of a few runs, to cut down the noise
+    for (int pass = 0; pass < 3; pass++) {
+        double t = BenchDummyPass(count, true, linear_used);
+
+        linear_time = (pass == 0) ? t : std::min(linear_time, t);
+
+        t = BenchDummyPass(count, false, indexed_used);
+
+        indexed_time = (pass == 0) ? t : std::min(indexed_time, t);
+    }
+
+    const bool same = (linear_used == indexed_used);
+
+    LogPrintf("Dummy sectors for {} extrafloors ({} setups):\n", count,
+              MAX(1, count / 10));
+    LogPrintf("  linear scan : {:8.1f} ms\n", linear_time);
+    LogPrintf("  indexed     : {:8.1f} ms\n", indexed_time);
+    LogPrintf("  dummies chosen: {}\n", same ? "same" : "DIFFERENT");
+
+    return same;
+}
+
 //--- editor settings ---
 // vi:ts=4:sw=4:noexpandtab
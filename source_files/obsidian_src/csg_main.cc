@@ -21,6 +21,12 @@
 #include "csg_main.h"
 
 #include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <deque>
+#include <new>
+#include <unordered_map>
+#include <utility>
 
 #include "csg_local.h"
 #include "csg_quake.h"  // for quake_plane_c
@@ -58,48 +64,304 @@ extern int q_low_light;
 
 extern void SPOT_FillPolygon(byte content, const int *shape, int count);
 
+//
+// Brushes and their vertices from gui.add_brush() are made in large
+// blocks, which all get freed together by CSG_Main_Free() when the
+// level is done.  Since every brush lives until then anyway, this
+// saves many thousands of small new/delete calls per level.
+//
+template <typename T, int BLOCK_SIZE = 512>
+class csg_arena_c {
+   private:
+    // raw storage, the last block may be partly used
+    std::vector<T *> blocks;
+
+    int used = BLOCK_SIZE;
+
+   public:
+    csg_arena_c() {}
+    ~csg_arena_c() { Clear(); }
+
+    template <typename... ARGS>
+    T *New(ARGS &&...args) {
+        if (used == BLOCK_SIZE) {
+            blocks.push_back((T *)::operator new(sizeof(T) * BLOCK_SIZE));
+            used = 0;
+        }
+
+        T *obj = new (blocks.back() + used) T(std::forward<ARGS>(args)...);
+
+        used++;
+
+        return obj;
+    }
+
+    void Clear() {
+        for (size_t b = 0; b < blocks.size(); b++) {
+            int count = (b + 1 < blocks.size()) ? BLOCK_SIZE : used;
+
+            for (int i = 0; i < count; i++) {
+                blocks[b][i].~T();
+            }
+
+            ::operator delete(blocks[b]);
+        }
+
+        blocks.clear();
+
+        used = BLOCK_SIZE;
+    }
+};
+
+static csg_arena_c<csg_brush_c> brush_arena;
+static csg_arena_c<brush_vert_c> vert_arena;
+
 extern bool QLIT_ParseProperty(std::string key, std::string value);
 
-void csg_property_set_c::Add(std::string key, std::string value) {
-    dict[key] = std::string(value);
+//------------------------------------------------------------------------
+//  PROPERTY ATOMS
+//------------------------------------------------------------------------
+
+struct csg_atom_info_t {
+    std::string str;
+
+    // value when the string is a number, the same as StringToDouble()
+    // would give for it
+    double number;
+    bool is_number;
+};
+
+// these must match the csg_known_atom_e enum
+static const char *const known_atom_names[NUM_KNOWN_ATOMS] = {
+    "tex",      "special",   "tag",      "flags",     "u1",
+    "v1",       "light",     "mark",     "mover",     "delta_z",
+    "fx_delta", "reachable", "ambient",  "light_add", "shadow",
+    "sky_shadow"};
+
+class csg_atom_table_c {
+   public:
+    // a deque never moves its elements, so the string_views used as
+    // keys in 'lookup' stay valid
+    std::deque<csg_atom_info_t> atoms;
+
+    std::unordered_map<std::string_view, csg_atom_t> lookup;
+
+   public:
+    csg_atom_table_c() {
+        for (const char *name : known_atom_names) {
+            Intern(name);
+        }
+    }
+
+    csg_atom_t Intern(std::string_view str) {
+        auto it = lookup.find(str);
+
+        if (it != lookup.end()) {
+            return it->second;
+        }
+
+        csg_atom_t atom = (csg_atom_t)atoms.size();
+
+        atoms.push_back(csg_atom_info_t{std::string(str), 0, false});
+
+        csg_atom_info_t &info = atoms.back();
+
+        // this is what stod() does, minus the exceptions
+        const char *start = info.str.c_str();
+        char *end;
+
+        errno = 0;
+
+        double value = strtod(start, &end);
+
+        if (end != start && errno != ERANGE) {
+            info.number = value;
+            info.is_number = true;
+        }
+
+        lookup.emplace(std::string_view(info.str), atom);
+
+        return atom;
+    }
+};
+
+static csg_atom_table_c &AtomTable() {
+    static csg_atom_table_c table;
+    return table;
 }
 
-void csg_property_set_c::Remove(std::string key) { dict.erase(key); }
+csg_atom_t CSG_Atom(std::string_view str) { return AtomTable().Intern(str); }
 
-void csg_property_set_c::DebugDump() {
-    std::map<std::string, std::string>::iterator PI;
+csg_atom_t CSG_FindAtom(std::string_view str) {
+    const csg_atom_table_c &table = AtomTable();
+
+    auto it = table.lookup.find(str);
+
+    return (it != table.lookup.end()) ? it->second : CSG_NO_ATOM;
+}
+
+const std::string &CSG_AtomString(csg_atom_t atom) {
+    return AtomTable().atoms[atom].str;
+}
+
+static double AtomToDouble(csg_atom_t atom) {
+    const csg_atom_info_t &info = AtomTable().atoms[atom];
 
+    // not a number: this throws, the same as it always did
+    return info.is_number ? info.number : StringToDouble(info.str);
+}
+
+//------------------------------------------------------------------------
+
+csg_property_set_c::~csg_property_set_c() {
+    if (entries != local) {
+        delete[] entries;
+    }
+}
+
+csg_property_set_c::csg_property_set_c(const csg_property_set_c &other)
+    : entries(local), count(0), capacity(LOCAL_SIZE) {
+    *this = other;
+}
+
+csg_property_set_c &csg_property_set_c::operator=(
+    const csg_property_set_c &other) {
+    if (this != &other) {
+        count = 0;
+
+        Reserve(other.count);
+
+        std::copy(other.entries, other.entries + other.count, entries);
+
+        count = other.count;
+    }
+
+    return *this;
+}
+
+void csg_property_set_c::Reserve(int new_cap) {
+    if (new_cap <= capacity) {
+        return;
+    }
+
+    entry_t *new_entries = new entry_t[new_cap];
+
+    std::copy(entries, entries + count, new_entries);
+
+    if (entries != local) {
+        delete[] entries;
+    }
+
+    entries = new_entries;
+    capacity = (unsigned short)new_cap;
+}
+
+const csg_property_set_c::entry_t *csg_property_set_c::Find(
+    csg_atom_t key) const {
+    for (int i = 0; i < count; i++) {
+        if (entries[i].key == key) {
+            return &entries[i];
+        }
+    }
+
+    return NULL;
+}
+
+void csg_property_set_c::Add(std::string_view key, std::string_view value) {
+    csg_atom_t key_atom = CSG_Atom(key);
+    csg_atom_t value_atom = CSG_Atom(value);
+
+    entry_t *E = (entry_t *)Find(key_atom);
+
+    if (E) {
+        E->value = value_atom;
+        return;
+    }
+
+    if (count == capacity) {
+        Reserve(capacity * 2);
+    }
+
+    // keep them sorted by name
+    const std::string &key_str = CSG_AtomString(key_atom);
+
+    int pos = count;
+
+    while (pos > 0 && key_str < entries[pos - 1].Key()) {
+        entries[pos] = entries[pos - 1];
+        pos--;
+    }
+
+    entries[pos] = entry_t{key_atom, value_atom};
+
+    count++;
+}
+
+void csg_property_set_c::Remove(std::string_view key) {
+    const entry_t *E = Find(CSG_FindAtom(key));
+
+    if (E) {
+        int pos = (int)(E - entries);
+
+        std::copy(entries + pos + 1, entries + count, entries + pos);
+
+        count--;
+    }
+}
+
+void csg_property_set_c::DebugDump() {
     fmt::print(stderr, "{\n");
 
-    for (PI = dict.begin(); PI != dict.end(); PI++) {
-        fmt::print(stderr, "  {} = \"{}\"\n", PI->first.c_str(),
-                   PI->second.c_str());
+    for (const entry_t &E : *this) {
+        fmt::print(stderr, "  {} = \"{}\"\n", E.Key(), E.Value());
     }
 
     fmt::print(stderr, "}\n");
 }
 
-std::string csg_property_set_c::getStr(std::string key,
-                                       std::string def_val) const {
-    std::map<std::string, std::string>::const_iterator PI = dict.find(key);
+std::string csg_property_set_c::getStr(std::string_view key,
+                                       std::string_view def_val) const {
+    return getStr(CSG_FindAtom(key), def_val);
+}
+
+double csg_property_set_c::getDouble(std::string_view key,
+                                     double def_val) const {
+    return getDouble(CSG_FindAtom(key), def_val);
+}
 
-    if (PI == dict.end()) {
-        return def_val;
+int csg_property_set_c::getInt(std::string_view key, int def_val) const {
+    return getInt(CSG_FindAtom(key), def_val);
+}
+
+std::string csg_property_set_c::getStr(csg_atom_t key,
+                                       std::string_view def_val) const {
+    const entry_t *E = Find(key);
+
+    if (!E) {
+        return std::string(def_val);
     }
 
-    return PI->second.c_str();
+    return E->Value();
 }
 
-double csg_property_set_c::getDouble(std::string key, double def_val) const {
-    std::string str = getStr(key);
+double csg_property_set_c::getDouble(csg_atom_t key, double def_val) const {
+    const entry_t *E = Find(key);
+
+    if (!E || E->Value().empty()) {
+        return def_val;
+    }
 
-    return !str.empty() ? StringToDouble(str) : def_val;
+    return AtomToDouble(E->value);
 }
 
-int csg_property_set_c::getInt(std::string key, int def_val) const {
-    std::string str = getStr(key);
+int csg_property_set_c::getInt(csg_atom_t key, int def_val) const {
+    const entry_t *E = Find(key);
+
+    if (!E || E->Value().empty()) {
+        return def_val;
+    }
 
-    return !str.empty() ? I_ROUND(StringToDouble(str)) : def_val;
+    return I_ROUND(AtomToDouble(E->value));
 }
 
 void csg_property_set_c::getHexenArgs(u8_t *arg5) const {
@@ -165,6 +427,8 @@ double brush_plane_c::CalcZ(double ax, double ay) const {
     return z;
 }
 
+static unsigned int brush_serial = 0;
+
 csg_brush_c::csg_brush_c()
     : bkind(BKIND_Solid),
       bflags(0),
@@ -172,7 +436,8 @@ csg_brush_c::csg_brush_c()
       verts(),
       b(-EXTREME_H),
       t(EXTREME_H),
-      link_ent(NULL) {}
+      link_ent(NULL),
+      serial(brush_serial++) {}
 
 csg_brush_c::csg_brush_c(const csg_brush_c *other)
     : bkind(other->bkind),
@@ -181,7 +446,8 @@ csg_brush_c::csg_brush_c(const csg_brush_c *other)
       verts(),
       b(other->b),
       t(other->t),
-      link_ent(other->link_ent) {
+      link_ent(other->link_ent),
+      serial(brush_serial++) {
     // NOTE: verts and slopes not cloned
 
     bflags &= ~BRU_IF_Quad;
@@ -453,6 +719,55 @@ bool csg_entity_c::Match(std::string want_name) const {
 
 #define QUAD_NODE_SIZE 320
 
+// clips the range t0..t1 of a ray to one axis of a box
+static bool ClipSlab(double start, double delta, double lo, double hi,
+                     double &t0, double &t1) {
+    if (fabs(delta) < EPSILON) {
+        return (start >= lo && start <= hi);
+    }
+
+    double ta = (lo - start) / delta;
+    double tb = (hi - start) / delta;
+
+    if (ta > tb) {
+        std::swap(ta, tb);
+    }
+
+    t0 = MAX(t0, ta);
+    t1 = MIN(t1, tb);
+
+    return (t0 <= t1);
+}
+
+// a ray being traced through the brush quad-tree
+struct csg_trace_ray_t {
+    double x1, y1, z1;
+    double x2, y2, z2;
+
+    int mode;  // TRACE_XXX bits
+
+    // slab test of the 2D segment against a box, which is expanded a
+    // little so brushes touching the ray are never missed.  'enter'
+    // receives how far along the ray (0 to 1) it enters the box.
+    bool TouchesBox(double bx1, double by1, double bx2, double by2,
+                    double *enter) const {
+        const double slop = 1.0;
+
+        double t0 = 0;
+        double t1 = 1;
+
+        if (!ClipSlab(x1, x2 - x1, bx1 - slop, bx2 + slop, t0, t1)) {
+            return false;
+        }
+        if (!ClipSlab(y1, y2 - y1, by1 - slop, by2 + slop, t0, t1)) {
+            return false;
+        }
+
+        *enter = t0;
+        return true;
+    }
+};
+
 class brush_quad_node_c {
    public:
     int lo_x, lo_y, size;
@@ -547,14 +862,14 @@ class brush_quad_node_c {
     }
 
    private:
-    bool IntersectBrush(const csg_brush_c *B, double x1, double y1, double z1,
-                        double x2, double y2, double z2, std::string mode) {
-        if (mode[0] == 'v') {
+    bool BrushBlocksRay(const csg_brush_c *B, const csg_trace_ray_t &R) const {
+        if (R.mode & TRACE_Visible) {
             if ((B->bflags & BFLAG_NoDraw) || B->bkind == BKIND_Light ||
                 B->bkind == BKIND_Rail || B->bkind == BKIND_Trigger) {
                 return false;
             }
-        } else if (mode[0] == 'p') {
+        }
+        if (R.mode & TRACE_Physics) {
             if ((B->bflags & BFLAG_NoClip) || B->bkind == BKIND_Liquid ||
                 B->bkind == BKIND_Light || B->bkind == BKIND_Rail ||
                 B->bkind == BKIND_Trigger) {
@@ -562,7 +877,13 @@ class brush_quad_node_c {
             }
         }
 
-        return B->IntersectRay(x1, y1, z1, x2, y2, z2);
+        double t_enter;
+
+        if (!R.TouchesBox(B->min_x, B->min_y, B->max_x, B->max_y, &t_enter)) {
+            return false;
+        }
+
+        return B->IntersectRay(R.x1, R.y1, R.z1, R.x2, R.y2, R.z2);
     }
 
     bool BoxTouchesThis(double x1, double y1, double x2, double y2) const {
@@ -583,32 +904,50 @@ class brush_quad_node_c {
         return true;
     }
 
-    bool RayTouchesBox(double x1, double y1, double x2, double y2) const {
-        // TODO: a _proper_ line/box test will be much more optimal
-        //       (assuming the average ray is fairly long).
-
-        return BoxTouchesThis(x1, y1, x2, y2);
-    }
-
    public:
-    bool TraceRay(double x1, double y1, double z1, double x2, double y2,
-                  double z2, std::string mode) {
-        for (unsigned int k = 0; k < brushes.size(); k++) {
-            if (IntersectBrush(brushes[k], x1, y1, z1, x2, y2, z2, mode)) {
+    bool TraceRay(const csg_trace_ray_t &R) const {
+        for (const csg_brush_c *B : brushes) {
+            if (BrushBlocksRay(B, R)) {
                 return true;
             }
         }
 
-        if (children[0][0]) {
-            for (int cx = 0; cx < 2; cx++) {
-                for (int cy = 0; cy < 2; cy++) {
-                    if (children[cx][cy]->RayTouchesBox(x1, y1, x2, y2)) {
-                        if (children[cx][cy]->TraceRay(x1, y1, z1, x2, y2, z2,
-                                                       mode)) {
-                            return true;
-                        }
-                    }
+        if (!children[0][0]) {
+            return false;  // did not hit anything
+        }
+
+        // visit the children which the ray passes through, nearest
+        // one first, since a hit there means the others can be skipped.
+        const brush_quad_node_c *order[4];
+        double enter[4];
+        int count = 0;
+
+        for (int cx = 0; cx < 2; cx++) {
+            for (int cy = 0; cy < 2; cy++) {
+                const brush_quad_node_c *N = children[cx][cy];
+
+                double t;
+
+                if (!R.TouchesBox(N->lo_x, N->lo_y, N->hi_x(), N->hi_y(),
+                                  &t)) {
+                    continue;
+                }
+
+                int pos = count++;
+
+                for (; pos > 0 && enter[pos - 1] > t; pos--) {
+                    order[pos] = order[pos - 1];
+                    enter[pos] = enter[pos - 1];
                 }
+
+                order[pos] = N;
+                enter[pos] = t;
+            }
+        }
+
+        for (int i = 0; i < count; i++) {
+            if (order[i]->TraceRay(R)) {
+                return true;
             }
         }
 
@@ -629,8 +968,8 @@ class brush_quad_node_c {
             return;
         }
 
-        double t_delta = B->t.face.getDouble("delta_z", 0);
-        double b_delta = B->b.face.getDouble("delta_z", 0);
+        double t_delta = B->t.face.getDouble(ATOM_delta_z, 0);
+        double b_delta = B->b.face.getDouble(ATOM_delta_z, 0);
 
         int t_z = I_ROUND(B->t.z + t_delta);
         int b_z = I_ROUND(B->b.z + b_delta);
@@ -727,7 +1066,7 @@ class brush_quad_node_c {
         if (children[0][0]) {
             for (int cx = 0; cx < 2; cx++) {
                 for (int cy = 0; cy < 2; cy++) {
-                    if (children[cx][cy]->RayTouchesBox(x, y, x, y)) {
+                    if (children[cx][cy]->BoxTouchesThis(x, y, x, y)) {
                         if (children[cx][cy]->BrushContents(x, y, z, result,
                                                             liquid_depth)) {
                             return true;
@@ -995,7 +1334,7 @@ static int Grab_Vertex(lua_State *L, int stack_pos, csg_brush_c *B) {
         }
     } else  // side info
     {
-        brush_vert_c *V = new brush_vert_c(B);
+        brush_vert_c *V = vert_arena.New(B);
 
         V->uv_mat = Grab_UVMatrix(L, -4);
 
@@ -1022,11 +1361,8 @@ static int Grab_CoordList(lua_State *L, int stack_pos, csg_brush_c *B) {
         return luaL_argerror(L, stack_pos, "missing table: coords");
     }
 
-    int index = 1;
-
-    for (;;) {
-        lua_pushinteger(L, index);
-        lua_gettable(L, stack_pos);
+    for (int index = 1;; index++) {
+        lua_rawgeti(L, stack_pos, index);
 
         if (lua_isnil(L, -1)) {
             lua_pop(L, 1);
@@ -1036,8 +1372,6 @@ static int Grab_CoordList(lua_State *L, int stack_pos, csg_brush_c *B) {
         Grab_Vertex(L, -1, B);
 
         lua_pop(L, 1);
-
-        index++;
     }
 
     B->ComputeBBox();
@@ -1180,7 +1514,7 @@ int CSG_tex_property(lua_State *L) {
 //    args   : DOOM sector or linedef args (a table)
 //
 int CSG_add_brush(lua_State *L) {
-    csg_brush_c *B = new csg_brush_c();
+    csg_brush_c *B = brush_arena.New();
 
     Grab_CoordList(L, 1, B);
 
@@ -1191,6 +1525,36 @@ int CSG_add_brush(lua_State *L) {
     return 0;
 }
 
+// LUA: add_brushes(list)
+//
+// adds every brush in the list, each one being a coords list as
+// described for add_brush() above.  This is the same as calling
+// add_brush() for each one, but much cheaper for large numbers.
+//
+int CSG_add_brushes(lua_State *L) {
+    if (lua_type(L, 1) != LUA_TTABLE) {
+        return luaL_argerror(L, 1, "missing table: brush list");
+    }
+
+    int count = (int)lua_rawlen(L, 1);
+
+    for (int index = 1; index <= count; index++) {
+        lua_rawgeti(L, 1, index);
+
+        csg_brush_c *B = brush_arena.New();
+
+        Grab_CoordList(L, lua_gettop(L), B);
+
+        all_brushes.push_back(B);
+
+        brush_quad_tree->Add(B);
+
+        lua_pop(L, 1);
+    }
+
+    return 0;
+}
+
 // LUA: add_entity(props)
 //
 //   id      -- number or name of thing
@@ -1223,6 +1587,26 @@ int CSG_add_entity(lua_State *L) {
     return 0;
 }
 
+int CSG_ParseTraceMode(const char *mode) {
+    int bits = 0;
+
+    for (; *mode; mode++) {
+        switch (*mode) {
+            case 'v':
+                bits |= TRACE_Visible;
+                break;
+            case 'p':
+                bits |= TRACE_Physics;
+                break;
+
+            default:
+                return -1;
+        }
+    }
+
+    return (bits == 0) ? -1 : bits;
+}
+
 // LUA: trace_ray(x1,y1,z1, x2,y2,z2, mode)
 //
 //   x1 y1 z1  -- start coordinate
@@ -1244,29 +1628,88 @@ int CSG_trace_ray(lua_State *L) {
     double y2 = luaL_checknumber(L, 5);
     double z2 = luaL_checknumber(L, 6);
 
-    const char *mode = luaL_checkstring(L, 7);
+    int mode = CSG_ParseTraceMode(luaL_checkstring(L, 7));
 
     if (fabs(x2 - x1) < 1 && fabs(y2 - y1) < 1 && fabs(z2 - z1) < 1) {
         return luaL_error(L, "gui.trace_ray: zero-length vector");
     }
 
-    if (!(mode[0] == 'v' || mode[0] == 'p')) {
+    if (mode < 0) {
         return luaL_argerror(L, 7, "gui.trace_ray: bad mode string");
     }
 
-    SYS_ASSERT(brush_quad_tree);
-
-    bool result = brush_quad_tree->TraceRay(x1, y1, z1, x2, y2, z2, mode);
+    bool result = CSG_TraceRay(x1, y1, z1, x2, y2, z2, mode);
 
     lua_pushboolean(L, result ? 1 : 0);
     return 1;
 }
 
+// LUA: trace_rays(coords, mode)
+//
+//   coords -- a flat list of the rays to check, six numbers per ray:
+//             { x1,y1,z1, x2,y2,z2,  x1,y1,z1, x2,y2,z2, ... }
+//
+//   mode -- same as for gui.trace_ray()
+//
+//   result is a list with a boolean for each ray, 'true' if that
+//   ray hit something, false otherwise
+//
+int CSG_trace_rays(lua_State *L) {
+    luaL_checktype(L, 1, LUA_TTABLE);
+
+    int mode = CSG_ParseTraceMode(luaL_checkstring(L, 2));
+
+    if (mode < 0) {
+        return luaL_argerror(L, 2, "gui.trace_rays: bad mode string");
+    }
+
+    int total = (int)lua_rawlen(L, 1);
+
+    if (total % 6 != 0) {
+        return luaL_argerror(L, 1, "gui.trace_rays: bad coordinate list");
+    }
+
+    int count = total / 6;
+
+    lua_createtable(L, count, 0);
+
+    for (int i = 0; i < count; i++) {
+        double c[6];
+
+        for (int k = 0; k < 6; k++) {
+            lua_rawgeti(L, 1, i * 6 + k + 1);
+
+            int isnum;
+            c[k] = lua_tonumberx(L, -1, &isnum);
+
+            if (!isnum) {
+                return luaL_error(L, "gui.trace_rays: ray #%d is bad", i + 1);
+            }
+
+            lua_pop(L, 1);
+        }
+
+        if (fabs(c[3] - c[0]) < 1 && fabs(c[4] - c[1]) < 1 &&
+            fabs(c[5] - c[2]) < 1) {
+            return luaL_error(L, "gui.trace_rays: zero-length vector");
+        }
+
+        bool result = CSG_TraceRay(c[0], c[1], c[2], c[3], c[4], c[5], mode);
+
+        lua_pushboolean(L, result ? 1 : 0);
+        lua_rawseti(L, -2, i + 1);
+    }
+
+    return 1;
+}
+
 bool CSG_TraceRay(double x1, double y1, double z1, double x2, double y2,
-                  double z2, std::string mode) {
+                  double z2, int mode) {
     SYS_ASSERT(brush_quad_tree);
 
-    return brush_quad_tree->TraceRay(x1, y1, z1, x2, y2, z2, mode);
+    csg_trace_ray_t R = {x1, y1, z1, x2, y2, z2, mode};
+
+    return brush_quad_tree->TraceRay(R);
 }
 
 int CSG_BrushContents(double x, double y, double z, double *liquid_depth) {
@@ -1343,9 +1786,9 @@ void CSG_LinkBrushToEntity(csg_brush_c *B, std::string link_key) {
 void CSG_Main_Free() {
     unsigned int k;
 
-    for (k = 0; k < all_brushes.size(); k++) {
-        delete all_brushes[k];
-    }
+    // this frees all the brushes
+    brush_arena.Clear();
+    vert_arena.Clear();
 
     for (k = 0; k < all_entities.size(); k++) {
         delete all_entities[k];
@@ -23,6 +23,7 @@
 
 #include <map>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "sys_type.h"
@@ -50,35 +51,104 @@ extern double CLUSTER_SIZE;
 
 /******* CLASSES ***************/
 
+// Property keys and values are interned: each distinct string is kept
+// once and referred to by a number (an "atom").  When a value looks like
+// a number, that number is worked out once, when the atom is made.
+// Atoms are only made on the main thread, and never freed.
+
+typedef unsigned int csg_atom_t;
+
+#define CSG_NO_ATOM 0xFFFFFFFFu
+
+// atoms which always exist, for keys looked up in the hot loops
+enum csg_known_atom_e {
+    ATOM_tex = 0,
+    ATOM_special,
+    ATOM_tag,
+    ATOM_flags,
+    ATOM_u1,
+    ATOM_v1,
+    ATOM_light,
+    ATOM_mark,
+    ATOM_mover,
+    ATOM_delta_z,
+    ATOM_fx_delta,
+    ATOM_reachable,
+    ATOM_ambient,
+    ATOM_light_add,
+    ATOM_shadow,
+    ATOM_sky_shadow,
+
+    NUM_KNOWN_ATOMS
+};
+
+// returns the atom for a string, making a new one if needed
+csg_atom_t CSG_Atom(std::string_view str);
+
+// like CSG_Atom() but never makes one, returns CSG_NO_ATOM instead
+csg_atom_t CSG_FindAtom(std::string_view str);
+
+const std::string &CSG_AtomString(csg_atom_t atom);
+
 class csg_property_set_c {
+   public:
+    struct entry_t {
+        csg_atom_t key;
+        csg_atom_t value;
+
+        const std::string &Key() const { return CSG_AtomString(key); }
+        const std::string &Value() const { return CSG_AtomString(value); }
+    };
+
    private:
-    std::map<std::string, std::string> dict;
+    // the entries are kept sorted by key name.  The first few are
+    // stored in the object itself, only bigger sets use the heap.
+    static constexpr int LOCAL_SIZE = 4;
+
+    entry_t *entries;
+
+    unsigned short count;
+    unsigned short capacity;
+
+    entry_t local[LOCAL_SIZE];
 
    public:
-    csg_property_set_c() : dict() {}
+    csg_property_set_c() : entries(local), count(0), capacity(LOCAL_SIZE) {}
 
-    ~csg_property_set_c() {}
+    ~csg_property_set_c();
 
     // copy constructor
-    csg_property_set_c(const csg_property_set_c &other) : dict(other.dict) {}
+    csg_property_set_c(const csg_property_set_c &other);
 
-    void Add(std::string key, std::string value);
-    void Remove(std::string key);
+    csg_property_set_c &operator=(const csg_property_set_c &other);
 
-    std::string getStr(std::string key, std::string def_val = "") const;
+    void Add(std::string_view key, std::string_view value);
+    void Remove(std::string_view key);
 
-    double getDouble(std::string key, double def_val = 0) const;
-    int getInt(std::string key, int def_val = 0) const;
+    std::string getStr(std::string_view key,
+                       std::string_view def_val = "") const;
+
+    double getDouble(std::string_view key, double def_val = 0) const;
+    int getInt(std::string_view key, int def_val = 0) const;
+
+    // faster versions for an atom key
+    std::string getStr(csg_atom_t key, std::string_view def_val = "") const;
+
+    double getDouble(csg_atom_t key, double def_val = 0) const;
+    int getInt(csg_atom_t key, int def_val = 0) const;
 
     void getHexenArgs(u8_t *arg5) const;
 
     void DebugDump();
 
    public:
-    typedef std::map<std::string, std::string>::iterator iterator;
+    const entry_t *begin() const { return entries; }
+    const entry_t *end() const { return entries + count; }
+
+   private:
+    const entry_t *Find(csg_atom_t key) const;
 
-    iterator begin() { return dict.begin(); }
-    iterator end() { return dict.end(); }
+    void Reserve(int new_cap);
 };
 
 class uv_matrix_c {
@@ -182,6 +252,10 @@ class csg_brush_c {
     // only set when brush is part of a map-model (bmodel)
     csg_entity_c *link_ent;
 
+    // creation order, used to break ties when sorting brushes
+    // (comparing pointers would depend on the heap layout).
+    unsigned int serial;
+
    public:
     csg_brush_c();
     ~csg_brush_c();
@@ -240,8 +314,17 @@ extern std::string dummy_plane_tex;
 
 void CSG_Main_Free();
 
+// which brushes can block a ray, for CSG_TraceRay()
+enum trace_mode_e {
+    TRACE_Visible = (1 << 0),  // only visible brushes
+    TRACE_Physics = (1 << 1),  // only solid brushes
+};
+
+// converts a mode string (like "v") to TRACE_XXX bits, -1 if invalid
+int CSG_ParseTraceMode(const char *mode);
+
 bool CSG_TraceRay(double x1, double y1, double z1, double x2, double y2,
-                  double z2, std::string mode);
+                  double z2, int mode);
 
 int CSG_BrushContents(double x, double y, double z,
                       double *liquid_depth = NULL);
@@ -250,6 +333,10 @@ csg_property_set_c *CSG_LookupTexProps(std::string name);
 
 void CSG_LinkBrushToEntity(csg_brush_c *B, std::string link_key);
 
+// times finding dummy sectors for 'count' synthetic Doom extrafloors,
+// indexed and with a linear scan.  false if the two choose differently.
+bool CSG_DOOM_BenchDummies(int count);
+
 #endif /* __OBLIGE_CSG_MAIN_H__ */
 
 //--- editor settings ---
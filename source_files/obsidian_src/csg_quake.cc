@@ -214,8 +214,7 @@ class quake_group_c {
         }
 
         // failed to find one, because all the sides were "mini sides".
-        // to handle this we perform a point-to-region lookup, which is
-        // currently very slow, so hopefully this occurs rarely.
+        // to handle this we perform a point-to-region lookup.
 
         double mid_x, mid_y;
 
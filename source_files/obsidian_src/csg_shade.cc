@@ -125,12 +125,12 @@ static int SHADE_CalcRegionGroup(region_c *R) {
     // differentiate floor heights
     int base = ((int)B->t.z & 0x1FFF) << 16;
 
-    std::string tag = f_face->getStr("tag");
+    std::string tag = f_face->getStr(ATOM_tag);
     if (!tag.empty()) {
         return base + StringToInt(tag);
     }
 
-    tag = c_face->getStr("tag");
+    tag = c_face->getStr(ATOM_tag);
     if (!tag.empty()) {
         return base + StringToInt(tag);
     }
@@ -244,7 +244,7 @@ static int SHADE_CaveLighting(region_c *R, double z2)
 			continue;
 
 		// line of sight blocked?
-		if (CSG_TraceRay(x1,y1,z1, x2,y2,z2, "v"))
+		if (CSG_TraceRay(x1,y1,z1, x2,y2,z2, TRACE_Visible))
 			continue;
 
 		result = level;
@@ -264,10 +264,10 @@ static void SHADE_VisitRegion(region_c *R) {
 
     // grab ambient value  [ should always be present ]
 
-    ambient = T->props.getInt("ambient", -1);
+    ambient = T->props.getInt(ATOM_ambient, -1);
 
     if (ambient < 0) {
-        ambient = B->props.getInt("ambient", -1);
+        ambient = B->props.getInt(ATOM_ambient, -1);
     }
 
     if (ambient < 0) {
@@ -287,13 +287,13 @@ static void SHADE_VisitRegion(region_c *R) {
             continue;
         }
 
-        int br_light = LB->props.getInt("light_add", -1);
-        int br_shadow = LB->props.getInt("shadow", -1);
+        int br_light = LB->props.getInt(ATOM_light_add, -1);
+        int br_shadow = LB->props.getInt(ATOM_shadow, -1);
 
         light = MAX(light, br_light);
         shadow = MAX(shadow, br_shadow);
 
-        int sky_shadow = LB->props.getInt("sky_shadow", -1);
+        int sky_shadow = LB->props.getInt(ATOM_sky_shadow, -1);
 
         if (sky_shadow > 0 && (T->bflags & BFLAG_Sky)) {
             shadow = MAX(shadow, sky_shadow);
@@ -305,8 +305,8 @@ static void SHADE_VisitRegion(region_c *R) {
     for (unsigned int pass = 0; pass < 2; pass++) {
         csg_property_set_c *P = (pass == 0) ? &B->t.face : &T->b.face;
 
-        int fc_light = P->getInt("light_add", -1);
-        int fc_shadow = P->getInt("shadow", -1);
+        int fc_light = P->getInt(ATOM_light_add, -1);
+        int fc_shadow = P->getInt(ATOM_shadow, -1);
 
         light = MAX(light, fc_light);
         shadow = MAX(shadow, fc_shadow);
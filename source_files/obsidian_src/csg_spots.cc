@@ -53,10 +53,15 @@ extern int spot_high_h;
 // number of grid squares
 static int grid_W, grid_H;
 
-static byte **spot_grid;
+// the cells are stored column by column, see grid_cell()
+static std::vector<byte> spot_grid;
 
-static int *grid_lefties;
-static int *grid_righties;
+static std::vector<int> grid_lefties;
+static std::vector<int> grid_righties;
+
+static inline byte &grid_cell(int x, int y) {
+    return spot_grid[x * grid_H + y];
+}
 
 // declare this here (don't pull in all CSG headers)
 extern void CSG_spot_processing(int x1, int y1, int x2, int y2, int floor_h);
@@ -79,28 +84,15 @@ void SPOT_CreateGrid(byte content, int min_x, int min_y, int max_x, int max_y) {
     grid_H += 2;
 #endif
 
-    spot_grid = new byte *[grid_W];
+    spot_grid.assign(grid_W * grid_H, content);
 
-    for (int x = 0; x < grid_W; x++) {
-        spot_grid[x] = new byte[grid_H];
-
-        memset(spot_grid[x], content, grid_H);
-    }
-
-    grid_lefties = new int[grid_H];
-    grid_righties = new int[grid_H];
+    grid_lefties.resize(grid_H);
+    grid_righties.resize(grid_H);
 }
 
 void SPOT_FreeGrid() {
-    if (spot_grid) {
-        for (int x = 0; x < grid_W; x++) {
-            delete[] spot_grid[x];
-        }
-
-        delete[] spot_grid;
-
-        spot_grid = NULL;
-    }
+    // keep the memory around, the next area will need it
+    spot_grid.clear();
 }
 
 void SPOT_DumpGrid(const char *info) {
@@ -115,7 +107,7 @@ void SPOT_DumpGrid(const char *info) {
         int width = MIN(MAX_WIDTH, grid_W);
 
         for (int x = 0; x < width; x++) {
-            byte content = spot_grid[x][y];
+            byte content = grid_cell(x, y);
 
             if (content & HAS_MON) {
                 buffer[x] = 'm';
@@ -134,7 +126,7 @@ void SPOT_DumpGrid(const char *info) {
             }
         }
 
-        buffer[grid_W] = 0;
+        buffer[width] = 0;
 
         DebugPrintf(" {: 3} {}\n", y, buffer);
     }
@@ -159,7 +151,7 @@ static void test_item_spot(int x, int y, std::vector<grid_point_c> &spots) {
 
     for (int dx = 0; dx < 2; dx++) {
         for (int dy = 0; dy < 2; dy++) {
-            byte content = spot_grid[x + dx][y + dy];
+            byte content = grid_cell(x + dx, y + dy);
 
             if (content & (7 | HAS_ITEM)) {
                 return;  // no good, something in the way
@@ -188,17 +180,15 @@ static void test_item_spot(int x, int y, std::vector<grid_point_c> &spots) {
     spots.push_back(grid_point_c(real_x, real_y));
 
     // reserve these cells, prevent overlapping item spots
-    spot_grid[x + 0][y + 0] |= HAS_ITEM;
-    spot_grid[x + 0][y + 1] |= HAS_ITEM;
-    spot_grid[x + 1][y + 0] |= HAS_ITEM;
-    spot_grid[x + 1][y + 1] |= HAS_ITEM;
+    grid_cell(x + 0, y + 0) |= HAS_ITEM;
+    grid_cell(x + 0, y + 1) |= HAS_ITEM;
+    grid_cell(x + 1, y + 0) |= HAS_ITEM;
+    grid_cell(x + 1, y + 1) |= HAS_ITEM;
 }
 
 static void clean_up_grid() {
-    for (int x = 0; x < grid_W; x++) {
-        for (int y = 0; y < grid_H; y++) {
-            spot_grid[x][y] &= 7;
-        }
+    for (byte &content : spot_grid) {
+        content &= 7;
     }
 }
 
@@ -214,19 +204,19 @@ void SPOT_ItemSpots(std::vector<grid_point_c> &spots) {
     // first, mark squares which are near a wall
     for (x = 0; x < grid_W; x++) {
         for (y = 0; y < grid_H; y++) {
-            if ((spot_grid[x][y] & 3) == SPOT_WALL) {
+            if ((grid_cell(x, y) & 3) == SPOT_WALL) {
                 if (x > 0) {
-                    spot_grid[x - 1][y] |= NEAR_WALL;
+                    grid_cell(x - 1, y) |= NEAR_WALL;
                 }
                 if (x < w2) {
-                    spot_grid[x + 1][y] |= NEAR_WALL;
+                    grid_cell(x + 1, y) |= NEAR_WALL;
                 }
 
                 if (y > 0) {
-                    spot_grid[x][y - 1] |= NEAR_WALL;
+                    grid_cell(x, y - 1) |= NEAR_WALL;
                 }
                 if (y < h2) {
-                    spot_grid[x][y + 1] |= NEAR_WALL;
+                    grid_cell(x, y + 1) |= NEAR_WALL;
                 }
             }
         }
@@ -242,101 +232,166 @@ void SPOT_ItemSpots(std::vector<grid_point_c> &spots) {
 //----------------------------------------------------------------------
 
 static void remove_dud_cells() {
+    for (byte &content : spot_grid) {
+        content &= ~IS_DUD;
+    }
+}
+
+// While finding monster spots, each column keeps a running count of
+// the cells which a monster cannot use, so checking whether an area
+// is free costs one subtraction per column.  The count for column x
+// below row y is mon_blocked[x * (grid_H + 1) + y].
+static std::vector<int> mon_blocked;
+
+// the longest free run in each column, as found by scan_column()
+typedef struct {
+    int y1, y2;
+    int num;  // zero when there is none
+
+    bool dirty;  // cells have changed since the last scan
+} mon_column_t;
+
+static std::vector<mon_column_t> mon_columns;
+
+static int mon_want;
+
+static inline bool mon_cell_blocked(byte content) {
+    return (content & (HAS_MON | IS_DUD)) || (content & 3) > mon_want;
+}
+
+static void count_blocked_cells(int x) {
+    int *count = &mon_blocked[x * (grid_H + 1)];
+
+    count[0] = 0;
+
+    for (int y = 0; y < grid_H; y++) {
+        count[y + 1] = count[y] + (mon_cell_blocked(grid_cell(x, y)) ? 1 : 0);
+    }
+}
+
+static void begin_mon_grid(int want) {
+    mon_want = want;
+
+    mon_blocked.resize(grid_W * (grid_H + 1));
+    mon_columns.resize(grid_W);
+
     for (int x = 0; x < grid_W; x++) {
-        for (int y = 0; y < grid_H; y++) {
-            spot_grid[x][y] &= ~IS_DUD;
-        }
+        count_blocked_cells(x);
+
+        mon_columns[x].dirty = true;
     }
 }
 
-static bool test_mon_area(int x1, int y1, int x2, int y2, int want) {
+static bool test_mon_area(int x1, int y1, int x2, int y2) {
     if (x1 < 0 or x2 >= grid_W or y1 < 0 or y2 >= grid_H) {
         return false;
     }
 
-    for (int x = x1; x <= x2; x++) {
-        for (int y = y1; y <= y2; y++) {
-            byte content = spot_grid[x][y];
-
-            if (content & (HAS_MON | IS_DUD)) {
-                return false;
-            }
+    const int *count = &mon_blocked[x1 * (grid_H + 1)];
 
-            if ((content & 3) > want) {
-                return false;
-            }
+    for (int x = x1; x <= x2; x++, count += grid_H + 1) {
+        if (count[y2 + 1] != count[y1]) {
+            return false;
         }
     }
 
     return true;
 }
 
-static int biggest_gap(int *y1, int *y2, int want) {
+static void scan_column(int x) {
     // Note: this also duds any single square spots, which will never
     //       get used because they'll never form a 2x2 group.
 
-    int best_x = -1;
-    int best_num = 0;
+    mon_column_t &C = mon_columns[x];
 
-    for (int x = 0; x < grid_W; x++) {
-        int y = 0;
+    C.num = 0;
+    C.dirty = false;
 
-        while (y < grid_H - 1) {
-            if (!test_mon_area(x, y, x, y, want)) {
-                y++;
-                continue;
-            }
+    bool made_duds = false;
 
-            int ey = y;
+    int y = 0;
 
-            while (ey < grid_H - 1 &&
-                   test_mon_area(x, ey + 1, x, ey + 1, want)) {
-                ey++;
-            }
+    while (y < grid_H - 1) {
+        if (mon_cell_blocked(grid_cell(x, y))) {
+            y++;
+            continue;
+        }
+
+        int ey = y;
 
-            int num = ey - y + 1;
+        while (ey < grid_H - 1 && !mon_cell_blocked(grid_cell(x, ey + 1))) {
+            ey++;
+        }
 
-            if (num == 1) {
-                // single squares are useless, remove them now
-                spot_grid[x][y] |= IS_DUD;
-            } else if (num > best_num) {
-                best_x = x;
-                best_num = num;
+        int num = ey - y + 1;
 
-                *y1 = y;
-                *y2 = ey;
-            }
+        if (num == 1) {
+            // single squares are useless, remove them now
+            grid_cell(x, y) |= IS_DUD;
+            made_duds = true;
+        } else if (num > C.num) {
+            C.num = num;
+            C.y1 = y;
+            C.y2 = ey;
+        }
+
+        y = ey + 1;
+    }
+
+    if (made_duds) {
+        count_blocked_cells(x);
+    }
+}
+
+static int biggest_gap(int *y1, int *y2) {
+    // only the columns which have changed need to be scanned again,
+    // the others would give the same result (and make no new duds).
+
+    int best_x = -1;
+    int best_num = 0;
 
-            y = ey + 1;
+    for (int x = 0; x < grid_W; x++) {
+        mon_column_t &C = mon_columns[x];
+
+        if (C.dirty) {
+            scan_column(x);
+        }
+
+        if (C.num > best_num) {
+            best_x = x;
+            best_num = C.num;
+
+            *y1 = C.y1;
+            *y2 = C.y2;
         }
     }
 
     return best_x;
 }
 
-static bool grow_spot(int &x1, int &y1, int &x2, int &y2, int want) {
+static bool grow_spot(int &x1, int &y1, int &x2, int &y2) {
     // (passing parameters by reference for nicer code)
 
     // special case for initial square, try to become a 2x2 square
     // since that is the minimum requirement.
 
     if (x1 == x2 && y1 == y2) {
-        if (test_mon_area(x1, y1, x2 + 1, y2 + 1, want)) {
+        if (test_mon_area(x1, y1, x2 + 1, y2 + 1)) {
             x2++;
             y2++;
             return true;
         }
-        if (test_mon_area(x1, y1 - 1, x2 + 1, y2, want)) {
+        if (test_mon_area(x1, y1 - 1, x2 + 1, y2)) {
             x2++;
             y1--;
             return true;
         }
-        if (test_mon_area(x1 - 1, y1, x2, y2 + 1, want)) {
+        if (test_mon_area(x1 - 1, y1, x2, y2 + 1)) {
             x1--;
             y2++;
             return true;
         }
-        if (test_mon_area(x1 - 1, y1 - 1, x2, y2, want)) {
+        if (test_mon_area(x1 - 1, y1 - 1, x2, y2)) {
             x1--;
             y1--;
             return true;
@@ -392,20 +447,20 @@ static bool grow_spot(int &x1, int &y1, int &x2, int &y2, int want) {
     }
 
     for (int pass = 0; pass < 4; pass++) {
-        if (pass == x1_pass && test_mon_area(x1 - 1, y1, x1 - 1, y2, want)) {
+        if (pass == x1_pass && test_mon_area(x1 - 1, y1, x1 - 1, y2)) {
             x1--;
             return true;
         }
-        if (pass == x2_pass && test_mon_area(x2 + 1, y1, x2 + 1, y2, want)) {
+        if (pass == x2_pass && test_mon_area(x2 + 1, y1, x2 + 1, y2)) {
             x2++;
             return true;
         }
 
-        if (pass == y1_pass && test_mon_area(x1, y1 - 1, x2, y1 - 1, want)) {
+        if (pass == y1_pass && test_mon_area(x1, y1 - 1, x2, y1 - 1)) {
             y1--;
             return true;
         }
-        if (pass == y2_pass && test_mon_area(x1, y2 + 1, x2, y2 + 1, want)) {
+        if (pass == y2_pass && test_mon_area(x1, y2 + 1, x2, y2 + 1)) {
             y2++;
             return true;
         }
@@ -417,8 +472,12 @@ static bool grow_spot(int &x1, int &y1, int &x2, int &y2, int want) {
 static void mark_monster(int x1, int y1, int x2, int y2, byte flag) {
     for (int x = x1; x <= x2; x++) {
         for (int y = y1; y <= y2; y++) {
-            spot_grid[x][y] |= flag;
+            grid_cell(x, y) |= flag;
         }
+
+        count_blocked_cells(x);
+
+        mon_columns[x].dirty = true;
     }
 }
 
@@ -430,11 +489,13 @@ void SPOT_MonsterSpots(std::vector<grid_point_c> &spots, int want) {
     //
     //   repeat until no more available.
 
+    begin_mon_grid(want);
+
     for (;;) {
         int x1, x2;
         int y1 = 0, y2 = 0;
 
-        x1 = biggest_gap(&y1, &y2, want);
+        x1 = biggest_gap(&y1, &y2);
 
         if (x1 < 0) {
             return;
@@ -442,12 +503,12 @@ void SPOT_MonsterSpots(std::vector<grid_point_c> &spots, int want) {
 
         y1 = (y1 + y2) / 2;
 
-        SYS_ASSERT((spot_grid[x1][y1] & 3) <= want);
+        SYS_ASSERT((grid_cell(x1, y1) & 3) <= want);
 
         x2 = x1;
         y2 = y1;
 
-        while (grow_spot(x1, y1, x2, y2, want)) {
+        while (grow_spot(x1, y1, x2, y2)) {
         }
 
         if (x2 > x1 && y2 > y1) {
@@ -601,7 +662,7 @@ static void draw_line(int x1, int y1, int x2, int y2) {
 }
 
 static inline void replace_cell(int x, int y, byte content) {
-    byte &target = spot_grid[x][y];
+    byte &target = grid_cell(x, y);
 
     // Note : we allow SPOT_CLEAR to replace anything, though
     //        generally it is only used to initialize the grid.
@@ -55,12 +55,25 @@
 //  wadfab_get_thing(index)
 //  -->  { id=#, x=#, y=#, z=#, angle=#, flags=# }
 //
+//  wadfab_export(hexen)
+//  -->  { things={...}, sectors={...}, sides={...}, lines={...},
+//         polygons={ { sector=#, coords={...}, floors={...} } ... }
+//       }
+//       everything from the functions above in one table.  The lists
+//       start at 1, so a sector (etc) number needs 1 added to look it
+//       up.  'floors' is absent when a polygon has no 3D floors.
+//
 //------------------------------------------------------------------------
 
 #include "dm_prefab.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+
 #include "aj_poly.h"
 #include "csg_main.h"
+#include "fmt/format.h"
 #include "g_doom.h"
 #include "hdr_fltk.h"
 #include "hdr_lua.h"
@@ -104,36 +117,273 @@ void Appl_Printf(const char *str, ...) {
     }
 }
 
+//------------------------------------------------------------------------
+//  PREFAB CACHE
 //------------------------------------------------------------------------
 
-int wadfab_free(lua_State *L) {
-    ajpoly::CloseMap();
-    ajpoly::FreeWAD();
+// Polygonating a prefab takes far longer than using the result, so the
+// result of each wadfab_load() is kept in the "cache" folder of the home
+// dir for later runs.  A cached prefab is one flat block: a header and
+// then an array of fixed-size records for each kind of object, each
+// array starting on an 8 byte boundary.  It needs no processing after
+// being read (so it could just as well be memory-mapped), and the
+// wadfab_get_XXX() functions only ever look at this form.
+//
+// The header holds the size and hash of the WAD it was made from, hence
+// a prefab which has been edited is simply polygonated again.
+
+static constexpr char WADFAB_CACHE_MAGIC[8] = "OBFAB01";
+
+struct wadfab_header_t {
+    char magic[8];
+    std::uint64_t source_size;
+    std::uint64_t source_hash;
+
+    std::int32_t num_things;
+    std::int32_t num_sectors;
+    std::int32_t num_sides;
+    std::int32_t num_lines;
+    std::int32_t num_polygons;
+    std::int32_t num_edges;
+    std::int32_t num_floors;
+    std::int32_t padding;
+};
+
+struct wadfab_thing_t {
+    std::int32_t x, y, z;
+    std::int32_t type;
+    std::int32_t options;
+    std::int32_t angle;
+    std::int32_t special;
+    std::uint8_t args[5];
+    std::uint8_t padding[3];
+};
+
+struct wadfab_sector_t {
+    std::int32_t floor_h, ceil_h;
+    std::int32_t light;
+    std::int32_t special;
+    std::int32_t tag;
+    std::int32_t num_floors;
+    char floor_tex[10];
+    char ceil_tex[10];
+};
+
+struct wadfab_side_t {
+    std::int32_t x_offset, y_offset;
+    std::int32_t sector;  // -1 if none
+    char upper_tex[10];
+    char lower_tex[10];
+    char mid_tex[10];
+    char padding[2];
+};
+
+struct wadfab_line_t {
+    std::int32_t x1, y1, x2, y2;
+    std::int32_t right, left;  // -1 if none
+    std::int32_t flags;
+    std::int32_t special;
+    std::int32_t tag;
+    std::uint8_t args[5];
+    std::uint8_t padding[3];
+};
+
+struct wadfab_polygon_t {
+    // the sector number given to Lua, i.e. -1 for void space
+    std::int32_t sector;
+
+    // the edges are stored anti-clockwise (the order Lua wants them)
+    std::int32_t first_edge, num_edges;
+    std::int32_t first_floor, num_floors;
+};
+
+struct wadfab_edge_t {
+    double x, y;
+    double along;
+    std::int32_t line;  // -1 if none
+    std::int32_t side;  // -1 if none
+};
+
+struct wadfab_3d_floor_t {
+    std::int32_t bottom_h, top_h;
+    std::int32_t x_offset, y_offset;
+    std::int32_t special;
+    std::int32_t light;
+    char bottom_tex[10];
+    char top_tex[10];
+    char side_tex[10];
+
+    // valid is zero when the control sector was missing
+    std::uint8_t valid;
+    std::uint8_t liquid;
+};
+
+class wadfab_c {
+   public:
+    // the whole cached form, the pointers below all point into it
+    std::vector<std::uint64_t> data;
+
+    const wadfab_header_t *header = nullptr;
+
+    const wadfab_thing_t *things = nullptr;
+    const wadfab_sector_t *sectors = nullptr;
+    const wadfab_side_t *sides = nullptr;
+    const wadfab_line_t *lines = nullptr;
+    const wadfab_polygon_t *polygons = nullptr;
+    const wadfab_edge_t *edges = nullptr;
+    const wadfab_3d_floor_t *floors = nullptr;
+
+   public:
+    // sets up the pointers, returns false if the data is not the size
+    // which the header says it should be.
+    bool Bind();
+};
+
+static wadfab_c *current_fab;
+
+static int wadfab_cache_hits;
+static int wadfab_cache_misses;
+static u32_t wadfab_load_millis;
+
+static size_t SectionSize(size_t count, size_t rec_size) {
+    return (count * rec_size + 7) & ~(size_t)7;
+}
 
-    return 0;
+template <typename T>
+static const T *BindSection(const byte *base, size_t &pos, int count) {
+    const T *arr = (const T *)(base + pos);
+    pos += SectionSize(count, sizeof(T));
+    return arr;
 }
 
-int wadfab_load(lua_State *L) {
-    const char *filename = luaL_checkstring(L, 1);
-    const char *map = luaL_checkstring(L, 2);
+bool wadfab_c::Bind() {
+    const size_t total = data.size() * sizeof(std::uint64_t);
 
-    if (!PHYSFS_exists(filename)) {
-        return luaL_error(L, "wadfab_load: no such file: %s", filename);
+    if (total < sizeof(wadfab_header_t)) {
+        return false;
     }
 
-    if (!ajpoly::LoadWAD(filename)) {
-        return luaL_error(L, "wadfab_load: %s", ajpoly::GetError());
+    const byte *base = (const byte *)data.data();
+
+    header = (const wadfab_header_t *)base;
+
+    const int counts[7] = {header->num_things,   header->num_sectors,
+                           header->num_sides,    header->num_lines,
+                           header->num_polygons, header->num_edges,
+                           header->num_floors};
+
+    for (int count : counts) {
+        // a sanity check, these are never near that big
+        if (count < 0 || count > (1 << 24)) {
+            return false;
+        }
     }
 
-    if (!ajpoly::OpenMap(map)) {
-        return luaL_error(L, "wadfab_load: %s", ajpoly::GetError());
+    const size_t need =
+        SectionSize(1, sizeof(wadfab_header_t)) +
+        SectionSize(header->num_things, sizeof(wadfab_thing_t)) +
+        SectionSize(header->num_sectors, sizeof(wadfab_sector_t)) +
+        SectionSize(header->num_sides, sizeof(wadfab_side_t)) +
+        SectionSize(header->num_lines, sizeof(wadfab_line_t)) +
+        SectionSize(header->num_polygons, sizeof(wadfab_polygon_t)) +
+        SectionSize(header->num_edges, sizeof(wadfab_edge_t)) +
+        SectionSize(header->num_floors, sizeof(wadfab_3d_floor_t));
+
+    if (total != need) {
+        return false;
     }
 
-    if (!ajpoly::Polygonate(true /* require_border */)) {
-        return luaL_error(L, "wadfab_load: %s", ajpoly::GetError());
+    size_t pos = SectionSize(1, sizeof(wadfab_header_t));
+
+    things = BindSection<wadfab_thing_t>(base, pos, header->num_things);
+    sectors = BindSection<wadfab_sector_t>(base, pos, header->num_sectors);
+    sides = BindSection<wadfab_side_t>(base, pos, header->num_sides);
+    lines = BindSection<wadfab_line_t>(base, pos, header->num_lines);
+    polygons = BindSection<wadfab_polygon_t>(base, pos, header->num_polygons);
+    edges = BindSection<wadfab_edge_t>(base, pos, header->num_edges);
+    floors = BindSection<wadfab_3d_floor_t>(base, pos, header->num_floors);
+
+    // the edge and 3D floor ranges must be valid too
+    for (int p = 0; p < header->num_polygons; p++) {
+        const wadfab_polygon_t &poly = polygons[p];
+
+        if (poly.first_edge < 0 || poly.num_edges < 0 ||
+            poly.first_edge + poly.num_edges > header->num_edges ||
+            poly.first_floor < 0 || poly.num_floors < 0 ||
+            poly.first_floor + poly.num_floors > header->num_floors) {
+            return false;
+        }
     }
 
-    return 0;
+    return true;
+}
+
+static std::filesystem::path FabCacheFile(const char *filename,
+                                          const char *map) {
+    const std::string name = fmt::format("{}:{}", filename, map);
+
+    return home_dir / "cache" /
+           fmt::format("{:016x}.fab", FNV1aHash(name));
+}
+
+static bool ReadFabFile(const char *filename, std::string &buffer) {
+    PHYSFS_File *fp = PHYSFS_openRead(filename);
+
+    if (!fp) {
+        return false;
+    }
+
+    PHYSFS_sint64 length = PHYSFS_fileLength(fp);
+
+    bool ok = (length >= 0);
+
+    if (ok) {
+        buffer.resize(length);
+        ok = (PHYSFS_readBytes(fp, buffer.data(), length) == length);
+    }
+
+    PHYSFS_close(fp);
+
+    return ok;
+}
+
+static wadfab_c *FabCache_Load(const std::filesystem::path &cache_file,
+                               const std::string &source) {
+    std::ifstream fp{cache_file, std::ios::binary | std::ios::ate};
+
+    if (!fp.is_open()) {
+        return NULL;
+    }
+
+    const std::streamoff length = fp.tellg();
+
+    if (length < (std::streamoff)sizeof(wadfab_header_t) || (length & 7)) {
+        return NULL;
+    }
+
+    wadfab_c *fab = new wadfab_c;
+
+    fab->data.resize(length / 8);
+
+    fp.seekg(0);
+
+    if (!fp.read((char *)fab->data.data(), length) || !fab->Bind() ||
+        memcmp(fab->header->magic, WADFAB_CACHE_MAGIC,
+               sizeof(fab->header->magic)) != 0 ||
+        fab->header->source_size != source.size() ||
+        fab->header->source_hash != FNV1aHash(source)) {
+        delete fab;
+        return NULL;
+    }
+
+    return fab;
+}
+
+static void FabCache_Save(const std::filesystem::path &cache_file,
+                          const wadfab_c *fab) {
+    FileSaveAtomic(cache_file,
+                   std::string_view((const char *)fab->data.data(),
+                                    fab->data.size() * sizeof(std::uint64_t)));
 }
 
 //------------------------------------------------------------------------
@@ -156,48 +406,346 @@ static int calc_thing_z(int x, int y) {
     return 0;  // dummy value
 }
 
-int wadfab_get_thing(lua_State *L) {
-    int index = luaL_checkinteger(L, 1);
+static double calc_along_dist(const ajpoly::edge_c *E) {
+    const ajpoly::linedef_c *LD = E->linedef;
 
-    if (index < 0 || index >= ajpoly::num_things) {
-        return 0;
+    SYS_ASSERT(LD);
+
+    double ref_x = (E->side == 1) ? LD->start->x : LD->end->x;
+    double ref_y = (E->side == 1) ? LD->start->y : LD->end->y;
+
+    double dx = ref_x - E->end->x;
+    double dy = ref_y - E->end->y;
+
+    return hypot(dx, dy);
+}
+
+static void convert_edge(wadfab_edge_t &rec, const ajpoly::edge_c *E) {
+    // using 'end' coord since edges face outwards
+    rec.x = E->end->x;
+    rec.y = E->end->y;
+
+    rec.line = -1;
+    rec.side = -1;
+
+    if (E->linedef) {
+        rec.line = E->linedef->index;
+        rec.along = calc_along_dist(E);
+
+        const ajpoly::sidedef_c *SD;
+
+        // we want the "outer" sidedef (the opposite side)
+        if (E->side == 0) {
+            SD = E->linedef->left;
+        } else {
+            SD = E->linedef->right;
+        }
+
+        if (SD) {
+            rec.side = SD->index;
+        }
     }
+}
 
-    const ajpoly::thing_c *TH = ajpoly::Thing(index);
+static void convert_3d_floor(wadfab_3d_floor_t &rec,
+                             const ajpoly::linedef_c *LD) {
+    // determine the dummy sector
+    const ajpoly::sector_c *SEC = LD->right->sector;
 
-    lua_newtable(L);
+    if (!SEC) {
+        return;
+    }
 
-    lua_pushinteger(L, TH->x);
-    lua_setfield(L, -2, "x");
+    rec.valid = 1;
 
-    lua_pushinteger(L, TH->y);
-    lua_setfield(L, -2, "y");
+    rec.bottom_h = SEC->floor_h;
+    rec.top_h = SEC->ceil_h;
 
-    lua_pushinteger(L, calc_thing_z(TH->x, TH->y));
-    lua_setfield(L, -2, "z");
+    memcpy(rec.bottom_tex, SEC->floor_tex.data(), sizeof(rec.bottom_tex));
+    memcpy(rec.top_tex, SEC->ceil_tex.data(), sizeof(rec.top_tex));
+    memcpy(rec.side_tex, LD->right->mid_tex.data(), sizeof(rec.side_tex));
 
-    lua_pushinteger(L, TH->angle);
-    lua_setfield(L, -2, "angle");
+    rec.x_offset = LD->right->x_offset;
+    rec.y_offset = LD->right->y_offset;
 
-    lua_pushinteger(L, TH->type);
-    lua_setfield(L, -2, "id");
+    rec.special = SEC->special;
+    rec.light = SEC->light;
 
-    lua_pushinteger(L, TH->options);
-    lua_setfield(L, -2, "flags");
+    rec.liquid = (LD->special == 405) ? 1 : 0;
+}
 
-    return 1;
+template <typename T>
+static void AppendSection(std::string &out, const std::vector<T> &items) {
+    out.append((const char *)items.data(), items.size() * sizeof(T));
+    out.resize((out.size() + 7) & ~(size_t)7, 0);
 }
 
-int wadfab_get_thing_hexen(lua_State *L) {
-    int index = luaL_checkinteger(L, 1);
+//
+// converts the map which AJ-Polygonator has just processed into the
+// cached form.
+//
+static wadfab_c *ConvertFab(const std::string &source) {
+    std::vector<wadfab_thing_t> things(ajpoly::num_things);
+    std::vector<wadfab_sector_t> sectors(ajpoly::num_sectors);
+    std::vector<wadfab_side_t> sides(ajpoly::num_sidedefs);
+    std::vector<wadfab_line_t> lines(ajpoly::num_linedefs);
+    std::vector<wadfab_polygon_t> polygons(ajpoly::num_polygons);
+    std::vector<wadfab_edge_t> edges;
+    std::vector<wadfab_3d_floor_t> floors;
+
+    for (int i = 0; i < ajpoly::num_things; i++) {
+        const ajpoly::thing_c *TH = ajpoly::Thing(i);
+        wadfab_thing_t &rec = things[i];
+
+        rec.x = TH->x;
+        rec.y = TH->y;
+        rec.z = calc_thing_z(TH->x, TH->y);
+        rec.type = TH->type;
+        rec.options = TH->options;
+        rec.angle = TH->angle;
+        rec.special = TH->special;
+
+        memcpy(rec.args, TH->args.data(), sizeof(rec.args));
+    }
+
+    for (int i = 0; i < ajpoly::num_sectors; i++) {
+        const ajpoly::sector_c *SEC = ajpoly::Sector(i);
+        wadfab_sector_t &rec = sectors[i];
+
+        rec.floor_h = SEC->floor_h;
+        rec.ceil_h = SEC->ceil_h;
+        rec.light = SEC->light;
+        rec.special = SEC->special;
+        rec.tag = SEC->tag;
+        rec.num_floors = SEC->num_floors;
+
+        memcpy(rec.floor_tex, SEC->floor_tex.data(), sizeof(rec.floor_tex));
+        memcpy(rec.ceil_tex, SEC->ceil_tex.data(), sizeof(rec.ceil_tex));
+    }
+
+    for (int i = 0; i < ajpoly::num_sidedefs; i++) {
+        const ajpoly::sidedef_c *SD = ajpoly::Sidedef(i);
+        wadfab_side_t &rec = sides[i];
+
+        rec.x_offset = SD->x_offset;
+        rec.y_offset = SD->y_offset;
+        rec.sector = SD->sector ? SD->sector->index : -1;
+
+        memcpy(rec.upper_tex, SD->upper_tex.data(), sizeof(rec.upper_tex));
+        memcpy(rec.lower_tex, SD->lower_tex.data(), sizeof(rec.lower_tex));
+        memcpy(rec.mid_tex, SD->mid_tex.data(), sizeof(rec.mid_tex));
+    }
+
+    for (int i = 0; i < ajpoly::num_linedefs; i++) {
+        const ajpoly::linedef_c *LD = ajpoly::Linedef(i);
+        wadfab_line_t &rec = lines[i];
+
+        rec.x1 = (int)LD->start->x;
+        rec.y1 = (int)LD->start->y;
+        rec.x2 = (int)LD->end->x;
+        rec.y2 = (int)LD->end->y;
+
+        rec.right = LD->right ? LD->right->index : -1;
+        rec.left = LD->left ? LD->left->index : -1;
+
+        rec.flags = LD->flags;
+        rec.special = LD->special;
+        rec.tag = LD->tag;
+
+        memcpy(rec.args, LD->args.data(), sizeof(rec.args));
+    }
+
+    for (int i = 0; i < ajpoly::num_polygons; i++) {
+        const ajpoly::polygon_c *poly = ajpoly::Polygon(i);
+        wadfab_polygon_t &rec = polygons[i];
+
+        int sect_id = poly->sector ? poly->sector->index : -1;
+
+        if (sect_id == VOID_SECTOR_IDX) {
+            sect_id = -1;
+        }
+
+        rec.sector = sect_id;
+
+        // the polygon edges are clockwise, but OBLIGE are anti-clockwise.
+        // hence reverse the order.
+        rec.first_edge = (int)edges.size();
+
+        for (const ajpoly::edge_c *E = poly->edge_list; E; E = E->next) {
+            edges.emplace_back();
+            convert_edge(edges.back(), E);
+        }
+
+        rec.num_edges = (int)edges.size() - rec.first_edge;
+
+        std::reverse(edges.begin() + rec.first_edge, edges.end());
+
+        rec.first_floor = (int)floors.size();
 
-    if (index < 0 || index >= ajpoly::num_things) {
+        if (poly->sector) {
+            for (int f = 0; f < poly->sector->num_floors; f++) {
+                floors.emplace_back();
+                convert_3d_floor(floors.back(),
+                                 poly->sector->getExtraFloor(f));
+            }
+        }
+
+        rec.num_floors = (int)floors.size() - rec.first_floor;
+    }
+
+    wadfab_header_t header = {};
+
+    memcpy(header.magic, WADFAB_CACHE_MAGIC, sizeof(header.magic));
+
+    header.source_size = source.size();
+    header.source_hash = FNV1aHash(source);
+
+    header.num_things = (int)things.size();
+    header.num_sectors = (int)sectors.size();
+    header.num_sides = (int)sides.size();
+    header.num_lines = (int)lines.size();
+    header.num_polygons = (int)polygons.size();
+    header.num_edges = (int)edges.size();
+    header.num_floors = (int)floors.size();
+
+    std::string out((const char *)&header, sizeof(header));
+
+    out.resize((out.size() + 7) & ~(size_t)7, 0);
+
+    AppendSection(out, things);
+    AppendSection(out, sectors);
+    AppendSection(out, sides);
+    AppendSection(out, lines);
+    AppendSection(out, polygons);
+    AppendSection(out, edges);
+    AppendSection(out, floors);
+
+    wadfab_c *fab = new wadfab_c;
+
+    fab->data.resize(out.size() / 8);
+
+    memcpy(fab->data.data(), out.data(), out.size());
+
+    if (!fab->Bind()) {
+        Main::FatalError("wadfab_load: bad prefab conversion\n");
+    }
+
+    return fab;
+}
+
+void WadFab_CacheStats() {
+    if (wadfab_cache_hits + wadfab_cache_misses > 0) {
+        LogPrintf("Prefab cache: {} loaded, {} polygonated ({} ms)\n",
+                  wadfab_cache_hits, wadfab_cache_misses, wadfab_load_millis);
+    }
+
+    wadfab_cache_hits = 0;
+    wadfab_cache_misses = 0;
+    wadfab_load_millis = 0;
+}
+
+//------------------------------------------------------------------------
+
+int wadfab_free(lua_State *L) {
+    delete current_fab;
+    current_fab = NULL;
+
+    // in case a wadfab_load() failed part-way
+    ajpoly::CloseMap();
+    ajpoly::FreeWAD();
+
+    return 0;
+}
+
+int wadfab_load(lua_State *L) {
+    const char *filename = luaL_checkstring(L, 1);
+    const char *map = luaL_checkstring(L, 2);
+
+    if (!PHYSFS_exists(filename)) {
+        return luaL_error(L, "wadfab_load: no such file: %s", filename);
+    }
+
+    delete current_fab;
+    current_fab = NULL;
+
+    const u32_t start_time = TimeGetMillies();
+
+    // a WAD which cannot be read here is not cached, but LoadWAD()
+    // will give the proper error for it.
+    std::string source;
+
+    const bool have_source = ReadFabFile(filename, source);
+
+    const std::filesystem::path cache_file = FabCacheFile(filename, map);
+
+    if (have_source) {
+        current_fab = FabCache_Load(cache_file, source);
+    }
+
+    if (current_fab) {
+        wadfab_cache_hits++;
+        wadfab_load_millis += TimeGetMillies() - start_time;
         return 0;
     }
 
-    const ajpoly::thing_c *TH = ajpoly::Thing(index);
+    if (!ajpoly::LoadWAD(filename)) {
+        return luaL_error(L, "wadfab_load: %s", ajpoly::GetError());
+    }
+
+    if (!ajpoly::OpenMap(map)) {
+        return luaL_error(L, "wadfab_load: %s", ajpoly::GetError());
+    }
+
+    if (!ajpoly::Polygonate(true /* require_border */)) {
+        return luaL_error(L, "wadfab_load: %s", ajpoly::GetError());
+    }
+
+    current_fab = ConvertFab(source);
+
+    ajpoly::CloseMap();
+    ajpoly::FreeWAD();
+
+    if (have_source) {
+        FabCache_Save(cache_file, current_fab);
+    }
+
+    wadfab_cache_misses++;
+    wadfab_load_millis += TimeGetMillies() - start_time;
+
+    return 0;
+}
+
+//------------------------------------------------------------------------
+
+static void push_tex(lua_State *L, const char *tex) {
+    lua_pushlstring(L, tex, strnlen(tex, 10));
+}
+
+static void push_thing(lua_State *L, const wadfab_thing_t *TH, bool hexen) {
+    if (!hexen) {
+        lua_createtable(L, 0, 6);
+
+        lua_pushinteger(L, TH->x);
+        lua_setfield(L, -2, "x");
+
+        lua_pushinteger(L, TH->y);
+        lua_setfield(L, -2, "y");
+
+        lua_pushinteger(L, TH->z);
+        lua_setfield(L, -2, "z");
+
+        lua_pushinteger(L, TH->angle);
+        lua_setfield(L, -2, "angle");
+
+        lua_pushinteger(L, TH->type);
+        lua_setfield(L, -2, "id");
+
+        lua_pushinteger(L, TH->options);
+        lua_setfield(L, -2, "flags");
+        return;
+    }
 
-    lua_newtable(L);
+    lua_createtable(L, 0, 12);
 
     lua_pushinteger(L, TH->type);
     lua_setfield(L, -2, "id");
@@ -208,7 +756,7 @@ int wadfab_get_thing_hexen(lua_State *L) {
     lua_pushinteger(L, TH->y);
     lua_setfield(L, -2, "y");
 
-    lua_pushinteger(L, calc_thing_z(TH->x, TH->y));
+    lua_pushinteger(L, TH->z);
     lua_setfield(L, -2, "z");
 
     lua_pushinteger(L, TH->angle);
@@ -234,20 +782,10 @@ int wadfab_get_thing_hexen(lua_State *L) {
 
     lua_pushinteger(L, TH->args[4]);
     lua_setfield(L, -2, "arg5");
-
-    return 1;
 }
 
-int wadfab_get_sector(lua_State *L) {
-    int index = luaL_checkinteger(L, 1);
-
-    if (index < 0 || index >= ajpoly::num_sectors) {
-        return 0;
-    }
-
-    const ajpoly::sector_c *SEC = ajpoly::Sector(index);
-
-    lua_newtable(L);
+static void push_sector(lua_State *L, const wadfab_sector_t *SEC) {
+    lua_createtable(L, 0, 7);
 
     lua_pushinteger(L, SEC->floor_h);
     lua_setfield(L, -2, "floor_h");
@@ -267,25 +805,15 @@ int wadfab_get_sector(lua_State *L) {
         lua_setfield(L, -2, "tag");
     }
 
-    lua_pushstring(L, SEC->floor_tex.data());
+    push_tex(L, SEC->floor_tex);
     lua_setfield(L, -2, "floor_tex");
 
-    lua_pushstring(L, SEC->ceil_tex.data());
+    push_tex(L, SEC->ceil_tex);
     lua_setfield(L, -2, "ceil_tex");
-
-    return 1;
 }
 
-int wadfab_get_side(lua_State *L) {
-    int index = luaL_checkinteger(L, 1);
-
-    if (index < 0 || index >= ajpoly::num_sidedefs) {
-        return 0;
-    }
-
-    const ajpoly::sidedef_c *SD = ajpoly::Sidedef(index);
-
-    lua_newtable(L);
+static void push_side(lua_State *L, const wadfab_side_t *SD) {
+    lua_createtable(L, 0, 6);
 
     lua_pushinteger(L, SD->x_offset);
     lua_setfield(L, -2, "x_offset");
@@ -293,53 +821,43 @@ int wadfab_get_side(lua_State *L) {
     lua_pushinteger(L, SD->y_offset);
     lua_setfield(L, -2, "y_offset");
 
-    if (SD->sector) {
-        lua_pushinteger(L, SD->sector->index);
+    if (SD->sector >= 0) {
+        lua_pushinteger(L, SD->sector);
         lua_setfield(L, -2, "sector");
     }
 
-    lua_pushstring(L, SD->upper_tex.data());
+    push_tex(L, SD->upper_tex);
     lua_setfield(L, -2, "upper_tex");
 
-    lua_pushstring(L, SD->lower_tex.data());
+    push_tex(L, SD->lower_tex);
     lua_setfield(L, -2, "lower_tex");
 
-    lua_pushstring(L, SD->mid_tex.data());
+    push_tex(L, SD->mid_tex);
     lua_setfield(L, -2, "mid_tex");
-
-    return 1;
 }
 
-int wadfab_get_line(lua_State *L) {
-    int index = luaL_checkinteger(L, 1);
-
-    if (index < 0 || index >= ajpoly::num_linedefs) {
-        return 0;
-    }
-
-    const ajpoly::linedef_c *LD = ajpoly::Linedef(index);
-
-    lua_newtable(L);
+static void push_line(lua_State *L, const wadfab_line_t *LD, bool hexen) {
+    lua_createtable(L, 0, hexen ? 13 : 9);
 
-    lua_pushinteger(L, LD->start->x);
+    lua_pushinteger(L, LD->x1);
     lua_setfield(L, -2, "x1");
 
-    lua_pushinteger(L, LD->start->y);
+    lua_pushinteger(L, LD->y1);
     lua_setfield(L, -2, "y1");
 
-    lua_pushinteger(L, LD->end->x);
+    lua_pushinteger(L, LD->x2);
     lua_setfield(L, -2, "x2");
 
-    lua_pushinteger(L, LD->end->y);
+    lua_pushinteger(L, LD->y2);
     lua_setfield(L, -2, "y2");
 
-    if (LD->right) {
-        lua_pushinteger(L, LD->right->index);
+    if (LD->right >= 0) {
+        lua_pushinteger(L, LD->right);
         lua_setfield(L, -2, "right");
     }
 
-    if (LD->left) {
-        lua_pushinteger(L, LD->left->index);
+    if (LD->left >= 0) {
+        lua_pushinteger(L, LD->left);
         lua_setfield(L, -2, "left");
     }
 
@@ -349,155 +867,191 @@ int wadfab_get_line(lua_State *L) {
     lua_pushinteger(L, LD->flags);
     lua_setfield(L, -2, "flags");
 
-    lua_pushinteger(L, LD->tag);
-    lua_setfield(L, -2, "tag");
+    if (!hexen) {
+        lua_pushinteger(L, LD->tag);
+        lua_setfield(L, -2, "tag");
+        return;
+    }
 
-    return 1;
-}
+    lua_pushinteger(L, LD->args[0]);
+    lua_setfield(L, -2, "arg1");
 
-int wadfab_get_line_hexen(lua_State *L) {
-    int index = luaL_checkinteger(L, 1);
+    lua_pushinteger(L, LD->args[1]);
+    lua_setfield(L, -2, "arg2");
 
-    if (index < 0 || index >= ajpoly::num_linedefs) {
-        return 0;
-    }
+    lua_pushinteger(L, LD->args[2]);
+    lua_setfield(L, -2, "arg3");
 
-    const ajpoly::linedef_c *LD = ajpoly::Linedef(index);
+    lua_pushinteger(L, LD->args[3]);
+    lua_setfield(L, -2, "arg4");
 
-    lua_newtable(L);
+    lua_pushinteger(L, LD->args[4]);
+    lua_setfield(L, -2, "arg5");
+}
 
-    lua_pushinteger(L, LD->start->x);
-    lua_setfield(L, -2, "x1");
+static void push_edge(lua_State *L, int tab_index, const wadfab_edge_t *E) {
+    lua_createtable(L, 0, 5);
 
-    lua_pushinteger(L, LD->start->y);
-    lua_setfield(L, -2, "y1");
+    lua_pushnumber(L, E->x);
+    lua_setfield(L, -2, "x");
 
-    lua_pushinteger(L, LD->end->x);
-    lua_setfield(L, -2, "x2");
+    lua_pushnumber(L, E->y);
+    lua_setfield(L, -2, "y");
 
-    lua_pushinteger(L, LD->end->y);
-    lua_setfield(L, -2, "y2");
+    if (E->line >= 0) {
+        lua_pushinteger(L, E->line);
+        lua_setfield(L, -2, "line");
 
-    if (LD->right) {
-        lua_pushinteger(L, LD->right->index);
-        lua_setfield(L, -2, "right");
-    }
+        lua_pushnumber(L, E->along);
+        lua_setfield(L, -2, "along");
 
-    if (LD->left) {
-        lua_pushinteger(L, LD->left->index);
-        lua_setfield(L, -2, "left");
+        if (E->side >= 0) {
+            lua_pushinteger(L, E->side);
+            lua_setfield(L, -2, "side");
+        }
     }
 
-    lua_pushinteger(L, LD->special);
-    lua_setfield(L, -2, "special");
+    lua_rawseti(L, -2, tab_index);
+}
 
-    lua_pushinteger(L, LD->flags);
-    lua_setfield(L, -2, "flags");
+static void push_coords(lua_State *L, const wadfab_polygon_t *poly) {
+    const wadfab_edge_t *edges = &current_fab->edges[poly->first_edge];
 
-    lua_pushinteger(L, LD->args[0]);
-    lua_setfield(L, -2, "arg1");
+    lua_createtable(L, poly->num_edges, 0);
 
-    lua_pushinteger(L, LD->args[1]);
-    lua_setfield(L, -2, "arg2");
+    for (int i = 0; i < poly->num_edges; i++) {
+        push_edge(L, i + 1, &edges[i]);
+    }
+}
 
-    lua_pushinteger(L, LD->args[2]);
-    lua_setfield(L, -2, "arg3");
+static void push_3d_floor(lua_State *L, const wadfab_3d_floor_t *EF) {
+    lua_createtable(L, 0, 10);
 
-    lua_pushinteger(L, LD->args[3]);
-    lua_setfield(L, -2, "arg4");
+    // BOTTOM
+    lua_pushinteger(L, EF->bottom_h);
+    lua_setfield(L, -2, "bottom_h");
 
-    lua_pushinteger(L, LD->args[4]);
-    lua_setfield(L, -2, "arg5");
+    push_tex(L, EF->bottom_tex);
+    lua_setfield(L, -2, "bottom_tex");
 
-    return 1;
-}
+    // TOP
+    lua_pushinteger(L, EF->top_h);
+    lua_setfield(L, -2, "top_h");
 
-static double calc_along_dist(const ajpoly::edge_c *E) {
-    const ajpoly::linedef_c *LD = E->linedef;
+    push_tex(L, EF->top_tex);
+    lua_setfield(L, -2, "top_tex");
 
-    SYS_ASSERT(LD);
+    // SIDE
+    push_tex(L, EF->side_tex);
+    lua_setfield(L, -2, "side_tex");
 
-    double ref_x = (E->side == 1) ? LD->start->x : LD->end->x;
-    double ref_y = (E->side == 1) ? LD->start->y : LD->end->y;
+    lua_pushinteger(L, EF->x_offset);
+    lua_setfield(L, -2, "x_offset");
 
-    double dx = ref_x - E->end->x;
-    double dy = ref_y - E->end->y;
+    lua_pushinteger(L, EF->y_offset);
+    lua_setfield(L, -2, "y_offset");
 
-    return hypot(dx, dy);
-}
+    // PROPERTIES
+    lua_pushinteger(L, EF->special);
+    lua_setfield(L, -2, "special");
 
-static void push_edge(lua_State *L, int tab_index, const ajpoly::edge_c *E) {
-    lua_newtable(L);
+    lua_pushinteger(L, EF->light);
+    lua_setfield(L, -2, "light");
 
-    // using 'end' coord since edges face outwards
+    if (EF->liquid) {
+        lua_pushinteger(L, 1);
+        lua_setfield(L, -2, "liquid");
+    }
+}
 
-    lua_pushnumber(L, E->end->x);
-    lua_setfield(L, -2, "x");
+int wadfab_get_thing(lua_State *L) {
+    int index = luaL_checkinteger(L, 1);
 
-    lua_pushnumber(L, E->end->y);
-    lua_setfield(L, -2, "y");
+    if (!current_fab || index < 0 ||
+        index >= current_fab->header->num_things) {
+        return 0;
+    }
 
-    if (E->linedef) {
-        lua_pushinteger(L, E->linedef->index);
-        lua_setfield(L, -2, "line");
+    push_thing(L, &current_fab->things[index], false);
+    return 1;
+}
 
-        lua_pushnumber(L, calc_along_dist(E));
-        lua_setfield(L, -2, "along");
+int wadfab_get_thing_hexen(lua_State *L) {
+    int index = luaL_checkinteger(L, 1);
 
-        const ajpoly::sidedef_c *SD;
+    if (!current_fab || index < 0 ||
+        index >= current_fab->header->num_things) {
+        return 0;
+    }
 
-        // we want the "outer" sidedef (the opposite side)
-        if (E->side == 0) {
-            SD = E->linedef->left;
-        } else {
-            SD = E->linedef->right;
-        }
+    push_thing(L, &current_fab->things[index], true);
+    return 1;
+}
 
-        if (SD) {
-            lua_pushinteger(L, SD->index);
-            lua_setfield(L, -2, "side");
-        }
+int wadfab_get_sector(lua_State *L) {
+    int index = luaL_checkinteger(L, 1);
+
+    if (!current_fab || index < 0 ||
+        index >= current_fab->header->num_sectors) {
+        return 0;
     }
 
-    lua_rawseti(L, -2, tab_index);
+    push_sector(L, &current_fab->sectors[index]);
+    return 1;
 }
 
-int wadfab_get_polygon(lua_State *L) {
+int wadfab_get_side(lua_State *L) {
     int index = luaL_checkinteger(L, 1);
 
-    if (index < 0 || index >= ajpoly::num_polygons) {
+    if (!current_fab || index < 0 ||
+        index >= current_fab->header->num_sides) {
         return 0;
     }
 
-    const ajpoly::polygon_c *poly = ajpoly::Polygon(index);
+    push_side(L, &current_fab->sides[index]);
+    return 1;
+}
 
-    // result #1 : SECTOR
-    int sect_id = poly->sector ? poly->sector->index : -1;
+int wadfab_get_line(lua_State *L) {
+    int index = luaL_checkinteger(L, 1);
 
-    if (sect_id == VOID_SECTOR_IDX) {
-        sect_id = -1;
+    if (!current_fab || index < 0 ||
+        index >= current_fab->header->num_lines) {
+        return 0;
     }
 
-    lua_pushinteger(L, sect_id);
+    push_line(L, &current_fab->lines[index], false);
+    return 1;
+}
 
-    // result #2 : COORDS
-    std::vector<ajpoly::edge_c *> edges;
+int wadfab_get_line_hexen(lua_State *L) {
+    int index = luaL_checkinteger(L, 1);
 
-    for (ajpoly::edge_c *E = poly->edge_list; E; E = E->next) {
-        edges.push_back(E);
+    if (!current_fab || index < 0 ||
+        index >= current_fab->header->num_lines) {
+        return 0;
     }
 
-    int edge_num = (int)edges.size();
-
-    lua_createtable(L, edge_num, 0);
+    push_line(L, &current_fab->lines[index], true);
+    return 1;
+}
 
-    for (int tab_index = 1; tab_index <= edge_num; tab_index++) {
-        // the polygon edges are clockwise, but OBLIGE are anti-clockwise.
-        // hence reverse the order.  We also use 'end' instead of 'start'.
+int wadfab_get_polygon(lua_State *L) {
+    int index = luaL_checkinteger(L, 1);
 
-        push_edge(L, tab_index, edges[edge_num - tab_index]);
+    if (!current_fab || index < 0 ||
+        index >= current_fab->header->num_polygons) {
+        return 0;
     }
 
+    const wadfab_polygon_t *poly = &current_fab->polygons[index];
+
+    // result #1 : SECTOR
+    lua_pushinteger(L, poly->sector);
+
+    // result #2 : COORDS
+    push_coords(L, poly);
+
     return 2;
 }
 
@@ -505,70 +1059,123 @@ int wadfab_get_3d_floor(lua_State *L) {
     int poly_idx = luaL_checkinteger(L, 1);
     int floor_idx = luaL_checkinteger(L, 2);
 
-    if (poly_idx < 0 || poly_idx >= ajpoly::num_polygons) {
+    if (!current_fab || poly_idx < 0 ||
+        poly_idx >= current_fab->header->num_polygons) {
         return 0;
     }
 
-    const ajpoly::polygon_c *poly = ajpoly::Polygon(poly_idx);
+    const wadfab_polygon_t *poly = &current_fab->polygons[poly_idx];
 
-    if (!poly->sector || poly->sector->num_floors <= 0) {
+    if (floor_idx < 0 || floor_idx >= poly->num_floors) {
         return 0;
     }
 
-    // determine line and dummy sector
+    const wadfab_3d_floor_t *EF =
+        &current_fab->floors[poly->first_floor + floor_idx];
 
-    const ajpoly::linedef_c *LD = poly->sector->getExtraFloor(floor_idx);
-
-    if (!LD) {
+    if (!EF->valid) {
         return 0;
     }
 
-    const ajpoly::sector_c *SEC = LD->right->sector;
+    push_3d_floor(L, EF);
+    return 1;
+}
 
-    if (!SEC) {
-        return 0;
+//
+// Returns the whole prefab in one go, every list being created at its
+// final size.  Each sector is only made once, polygons just refer to
+// it by number.
+//
+int wadfab_export(lua_State *L) {
+    bool hexen = lua_toboolean(L, 1) ? true : false;
+
+    if (!current_fab) {
+        return luaL_error(L, "wadfab_export: no prefab loaded");
     }
 
-    // save the information
+    const wadfab_header_t *H = current_fab->header;
 
-    lua_newtable(L);
+    lua_createtable(L, 0, 5);
 
-    // BOTTOM
-    lua_pushinteger(L, SEC->floor_h);
-    lua_setfield(L, -2, "bottom_h");
+    // THINGS
+    lua_createtable(L, H->num_things, 0);
 
-    lua_pushstring(L, SEC->floor_tex.data());
-    lua_setfield(L, -2, "bottom_tex");
+    for (int i = 0; i < H->num_things; i++) {
+        push_thing(L, &current_fab->things[i], hexen);
+        lua_rawseti(L, -2, i + 1);
+    }
 
-    // TOP
-    lua_pushinteger(L, SEC->ceil_h);
-    lua_setfield(L, -2, "top_h");
+    lua_setfield(L, -2, "things");
 
-    lua_pushstring(L, SEC->ceil_tex.data());
-    lua_setfield(L, -2, "top_tex");
+    // SECTORS
+    lua_createtable(L, H->num_sectors, 0);
 
-    // SIDE
-    lua_pushstring(L, LD->right->mid_tex.data());
-    lua_setfield(L, -2, "side_tex");
+    for (int i = 0; i < H->num_sectors; i++) {
+        push_sector(L, &current_fab->sectors[i]);
+        lua_rawseti(L, -2, i + 1);
+    }
 
-    lua_pushinteger(L, LD->right->x_offset);
-    lua_setfield(L, -2, "x_offset");
+    lua_setfield(L, -2, "sectors");
 
-    lua_pushinteger(L, LD->right->y_offset);
-    lua_setfield(L, -2, "y_offset");
+    // SIDES
+    lua_createtable(L, H->num_sides, 0);
 
-    // PROPERTIES
-    lua_pushinteger(L, SEC->special);
-    lua_setfield(L, -2, "special");
+    for (int i = 0; i < H->num_sides; i++) {
+        push_side(L, &current_fab->sides[i]);
+        lua_rawseti(L, -2, i + 1);
+    }
 
-    lua_pushinteger(L, SEC->light);
-    lua_setfield(L, -2, "light");
+    lua_setfield(L, -2, "sides");
 
-    if (LD->special == 405) {
-        lua_pushinteger(L, 1);
-        lua_setfield(L, -2, "liquid");
+    // LINES
+    lua_createtable(L, H->num_lines, 0);
+
+    for (int i = 0; i < H->num_lines; i++) {
+        push_line(L, &current_fab->lines[i], hexen);
+        lua_rawseti(L, -2, i + 1);
+    }
+
+    lua_setfield(L, -2, "lines");
+
+    // POLYGONS
+    lua_createtable(L, H->num_polygons, 0);
+
+    for (int i = 0; i < H->num_polygons; i++) {
+        const wadfab_polygon_t *poly = &current_fab->polygons[i];
+
+        // 3D floors stop at the first one which is missing, the same
+        // as calling wadfab_get_3d_floor() until it gives nil.
+        int num_floors = 0;
+
+        while (num_floors < poly->num_floors &&
+               current_fab->floors[poly->first_floor + num_floors].valid) {
+            num_floors++;
+        }
+
+        lua_createtable(L, 0, num_floors > 0 ? 3 : 2);
+
+        lua_pushinteger(L, poly->sector);
+        lua_setfield(L, -2, "sector");
+
+        push_coords(L, poly);
+        lua_setfield(L, -2, "coords");
+
+        if (num_floors > 0) {
+            lua_createtable(L, num_floors, 0);
+
+            for (int f = 0; f < num_floors; f++) {
+                push_3d_floor(L, &current_fab->floors[poly->first_floor + f]);
+                lua_rawseti(L, -2, f + 1);
+            }
+
+            lua_setfield(L, -2, "floors");
+        }
+
+        lua_rawseti(L, -2, i + 1);
     }
 
+    lua_setfield(L, -2, "polygons");
+
     return 1;
 }
 
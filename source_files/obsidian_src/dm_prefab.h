@@ -21,6 +21,10 @@
 #ifndef __OBLIGE_DM_PREFAB_H__
 #define __OBLIGE_DM_PREFAB_H__
 
+// logs (and resets) the number of prefabs read from the cache and
+// the number which had to be polygonated.
+void WadFab_CacheStats();
+
 #endif /* __OBLIGE_DM_PREFAB_H__ */
 
 //--- editor settings ---
@@ -23,10 +23,15 @@
 #include "headers.h"
 
 #include <bitset>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <string>
+#include <thread>
 
 #include "hdr_fltk.h"
 #include "lib_file.h"
+#include "lib_parallel.h"
 #include "lib_util.h"
 #include "lib_wad.h"
 #include "m_cookie.h"
@@ -42,6 +47,9 @@
 // SLUMP for Vanilla Doom
 #include "slump_main.h"
 
+// ZDBSP for the nodes
+#include "zdmain.h"
+
 extern void CSG_DOOM_Write();
 
 // extern void CSG_TestRegions_Doom();
@@ -62,9 +70,12 @@ static qLump_c *vertex_lump;
 static qLump_c *sector_lump;
 static qLump_c *sidedef_lump;
 static qLump_c *linedef_lump;
-static qLump_c *textmap_lump;
 static qLump_c *endmap_lump;
 
+// in UDMF mode the map is kept as typed values, it only becomes text
+// when it is written (by ZDBSP when building nodes).
+static FUDMFMap *udmf_map;
+
 static int errors_seen;
 
 std::string current_engine;
@@ -74,12 +85,6 @@ bool build_reject;
 
 static bool UDMF_mode;
 
-int udmf_vertexes;
-int udmf_sectors;
-int udmf_linedefs;
-int udmf_things;
-int udmf_sidedefs;
-
 enum wad_section_e {
     SECTION_Patches = 0,
     SECTION_Sprites,
@@ -107,11 +112,40 @@ static const char *section_markers[NUM_SECTIONS][2] = {
 //  WAD OUTPUT
 //------------------------------------------------------------------------
 
+// the lumps are kept in memory until the end, so that ZDBSP can build
+// the nodes from them without another trip through the disk.
 namespace Doom {
-void WriteLump(std::string_view name, const void *data, u32_t len) {
+static std::vector<qLump_c *> wad_lumps;
+
+// takes ownership of the lump
+static void AddLump(std::string_view name, qLump_c *lump) {
     SYS_ASSERT(name.size() <= 8);
 
-    WAD_NewLump(name.data());
+    lump->name = name;
+
+    wad_lumps.push_back(lump);
+}
+
+void WriteLump(std::string_view name, const void *data, u32_t len) {
+    qLump_c *lump = new qLump_c();
+
+    if (len > 0) {
+        lump->Append(data, len);
+    }
+
+    AddLump(name, lump);
+}
+
+static void FreeWadLumps() {
+    for (qLump_c *lump : wad_lumps) {
+        delete lump;
+    }
+
+    wad_lumps.clear();
+}
+
+static void FlushLump(std::string_view name, const void *data, int len) {
+    WAD_NewLump(name);
 
     if (len > 0) {
         if (!WAD_AppendData(data, len)) {
@@ -165,8 +199,9 @@ static void WriteSections() {
         WriteLump(section_markers[k][0], nullptr, 0);
 
         for (auto *lump : *sections[k]) {
-            WriteLump(lump->name.c_str(), lump);
+            AddLump(lump->name, lump);
         }
+        sections[k]->clear();
 
         WriteLump(section_markers[k][1], nullptr, 0);
     }
@@ -174,6 +209,238 @@ static void WriteSections() {
 
 }  // namespace Doom
 
+//------------------------------------------------------------------------
+//  ZDBSP NODE BUILDING
+//------------------------------------------------------------------------
+
+// Each map is given to ZDBSP as soon as EndLevel() has produced its
+// lumps.  When more than one worker is available the nodes are built
+// on a background thread while the next map is being generated, and
+// Finish() only has to wait for whatever is left in the queue.
+
+namespace Doom {
+
+struct node_job_t {
+    // range of the map's lumps in wad_lumps
+    size_t first, last;
+
+    std::vector<FMemoryLump> input;
+    std::vector<qLump_c *> output;
+
+    // the typed TEXTMAP of a UDMF map (owned by the job)
+    FUDMFMap *udmf;
+
+    int result;
+};
+
+static bool want_nodes;
+
+static std::vector<node_job_t *> node_jobs;
+static size_t node_jobs_done;
+static bool node_stop;
+static bool node_cancel;
+
+static std::thread node_thread;
+static std::mutex node_mutex;
+static std::condition_variable node_cond;
+
+static bool WantNodes() {
+    if (StringCaseCmp(current_engine, "edge") == 0) {
+        if (!UDMF_mode) {
+            if (!build_nodes) {
+                LogPrintf("Skipping nodes per user selection...\n");
+                return false;
+            }
+        }
+    }
+
+    if (StringCaseCmp(current_engine, "zdoom") == 0) {
+        if (!build_nodes) {
+            LogPrintf("Skipping nodes per user selection...\n");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void RunNodeJob(node_job_t *job) {
+    job->result = zdmain(
+        job->input,
+        [job](const FMemoryLump &lump) {
+            qLump_c *out = new qLump_c();
+            out->name = lump.Name;
+            if (lump.Size > 0) {
+                out->Append(lump.Data, lump.Size);
+            }
+            job->output.push_back(out);
+        },
+        current_engine, UDMF_mode, build_reject);
+}
+
+static void NodeBuilderThread() {
+    std::unique_lock<std::mutex> lock(node_mutex);
+
+    for (;;) {
+        node_cond.wait(lock, [] {
+            return node_cancel || node_stop ||
+                   node_jobs_done < node_jobs.size();
+        });
+
+        if (node_cancel || node_jobs_done >= node_jobs.size()) {
+            return;
+        }
+
+        node_job_t *job = node_jobs[node_jobs_done];
+
+        lock.unlock();
+        RunNodeJob(job);
+        lock.lock();
+
+        node_jobs_done++;
+        node_cond.notify_all();
+    }
+}
+
+static void StartNodeBuilder() {
+    want_nodes = WantNodes();
+
+    node_jobs_done = 0;
+    node_stop = false;
+    node_cancel = false;
+
+    NumThreads = PAR_NumWorkers();
+
+    // with a single worker the maps are simply done in Finish()
+    if (want_nodes && PAR_NumWorkers() > 1) {
+        node_thread = std::thread(NodeBuilderThread);
+    }
+}
+
+static void StopNodeBuilder(bool cancel) {
+    if (node_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(node_mutex);
+            node_stop = true;
+            node_cancel = cancel;
+        }
+        node_cond.notify_all();
+
+        node_thread.join();
+    }
+}
+
+static void FreeNodeJobs() {
+    for (node_job_t *job : node_jobs) {
+        for (qLump_c *lump : job->output) {
+            delete lump;
+        }
+        delete job->udmf;
+        delete job;
+    }
+
+    node_jobs.clear();
+    node_jobs_done = 0;
+}
+
+// the lumps in [first, last) of wad_lumps make up a single map.
+// For a UDMF map the TEXTMAP lump is empty and udmf holds the real
+// thing, the job takes ownership of it.
+static void QueueNodes(size_t first, size_t last, FUDMFMap *udmf) {
+    if (!want_nodes) {
+        delete udmf;
+        return;
+    }
+
+    node_job_t *job = new node_job_t;
+
+    job->first = first;
+    job->last = last;
+    job->udmf = udmf;
+    job->result = 0;
+
+    for (size_t i = first; i < last; i++) {
+        const qLump_c *lump = wad_lumps[i];
+        job->input.push_back({lump->name, lump->GetBuffer(), lump->GetSize()});
+
+        if (udmf && lump->name == "TEXTMAP") {
+            job->input.back().UDMF = udmf;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(node_mutex);
+        node_jobs.push_back(job);
+    }
+    node_cond.notify_all();
+}
+
+// waits for every queued map to be done.  Returns false if the user
+// cancelled or ZDBSP failed on any of them.
+static bool FinishNodes() {
+    if (node_thread.joinable()) {
+        std::unique_lock<std::mutex> lock(node_mutex);
+
+        while (node_jobs_done < node_jobs.size()) {
+            node_cond.wait_for(lock, std::chrono::milliseconds(50));
+
+            lock.unlock();
+            Main::Ticker();
+            lock.lock();
+
+            if (main_action >= MAIN_CANCEL) {
+                break;
+            }
+        }
+
+        lock.unlock();
+        StopNodeBuilder(main_action >= MAIN_CANCEL);
+    } else {
+        for (; node_jobs_done < node_jobs.size(); node_jobs_done++) {
+            RunNodeJob(node_jobs[node_jobs_done]);
+
+            Main::Ticker();
+
+            if (main_action >= MAIN_CANCEL) {
+                break;
+            }
+        }
+    }
+
+    if (node_jobs_done < node_jobs.size()) {
+        return false;
+    }
+
+    for (const node_job_t *job : node_jobs) {
+        if (job->result != 0) {
+            Main::ProgStatus(_("ZDBSP Error!"));
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// for WADs which were written by something else (i.e. SLUMP)
+static bool BuildNodes(std::filesystem::path filename) {
+    LogPrintf("\n");
+
+    if (!WantNodes()) {
+        return true;
+    }
+
+    NumThreads = PAR_NumWorkers();
+
+    if (zdmain(filename, current_engine, UDMF_mode, build_reject) != 0) {
+        Main::ProgStatus(_("ZDBSP Error!"));
+        return false;
+    }
+
+    return true;
+}
+
+}  // namespace Doom
+
 void Doom::AddSectionLump(char ch, std::string name, qLump_c *lump) {
     int k;
     switch (ch) {
@@ -211,6 +478,8 @@ bool Doom::StartWAD(std::filesystem::path filename) {
     errors_seen = 0;
 
     ClearSections();
+    FreeWadLumps();
+    FreeNodeJobs();
 
     qLump_c *info = BSP_CreateInfoLump();
     WriteLump("OBLIGDAT", info);
@@ -220,14 +489,66 @@ bool Doom::StartWAD(std::filesystem::path filename) {
 }
 
 bool Doom::EndWAD() {
+    // any maps still in the node builder are not wanted anymore
+    StopNodeBuilder(true);
+    FreeNodeJobs();
+
     WriteSections();
     ClearSections();
 
+    for (qLump_c *lump : wad_lumps) {
+        FlushLump(lump->name, lump->GetBuffer(), lump->GetSize());
+    }
+    FreeWadLumps();
+
     WAD_CloseWrite();
 
     return errors_seen == 0;
 }
 
+namespace Doom {
+// like EndWAD(), but the maps are replaced with the output of ZDBSP
+static bool EndWAD_WithNodes() {
+    if (!want_nodes) {
+        EndWAD();
+        return true;
+    }
+
+    WriteSections();
+    ClearSections();
+
+    bool ok = FinishNodes();
+
+    if (ok) {
+        size_t next_job = 0;
+
+        for (size_t i = 0; i < wad_lumps.size(); i++) {
+            if (next_job < node_jobs.size() &&
+                node_jobs[next_job]->first == i) {
+                const node_job_t *job = node_jobs[next_job++];
+
+                for (const qLump_c *lump : job->output) {
+                    FlushLump(lump->name, lump->GetBuffer(), lump->GetSize());
+                }
+
+                i = job->last - 1;
+                continue;
+            }
+
+            const qLump_c *lump = wad_lumps[i];
+            FlushLump(lump->name, lump->GetBuffer(), lump->GetSize());
+        }
+    }
+
+    FreeNodeJobs();
+    FreeWadLumps();
+
+    WAD_CloseWrite();
+
+    return ok;
+}
+}  // namespace Doom
+
 namespace Doom {
 static void FreeLumps() {
     delete header_lump;
@@ -244,8 +565,8 @@ static void FreeLumps() {
         delete linedef_lump;
         linedef_lump = nullptr;
     } else {
-        delete textmap_lump;
-        textmap_lump = nullptr;
+        delete udmf_map;
+        udmf_map = nullptr;
         delete endmap_lump;
         endmap_lump = nullptr;
     }
@@ -263,13 +584,13 @@ void Doom::BeginLevel() {
         linedef_lump = new qLump_c();
         sidedef_lump = new qLump_c();
     } else {
-        textmap_lump = new qLump_c();
+        udmf_map = new FUDMFMap();
         if (sub_format == SUBFMT_Hexen) {
-            textmap_lump->Printf("namespace = \"Hexen\";\n\n");
+            udmf_map->AddString("namespace", "Hexen");
         } else {
-            textmap_lump->Printf("namespace = \"ZDoomTranslated\";\n\n");
+            udmf_map->AddString("namespace", "ZDoomTranslated");
             if (current_engine == "eternity") {
-                textmap_lump->Printf("ee_compat = true;\n\n");
+                udmf_map->AddBool("ee_compat", true);
             }
         }
         endmap_lump = new qLump_c();
@@ -283,22 +604,42 @@ void Doom::EndLevel(std::string_view level_name) {
         header_lump->Append(nuls, 1);
     }
 
-    WriteLump(level_name, header_lump);
+    size_t first_lump = wad_lumps.size();
+
+    // the lumps are handed over as-is, FreeLumps() only clears them
+    AddLump(level_name, header_lump);
+    header_lump = nullptr;
 
     if (UDMF_mode) {
-        WriteLump("TEXTMAP", textmap_lump);
+        qLump_c *textmap = new qLump_c();
+
+        // when ZDBSP runs it writes the text, see QueueNodes()
+        if (!want_nodes) {
+            std::string text;
+            udmf_map->WriteText(text);
+            textmap->Append(text.data(), text.size());
+        }
+
+        AddLump("TEXTMAP", textmap);
     }
 
     if (not UDMF_mode) {
-        WriteLump("THINGS", thing_lump);
-        WriteLump("LINEDEFS", linedef_lump);
-        WriteLump("SIDEDEFS", sidedef_lump);
-        WriteLump("VERTEXES", vertex_lump);
+        AddLump("THINGS", thing_lump);
+        AddLump("LINEDEFS", linedef_lump);
+        AddLump("SIDEDEFS", sidedef_lump);
+        AddLump("VERTEXES", vertex_lump);
 
         WriteLump("SEGS", NULL, 0);
         WriteLump("SSECTORS", NULL, 0);
         WriteLump("NODES", NULL, 0);
-        WriteLump("SECTORS", sector_lump);
+        AddLump("SECTORS", sector_lump);
+
+        thing_lump = nullptr;
+        linedef_lump = nullptr;
+        sidedef_lump = nullptr;
+        vertex_lump = nullptr;
+        sector_lump = nullptr;
+
         if (sub_format == SUBFMT_Hexen) {
             WriteBehavior();
         }
@@ -309,7 +650,12 @@ void Doom::EndLevel(std::string_view level_name) {
         WriteLump("ENDMAP", NULL, 0);
     }
 
+    FUDMFMap *udmf = udmf_map;
+    udmf_map = nullptr;
+
     FreeLumps();
+
+    QueueNodes(first_lump, wad_lumps.size(), udmf);
 }
 
 //------------------------------------------------------------------------
@@ -341,14 +687,19 @@ void Doom::AddVertex(int x, int y) {
         vert.y = LE_S16(y);
         vertex_lump->Append(&vert, sizeof(vert));
     } else {
-        textmap_lump->Printf("\nvertex\n{\n");
-        textmap_lump->Printf("\tx = %f;\n", (double)x);
-        textmap_lump->Printf("\ty = %f;\n", (double)y);
-        textmap_lump->Printf("}\n");
-        udmf_vertexes += 1;
+        udmf_map->BeginBlock(UDMF_Vertex);
+        udmf_map->AddFloat("x", x);
+        udmf_map->AddFloat("y", y);
     }
 }
 
+// the texture fields are not NUL terminated, but any unused part
+// must be zeroed (the name itself may be shorter than 8 chars).
+static void CopyTexName(const std::string &name, std::array<char, 8> &dest) {
+    dest.fill(0);
+    std::copy_n(name.data(), MIN(name.size(), dest.size()), dest.data());
+}
+
 void Doom::AddSector(int f_h, std::string f_tex, int c_h, std::string c_tex,
                      int light, int special, int tag) {
     if (not UDMF_mode) {
@@ -357,24 +708,22 @@ void Doom::AddSector(int f_h, std::string f_tex, int c_h, std::string c_tex,
         sec.floor_h = LE_S16(f_h);
         sec.ceil_h = LE_S16(c_h);
 
-        std::copy(f_tex.data(), f_tex.data() + 8, sec.floor_tex.data());
-        std::copy(c_tex.data(), c_tex.data() + 8, sec.ceil_tex.data());
+        CopyTexName(f_tex, sec.floor_tex);
+        CopyTexName(c_tex, sec.ceil_tex);
 
         sec.light = LE_U16(light);
         sec.special = LE_U16(special);
         sec.tag = LE_S16(tag);
         sector_lump->Append(&sec, sizeof(sec));
     } else {
-        textmap_lump->Printf("\nsector\n{\n");
-        textmap_lump->Printf("\theightfloor = %d;\n", f_h);
-        textmap_lump->Printf("\theightceiling = %d;\n", c_h);
-        textmap_lump->Printf("\ttexturefloor = \"%s\";\n", f_tex.c_str());
-        textmap_lump->Printf("\ttextureceiling = \"%s\";\n", c_tex.c_str());
-        textmap_lump->Printf("\tlightlevel = %d;\n", light);
-        textmap_lump->Printf("\tspecial = %d;\n", special);
-        textmap_lump->Printf("\tid = %d;\n", tag);
-        textmap_lump->Printf("}\n");
-        udmf_sectors += 1;
+        udmf_map->BeginBlock(UDMF_Sector);
+        udmf_map->AddInt("heightfloor", f_h);
+        udmf_map->AddInt("heightceiling", c_h);
+        udmf_map->AddString("texturefloor", f_tex);
+        udmf_map->AddString("textureceiling", c_tex);
+        udmf_map->AddInt("lightlevel", light);
+        udmf_map->AddInt("special", special);
+        udmf_map->AddInt("id", tag);
     }
 }
 
@@ -385,23 +734,21 @@ void Doom::AddSidedef(int sector, std::string l_tex, std::string m_tex,
 
         side.sector = LE_S16(sector);
 
-        std::copy(l_tex.data(), l_tex.data() + 8, side.lower_tex.data());
-        std::copy(m_tex.data(), m_tex.data() + 8, side.mid_tex.data());
-        std::copy(u_tex.data(), u_tex.data() + 8, side.upper_tex.data());
+        CopyTexName(l_tex, side.lower_tex);
+        CopyTexName(m_tex, side.mid_tex);
+        CopyTexName(u_tex, side.upper_tex);
 
         side.x_offset = LE_S16(x_offset);
         side.y_offset = LE_S16(y_offset);
         sidedef_lump->Append(&side, sizeof(side));
     } else {
-        textmap_lump->Printf("\nsidedef\n{\n");
-        textmap_lump->Printf("\toffsetx = %d;\n", x_offset);
-        textmap_lump->Printf("\toffsety = %d;\n", y_offset);
-        textmap_lump->Printf("\ttexturetop = \"%s\";\n", u_tex.c_str());
-        textmap_lump->Printf("\ttexturemiddle = \"%s\";\n", m_tex.c_str());
-        textmap_lump->Printf("\ttexturebottom = \"%s\";\n", l_tex.c_str());
-        textmap_lump->Printf("\tsector = %d;\n", sector);
-        textmap_lump->Printf("}\n");
-        udmf_sidedefs += 1;
+        udmf_map->BeginBlock(UDMF_Sidedef);
+        udmf_map->AddInt("offsetx", x_offset);
+        udmf_map->AddInt("offsety", y_offset);
+        udmf_map->AddString("texturetop", u_tex);
+        udmf_map->AddString("texturemiddle", m_tex);
+        udmf_map->AddString("texturebottom", l_tex);
+        udmf_map->AddInt("sector", sector);
     }
 }
 
@@ -422,47 +769,45 @@ void Doom::AddLinedef(int vert1, int vert2, int side1, int side2, int type,
             line.tag = LE_U16(tag);
             linedef_lump->Append(&line, sizeof(line));
         } else {
-            textmap_lump->Printf("\nlinedef\n{\n");
-            textmap_lump->Printf("\tid = %d;\n", tag);
-            textmap_lump->Printf("\tv1 = %d;\n", vert1);
-            textmap_lump->Printf("\tv2 = %d;\n", vert2);
-            textmap_lump->Printf("\tsidefront = %d;\n", side1 < 0 ? -1 : side1);
-            textmap_lump->Printf("\tsideback = %d;\n", side2 < 0 ? -1 : side2);
-            textmap_lump->Printf("\targ0 = %d;\n", tag);
-            textmap_lump->Printf("\tspecial = %d;\n", type);
+            udmf_map->BeginBlock(UDMF_Linedef);
+            udmf_map->AddInt("id", tag);
+            udmf_map->AddInt("v1", vert1);
+            udmf_map->AddInt("v2", vert2);
+            udmf_map->AddInt("sidefront", side1 < 0 ? -1 : side1);
+            udmf_map->AddInt("sideback", side2 < 0 ? -1 : side2);
+            udmf_map->AddInt("arg0", tag);
+            udmf_map->AddInt("special", type);
             std::bitset<16> udmf_flags(flags);
             if (udmf_flags.test(0)) {
-                textmap_lump->Printf("\tblocking = true;\n");
+                udmf_map->AddBool("blocking", true);
             }
             if (udmf_flags.test(1)) {
-                textmap_lump->Printf("\tblockmonsters = true;\n");
+                udmf_map->AddBool("blockmonsters", true);
             }
             if (udmf_flags.test(2)) {
-                textmap_lump->Printf("\ttwosided = true;\n");
+                udmf_map->AddBool("twosided", true);
             }
             if (udmf_flags.test(3)) {
-                textmap_lump->Printf("\tdontpegtop = true;\n");
+                udmf_map->AddBool("dontpegtop", true);
             }
             if (udmf_flags.test(4)) {
-                textmap_lump->Printf("\tdontpegbottom = true;\n");
+                udmf_map->AddBool("dontpegbottom", true);
             }
             if (udmf_flags.test(5)) {
-                textmap_lump->Printf("\tsecret = true;\n");
+                udmf_map->AddBool("secret", true);
             }
             if (udmf_flags.test(6)) {
-                textmap_lump->Printf("\tblocksound = true;\n");
+                udmf_map->AddBool("blocksound", true);
             }
             if (udmf_flags.test(7)) {
-                textmap_lump->Printf("\tdontdraw = true;\n");
+                udmf_map->AddBool("dontdraw", true);
             }
             if (udmf_flags.test(8)) {
-                textmap_lump->Printf("\tmapped = true;\n");
+                udmf_map->AddBool("mapped", true);
             }
             if (udmf_flags.test(9)) {
-                textmap_lump->Printf("\tpassuse = true;\n");
+                udmf_map->AddBool("passuse", true);
             }
-            textmap_lump->Printf("}\n");
-            udmf_linedefs += 1;
         }
     } else  // Hexen format
     {
@@ -489,79 +834,77 @@ void Doom::AddLinedef(int vert1, int vert2, int side1, int side2, int type,
 
             linedef_lump->Append(&line, sizeof(line));
         } else {
-            textmap_lump->Printf("\nlinedef\n{\n");
+            udmf_map->BeginBlock(UDMF_Linedef);
             if (type == 121) {
-                textmap_lump->Printf("\tid = %d;\n", args[0]);
+                udmf_map->AddInt("id", args[0]);
             }
-            textmap_lump->Printf("\tv1 = %d;\n", vert1);
-            textmap_lump->Printf("\tv2 = %d;\n", vert2);
-            textmap_lump->Printf("\tsidefront = %d;\n", side1 < 0 ? -1 : side1);
-            textmap_lump->Printf("\tsideback = %d;\n", side2 < 0 ? -1 : side2);
+            udmf_map->AddInt("v1", vert1);
+            udmf_map->AddInt("v2", vert2);
+            udmf_map->AddInt("sidefront", side1 < 0 ? -1 : side1);
+            udmf_map->AddInt("sideback", side2 < 0 ? -1 : side2);
             if (type == 121) {
-                textmap_lump->Printf("\tspecial = 0;\n");
-                textmap_lump->Printf("\targ0 = 0;\n");
+                udmf_map->AddInt("special", 0);
+                udmf_map->AddInt("arg0", 0);
             } else {
-                textmap_lump->Printf("\tspecial = %d;\n", type);
-                textmap_lump->Printf("\targ0 = %d;\n", args[0]);
+                udmf_map->AddInt("special", type);
+                udmf_map->AddInt("arg0", args[0]);
             }
-            textmap_lump->Printf("\targ1 = %d;\n", args[1]);
-            textmap_lump->Printf("\targ2 = %d;\n", args[2]);
-            textmap_lump->Printf("\targ3 = %d;\n", args[3]);
-            textmap_lump->Printf("\targ4 = %d;\n", args[4]);
+            udmf_map->AddInt("arg1", args[1]);
+            udmf_map->AddInt("arg2", args[2]);
+            udmf_map->AddInt("arg3", args[3]);
+            udmf_map->AddInt("arg4", args[4]);
             std::bitset<16> udmf_flags(flags);
             if (udmf_flags.test(0)) {
-                textmap_lump->Printf("\tblocking = true;\n");
+                udmf_map->AddBool("blocking", true);
             }
             if (udmf_flags.test(1)) {
-                textmap_lump->Printf("\tblockmonsters = true;\n");
+                udmf_map->AddBool("blockmonsters", true);
             }
             if (udmf_flags.test(2)) {
-                textmap_lump->Printf("\ttwosided = true;\n");
+                udmf_map->AddBool("twosided", true);
             }
             if (udmf_flags.test(3)) {
-                textmap_lump->Printf("\tdontpegtop = true;\n");
+                udmf_map->AddBool("dontpegtop", true);
             }
             if (udmf_flags.test(4)) {
-                textmap_lump->Printf("\tdontpegbottom = true;\n");
+                udmf_map->AddBool("dontpegbottom", true);
             }
             if (udmf_flags.test(5)) {
-                textmap_lump->Printf("\tsecret = true;\n");
+                udmf_map->AddBool("secret", true);
             }
             if (udmf_flags.test(6)) {
-                textmap_lump->Printf("\tblocksound = true;\n");
+                udmf_map->AddBool("blocksound", true);
             }
             if (udmf_flags.test(7)) {
-                textmap_lump->Printf("\tdontdraw = true;\n");
+                udmf_map->AddBool("dontdraw", true);
             }
             if (udmf_flags.test(8)) {
-                textmap_lump->Printf("\tmapped = true;\n");
+                udmf_map->AddBool("mapped", true);
             }
             if (udmf_flags.test(9)) {
-                textmap_lump->Printf("\trepeatspecial = true;\n");
+                udmf_map->AddBool("repeatspecial", true);
             }
             int spac = (flags & 0x1C00) >> 10;
             if (type > 0) {
                 if (spac == 0) {
-                    textmap_lump->Printf("\tplayercross = true;\n");
+                    udmf_map->AddBool("playercross", true);
                 }
                 if (spac == 1) {
-                    textmap_lump->Printf("\tplayeruse = true;\n");
+                    udmf_map->AddBool("playeruse", true);
                 }
                 if (spac == 2) {
-                    textmap_lump->Printf("\tmonstercross = true;\n");
+                    udmf_map->AddBool("monstercross", true);
                 }
                 if (spac == 3) {
-                    textmap_lump->Printf("\timpact = true;\n");
+                    udmf_map->AddBool("impact", true);
                 }
                 if (spac == 4) {
-                    textmap_lump->Printf("\tplayerpush = true;\n");
+                    udmf_map->AddBool("playerpush", true);
                 }
                 if (spac == 5) {
-                    textmap_lump->Printf("\tmissilecross = true;\n");
+                    udmf_map->AddBool("missilecross", true);
                 }
             }
-            textmap_lump->Printf("}\n");
-            udmf_linedefs += 1;
         }
     }
 }
@@ -585,51 +928,49 @@ void Doom::AddThing(int x, int y, int h, int type, int angle, int options,
             thing.options = LE_U16(options);
             thing_lump->Append(&thing, sizeof(thing));
         } else {
-            textmap_lump->Printf("\nthing\n{\n");
-            textmap_lump->Printf("\tx = %f;\n", (double)x);
-            textmap_lump->Printf("\ty = %f;\n", (double)y);
-            textmap_lump->Printf("\ttype = %d;\n", type);
-            textmap_lump->Printf("\tangle = %d;\n", angle);
+            udmf_map->BeginBlock(UDMF_Thing);
+            udmf_map->AddFloat("x", x);
+            udmf_map->AddFloat("y", y);
+            udmf_map->AddInt("type", type);
+            udmf_map->AddInt("angle", angle);
             std::bitset<16> udmf_flags(options);
             if (udmf_flags.test(0)) {
-                textmap_lump->Printf("\tskill1 = true;\n");
-                textmap_lump->Printf("\tskill2 = true;\n");
+                udmf_map->AddBool("skill1", true);
+                udmf_map->AddBool("skill2", true);
             }
             if (udmf_flags.test(1)) {
-                textmap_lump->Printf("\tskill3 = true;\n");
+                udmf_map->AddBool("skill3", true);
             }
             if (udmf_flags.test(2)) {
-                textmap_lump->Printf("\tskill4 = true;\n");
-                textmap_lump->Printf("\tskill5 = true;\n");
+                udmf_map->AddBool("skill4", true);
+                udmf_map->AddBool("skill5", true);
             }
             if (udmf_flags.test(3)) {
-                textmap_lump->Printf("\tambush = true;\n");
+                udmf_map->AddBool("ambush", true);
             }
             if (udmf_flags.test(4)) {
-                textmap_lump->Printf("\tsingle = false;\n");
+                udmf_map->AddBool("single", false);
             } else {
-                textmap_lump->Printf("\tsingle = true;\n");
+                udmf_map->AddBool("single", true);
             }
             if (udmf_flags.test(5)) {
-                textmap_lump->Printf("\tdm = false;\n");
+                udmf_map->AddBool("dm", false);
             } else {
-                textmap_lump->Printf("\tdm = true;\n");
+                udmf_map->AddBool("dm", true);
             }
             if (udmf_flags.test(6)) {
-                textmap_lump->Printf("\tcoop = false;\n");
+                udmf_map->AddBool("coop", false);
             } else {
-                textmap_lump->Printf("\tcoop = true;\n");
+                udmf_map->AddBool("coop", true);
             }
             if (udmf_flags.test(7)) {
-                textmap_lump->Printf("\tfriend = true;\n");
+                udmf_map->AddBool("friend", true);
             }
             // Testing fix for compatibility with ZDoom mods that add classes in
             // games other than Hexen
-            textmap_lump->Printf("\tclass1 = true;\n");
-            textmap_lump->Printf("\tclass2 = true;\n");
-            textmap_lump->Printf("\tclass3 = true;\n");
-            textmap_lump->Printf("}\n");
-            udmf_things += 1;
+            udmf_map->AddBool("class1", true);
+            udmf_map->AddBool("class2", true);
+            udmf_map->AddBool("class3", true);
         }
     } else  // Hexen format
     {
@@ -656,59 +997,57 @@ void Doom::AddThing(int x, int y, int h, int type, int angle, int options,
 
             thing_lump->Append(&thing, sizeof(thing));
         } else {
-            textmap_lump->Printf("\nthing\n{\n");
-            textmap_lump->Printf("\tid = %d;\n", tid);
-            textmap_lump->Printf("\tx = %f;\n", (double)x);
-            textmap_lump->Printf("\ty = %f;\n", (double)y);
-            textmap_lump->Printf("\theight = %f;\n", (double)h);
-            textmap_lump->Printf("\ttype = %d;\n", type);
-            textmap_lump->Printf("\tangle = %d;\n", angle);
+            udmf_map->BeginBlock(UDMF_Thing);
+            udmf_map->AddInt("id", tid);
+            udmf_map->AddFloat("x", x);
+            udmf_map->AddFloat("y", y);
+            udmf_map->AddFloat("height", h);
+            udmf_map->AddInt("type", type);
+            udmf_map->AddInt("angle", angle);
             std::bitset<16> udmf_flags(options);
             if (udmf_flags.test(0)) {
-                textmap_lump->Printf("\tskill1 = true;\n");
-                textmap_lump->Printf("\tskill2 = true;\n");
+                udmf_map->AddBool("skill1", true);
+                udmf_map->AddBool("skill2", true);
             }
             if (udmf_flags.test(1)) {
-                textmap_lump->Printf("\tskill3 = true;\n");
+                udmf_map->AddBool("skill3", true);
             }
             if (udmf_flags.test(2)) {
-                textmap_lump->Printf("\tskill4 = true;\n");
-                textmap_lump->Printf("\tskill5 = true;\n");
+                udmf_map->AddBool("skill4", true);
+                udmf_map->AddBool("skill5", true);
             }
             if (udmf_flags.test(3)) {
-                textmap_lump->Printf("\tambush = true;\n");
+                udmf_map->AddBool("ambush", true);
             }
             if (udmf_flags.test(4)) {
-                textmap_lump->Printf("\tdormant = true;\n");
+                udmf_map->AddBool("dormant", true);
             }
             if (udmf_flags.test(5)) {
-                textmap_lump->Printf("\tclass1 = true;\n");
+                udmf_map->AddBool("class1", true);
             }
             if (udmf_flags.test(6)) {
-                textmap_lump->Printf("\tclass2 = true;\n");
+                udmf_map->AddBool("class2", true);
             }
             if (udmf_flags.test(7)) {
-                textmap_lump->Printf("\tclass3 = true;\n");
+                udmf_map->AddBool("class3", true);
             }
             if (udmf_flags.test(8)) {
-                textmap_lump->Printf("\tsingle = true;\n");
+                udmf_map->AddBool("single", true);
             }
             if (udmf_flags.test(9)) {
-                textmap_lump->Printf("\tcoop = true;\n");
+                udmf_map->AddBool("coop", true);
             }
             if (udmf_flags.test(10)) {
-                textmap_lump->Printf("\tdm = true;\n");
+                udmf_map->AddBool("dm", true);
             }
-            textmap_lump->Printf("\tspecial = %d;\n", special);
+            udmf_map->AddInt("special", special);
             if (args) {
-                textmap_lump->Printf("\targ0 = %d;\n", args[0]);
-                textmap_lump->Printf("\targ1 = %d;\n", args[1]);
-                textmap_lump->Printf("\targ2 = %d;\n", args[2]);
-                textmap_lump->Printf("\targ3 = %d;\n", args[3]);
-                textmap_lump->Printf("\targ4 = %d;\n", args[4]);
-            }
-            textmap_lump->Printf("}\n");
-            udmf_things += 1;
+                udmf_map->AddInt("arg0", args[0]);
+                udmf_map->AddInt("arg1", args[1]);
+                udmf_map->AddInt("arg2", args[2]);
+                udmf_map->AddInt("arg3", args[3]);
+                udmf_map->AddInt("arg4", args[4]);
+            }
         }
     }
 }
@@ -717,21 +1056,21 @@ int Doom::NumVertexes() {
     if (not UDMF_mode) {
         return vertex_lump->GetSize() / sizeof(raw_vertex_t);
     }
-    return udmf_vertexes;
+    return udmf_map->NumBlocks(UDMF_Vertex);
 }
 
 int Doom::NumSectors() {
     if (not UDMF_mode) {
         return sector_lump->GetSize() / sizeof(raw_sector_t);
     }
-    return udmf_sectors;
+    return udmf_map->NumBlocks(UDMF_Sector);
 }
 
 int Doom::NumSidedefs() {
     if (not UDMF_mode) {
         return sidedef_lump->GetSize() / sizeof(raw_sidedef_t);
     }
-    return udmf_sidedefs;
+    return udmf_map->NumBlocks(UDMF_Sidedef);
 }
 
 int Doom::NumLinedefs() {
@@ -742,7 +1081,7 @@ int Doom::NumLinedefs() {
 
         return linedef_lump->GetSize() / sizeof(raw_linedef_t);
     }
-    return udmf_linedefs;
+    return udmf_map->NumBlocks(UDMF_Linedef);
 }
 
 int Doom::NumThings() {
@@ -753,47 +1092,9 @@ int Doom::NumThings() {
 
         return thing_lump->GetSize() / sizeof(raw_thing_t);
     }
-    return udmf_things;
+    return udmf_map->NumBlocks(UDMF_Thing);
 }
 
-//----------------------------------------------------------------------------
-//  ZDBSP NODE BUILDING
-//----------------------------------------------------------------------------
-
-#include "zdmain.h"
-
-namespace Doom {
-
-static bool BuildNodes(std::filesystem::path filename) {
-    LogPrintf("\n");
-
-    if (StringCaseCmp(current_engine, "edge") == 0) {
-        if (!UDMF_mode) {
-            if (!build_nodes) {
-                LogPrintf("Skipping nodes per user selection...\n");
-                return true;
-            }
-        }
-    }
-    
-    if (StringCaseCmp(current_engine, "zdoom") == 0) {
-        if (!build_nodes) {
-            LogPrintf("Skipping nodes per user selection...\n");
-            return true;
-        }
-    }
-        
-    if (zdmain(filename, current_engine, UDMF_mode, build_reject) != 0) {
-        Main::ProgStatus(_("ZDBSP Error!"));
-        return false;
-    }
-
-    return true;
-
-}
-
-}  // namespace Doom
-
 //------------------------------------------------------------------------
 
 namespace Doom {
@@ -816,6 +1117,7 @@ class game_interface_c : public ::game_interface_c {
 
 bool Doom::game_interface_c::Start(const char *preset) {
     sub_format = 0;
+    want_nodes = false;
 
     ef_solid_type = 0;
     ef_liquid_type = 0;
@@ -839,12 +1141,10 @@ bool Doom::game_interface_c::Start(const char *preset) {
     }
 
     // Need to preempt the rest of this process for now if we are using Vanilla Doom
-    if (main_win) {
-        current_engine = ob_get_param("engine");
-        if (StringCaseCmp(current_engine, "vanilla") == 0) {
-            build_reject = StringToInt(ob_get_param("bool_build_reject"));
-            return true;
-        }
+    current_engine = ob_get_param("engine");
+    if (StringCaseCmp(current_engine, "vanilla") == 0) {
+        build_reject = StringToInt(ob_get_param("bool_build_reject"));
+        return true;
     }
 
     if (!StartWAD(filename)) {
@@ -854,22 +1154,26 @@ bool Doom::game_interface_c::Start(const char *preset) {
 
     if (main_win) {
         main_win->build_box->Prog_Init(20, N_("CSG"));
-        if (StringCaseCmp(current_engine, "zdoom") == 0 || StringCaseCmp(current_engine, "edge") == 0 ||
-            StringCaseCmp(current_engine, "eternity") == 0) {
-            build_reject = StringToInt(ob_get_param("bool_build_reject_udmf"));
-            map_format = ob_get_param("map_format");
-            build_nodes = StringToInt(ob_get_param("bool_build_nodes_udmf"));
-        } else {
-            build_reject = StringToInt(ob_get_param("bool_build_reject"));
-            map_format = "binary";
-            build_nodes = true;
-        }
-        if (StringCaseCmp(map_format, "udmf") == 0) {
-            UDMF_mode = true;
-        } else {
-            UDMF_mode = false;
-        }
     }
+
+    if (StringCaseCmp(current_engine, "zdoom") == 0 || StringCaseCmp(current_engine, "edge") == 0 ||
+        StringCaseCmp(current_engine, "eternity") == 0) {
+        build_reject = StringToInt(ob_get_param("bool_build_reject_udmf"));
+        map_format = ob_get_param("map_format");
+        build_nodes = StringToInt(ob_get_param("bool_build_nodes_udmf"));
+    } else {
+        build_reject = StringToInt(ob_get_param("bool_build_reject"));
+        map_format = "binary";
+        build_nodes = true;
+    }
+    if (StringCaseCmp(map_format, "udmf") == 0) {
+        UDMF_mode = true;
+    } else {
+        UDMF_mode = false;
+    }
+
+    StartNodeBuilder();
+
     return true;
 }
 
@@ -877,13 +1181,17 @@ bool Doom::game_interface_c::Finish(bool build_ok) {
     // Skip DM_EndWAD if using Vanilla Doom
     if (StringCaseCmp(current_engine, "vanilla") != 0) {
         // TODO: handle write errors
-        EndWAD();
+        if (build_ok) {
+            build_ok = Doom::EndWAD_WithNodes();
+        } else {
+            EndWAD();
+        }
     } else {
         build_ok = slump_main(filename);
-    }
 
-    if (build_ok) {
-        build_ok = Doom::BuildNodes(filename);
+        if (build_ok) {
+            build_ok = Doom::BuildNodes(filename);
+        }
     }
 
     if (!build_ok) {
@@ -896,16 +1204,7 @@ bool Doom::game_interface_c::Finish(bool build_ok) {
     return build_ok;
 }
 
-void Doom::game_interface_c::BeginLevel() {
-    if (UDMF_mode) {
-        udmf_vertexes = 0;
-        udmf_sectors = 0;
-        udmf_linedefs = 0;
-        udmf_things = 0;
-        udmf_sidedefs = 0;
-    }
-    Doom::BeginLevel();
-}
+void Doom::game_interface_c::BeginLevel() { Doom::BeginLevel(); }
 
 void Doom::game_interface_c::Property(std::string key, std::string value) {
     if (StringCaseCmp(key, "level_name") == 0) {
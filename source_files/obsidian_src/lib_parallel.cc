@@ -0,0 +1,103 @@
+//------------------------------------------------------------------------
+//  Parallel processing helpers
+//------------------------------------------------------------------------
+
+#include "lib_parallel.h"
+
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "headers.h"
+
+int num_worker_threads = 0;
+
+// how many PAR_ForEach work loops this thread is inside of
+static thread_local int worker_depth = 0;
+
+int PAR_NumWorkers() {
+    if (num_worker_threads > 0) {
+        return num_worker_threads;
+    }
+
+    int cores = (int)std::thread::hardware_concurrency();
+
+    return MAX(1, cores);
+}
+
+void PAR_ForEach(int count, const std::function<void(int, int)> &func) {
+    int workers = MIN(PAR_NumWorkers(), count);
+
+    // not worth spawning any threads?
+    if (workers <= 1) {
+        for (int i = 0; i < count; i++) {
+            func(i, 0);
+        }
+        return;
+    }
+
+    std::atomic<int> next_index(0);
+
+    std::exception_ptr error;
+    std::mutex error_lock;
+
+    auto work_loop = [&](int worker) {
+        worker_depth++;
+
+        try {
+            for (;;) {
+                int i = next_index.fetch_add(1);
+
+                if (i >= count) {
+                    break;
+                }
+
+                func(i, worker);
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_lock);
+
+            if (!error) {
+                error = std::current_exception();
+            }
+
+            // stop the other workers taking more indices
+            next_index.store(count);
+        }
+
+        worker_depth--;
+    };
+
+    std::vector<std::thread> threads;
+
+    for (int w = 1; w < workers; w++) {
+        threads.emplace_back(work_loop, w);
+    }
+
+    work_loop(0);
+
+    for (std::thread &T : threads) {
+        T.join();
+    }
+
+    if (!error) {
+        return;
+    }
+
+    try {
+        std::rethrow_exception(error);
+    } catch (const assert_fail_c &err) {
+        // back on a thread which can show the error?
+        if (!PAR_InWorker()) {
+            AssertFail("%s", err.GetMessage());
+        }
+        throw;
+    }
+}
+
+bool PAR_InWorker() { return worker_depth > 0; }
+
+//--- editor settings ---
+// vi:ts=4:sw=4:noexpandtab
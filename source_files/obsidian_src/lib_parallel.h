@@ -0,0 +1,35 @@
+//------------------------------------------------------------------------
+//  Parallel processing helpers
+//------------------------------------------------------------------------
+
+#ifndef __LIB_PARALLEL_H__
+#define __LIB_PARALLEL_H__
+
+#include <functional>
+
+// maximum number of workers (including the calling thread).
+// zero or negative means use every available core.
+extern int num_worker_threads;
+
+// returns the actual number of workers to use, always >= 1
+int PAR_NumWorkers();
+
+// calls func(index, worker) for every index in [0, count), spread
+// over the available workers.  The calling thread is always worker
+// #0 and is the only one which may touch the GUI.  Indices are
+// handed out in increasing order but may finish in any order.
+// Returns once every index has been processed.
+//
+// When func throws, no more indices are handed out and the first
+// exception is rethrown on the calling thread once every worker has
+// stopped.  A failed assertion is reported there with AssertFail().
+void PAR_ForEach(int count, const std::function<void(int, int)> &func);
+
+// true while the current thread is running work for PAR_ForEach.
+// errors there must be thrown rather than reported directly.
+bool PAR_InWorker();
+
+#endif /* __LIB_PARALLEL_H__ */
+
+//--- editor settings ---
+// vi:ts=4:sw=4:noexpandtab
@@ -22,8 +22,11 @@
 #include <algorithm>
 #include <cctype>
 #include <charconv>
+#include <fstream>
 #include <functional>
+#include <random>
 
+#include "fmt/format.h"
 #include "headers.h"
 
 #ifdef UNIX
@@ -211,6 +214,16 @@ u32_t StringHash(std::string str) {
 
 }
 
+std::uint64_t FNV1aHash(std::string_view data) {
+    std::uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (unsigned char ch : data) {
+        hash = (hash ^ ch) * 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
 double PerpDist(double x, double y, double x1, double y1, double x2,
                 double y2) {
     x -= x1;
@@ -356,6 +369,45 @@ bool VectorSameDir(const double dx1, const double dy1, const double dx2,
 
 //------------------------------------------------------------------------
 
+bool FileSaveAtomic(const std::filesystem::path &filename,
+                    std::string_view data) {
+    std::error_code err;
+
+    std::filesystem::create_directories(filename.parent_path(), err);
+
+    // the random suffix keeps processes writing the same file (e.g. a
+    // batch farm) out of each other's way.
+    std::filesystem::path temp_file = filename;
+    temp_file += fmt::format(".{:08x}", std::random_device{}());
+
+    {
+        std::ofstream fp{temp_file, std::ios::binary};
+
+        if (!fp.is_open()) {
+            return false;
+        }
+
+        fp.write(data.data(), data.size());
+
+        if (!fp) {
+            fp.close();
+            std::filesystem::remove(temp_file, err);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temp_file, filename, err);
+
+    if (err) {
+        std::filesystem::remove(temp_file, err);
+        return false;
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------
+
 u32_t TimeGetMillies() {
     // Note: you *MUST* handle overflow (it *WILL* happen)
 
@@ -21,6 +21,8 @@
 #ifndef __LIB_UTIL_H__
 #define __LIB_UTIL_H__
 
+#include <cstdint>
+#include <filesystem>
 #include <string>
 #include <string_view>
 #include "sys_type.h"
@@ -45,6 +47,13 @@ double StringToDouble(std::string value);
 
 char *mem_gets(char *buf, int size, const char **str_ptr);
 
+/* file utilities */
+
+// writes to a temporary file which is then renamed over the target, so
+// other processes never see a partly written file.
+bool FileSaveAtomic(const std::filesystem::path &filename,
+                    std::string_view data);
+
 /* time utilities */
 
 u32_t TimeGetMillies();
@@ -54,6 +63,7 @@ void TimeDelay(u32_t millies);
 
 u32_t IntHash(u32_t key);
 u32_t StringHash(std::string str);
+std::uint64_t FNV1aHash(std::string_view data);  // 64-bit FNV-1a
 
 #define ALIGN_LEN(x) (((x) + 3) & ~3)
 
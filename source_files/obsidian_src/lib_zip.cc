@@ -25,18 +25,22 @@
 #include <zlib.h>
 
 #include <list>
+#include <vector>
 
 #include "fmt/core.h"
+#include "lib_parallel.h"
 #include "lib_util.h"
 #include "main.h"
 
-#define LOCAL_CRC_OFFSET (7 * 2)
 #define LOCAL_NAME_OFFSET (15 * 2)
 
 #define ZIPF_MAX_PATH 200
 
 #define ZIPF_BUFFER 4096
 
+// finished entries are held in memory until this much has built up
+#define ZIPF_FLUSH_SIZE (64 << 20)
+
 static FILE *r_zip_fp;
 static std::ofstream w_zip_fp;
 
@@ -49,13 +53,6 @@ typedef struct {
     int data_offset;  // where the data actually begins
 } zip_central_entry_t;
 
-typedef struct {
-    raw_zip_local_header_t hdr;
-
-    // TODO: use a string pointer instead
-    char name[ZIPF_MAX_PATH];
-} zip_local_entry_t;
-
 class zip_read_state_c {
    public:
     int entry;
@@ -607,12 +604,26 @@ bool ZIPF_ReadData(int entry, int offset, int length, void *buffer) {
 //  ZIP WRITING
 //------------------------------------------------------------------------
 
+int zip_compression = 6;
+
 static std::list<zip_central_entry_t> w_directory;
 
-static zip_local_entry_t w_local;
+// an entry which has been written by the caller, but not to the file.
+// the data is compressed (in parallel with the other pending entries)
+// just before it is written, so the headers can be written complete
+// and never need fixing up afterwards.
+struct zip_pending_entry_t {
+    zip_central_entry_t central;
+
+    std::string data;
+};
+
+static std::vector<zip_pending_entry_t> w_pending;
+
+static size_t w_pending_size;
 
-static int w_local_start;
-static int w_local_length;
+// where the next local header will go
+static int w_offset;
 
 // common date and time (not swapped)
 static int zipf_date;
@@ -628,6 +639,9 @@ bool ZIPF_OpenWrite(const std::filesystem::path &filename) {
 
     LogPrintf("Created ZIP file: {}\n", filename);
 
+    w_offset = 0;
+    w_pending_size = 0;
+
     // grab the current date and time
     time_t cur_time = time(NULL);
 
@@ -648,14 +662,122 @@ bool ZIPF_OpenWrite(const std::filesystem::path &filename) {
     return true;
 }
 
+static void compress_pending_entry(zip_pending_entry_t *P) {
+    raw_zip_central_header_t *H = &P->central.hdr;
+
+    int full_size = (int)P->data.size();
+
+    u32_t crc = crc32(0, NULL, 0);
+    crc = crc32(crc, (const Bytef *)P->data.data(), (uInt)full_size);
+
+    H->crc = LE_U32(crc);
+    H->full_size = LE_U32(full_size);
+    H->compress_size = LE_U32(full_size);
+
+    H->req_version = LE_U16(ZIPF_REQ_VERSION);
+    H->comp_method = LE_U16(ZIPF_COMP_STORE);
+
+    if (zip_compression == 0 || full_size == 0) {
+        return;
+    }
+
+    z_stream Z;
+
+    // use Zlib's default allocator
+    Z.zalloc = Z_NULL;
+    Z.zfree = Z_NULL;
+    Z.opaque = Z_NULL;
+
+    // window bits + no header
+    if (deflateInit2(&Z, zip_compression, Z_DEFLATED, -15, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+        return;
+    }
+
+    std::string packed(deflateBound(&Z, full_size), 0);
+
+    Z.next_in = (Bytef *)P->data.data();
+    Z.avail_in = full_size;
+    Z.next_out = (Bytef *)packed.data();
+    Z.avail_out = (uInt)packed.size();
+
+    int res = deflate(&Z, Z_FINISH);
+
+    int packed_size = (int)Z.total_out;
+
+    deflateEnd(&Z);
+
+    // keep it stored when deflate did not help
+    if (res != Z_STREAM_END || packed_size >= full_size) {
+        return;
+    }
+
+    packed.resize(packed_size);
+    P->data.swap(packed);
+
+    H->compress_size = LE_U32(packed_size);
+
+    H->req_version = LE_U16(ZIPF_REQ_VERSION_DEFLATE);
+    H->comp_method = LE_U16(ZIPF_COMP_DEFLATE);
+}
+
+// compresses the pending entries and writes them to the file, in the
+// order they were created.
+static void flush_pending_entries() {
+    if (w_pending.empty()) {
+        return;
+    }
+
+    PAR_ForEach((int)w_pending.size(), [](int index, int worker) {
+        compress_pending_entry(&w_pending[index]);
+    });
+
+    for (zip_pending_entry_t &P : w_pending) {
+        raw_zip_central_header_t *H = &P.central.hdr;
+
+        raw_zip_local_header_t local;
+
+        memcpy(local.magic, ZIPF_LOCAL_MAGIC, 4);
+
+        local.req_version = H->req_version;
+
+        local.flags = H->flags;
+        local.comp_method = H->comp_method;
+        local.file_time = H->file_time;
+        local.file_date = H->file_date;
+
+        local.crc = H->crc;
+        local.compress_size = H->compress_size;
+        local.full_size = H->full_size;
+
+        local.name_length = H->name_length;
+        local.extra_length = 0;
+
+        int name_length = strlen(P.central.name);
+
+        w_zip_fp.write(reinterpret_cast<const char *>(&local), sizeof(local));
+        w_zip_fp.write(P.central.name, name_length);
+        w_zip_fp.write(P.data.data(), P.data.size());
+
+        H->local_offset = LE_U32(w_offset);
+
+        w_offset += (int)sizeof(local) + name_length + (int)P.data.size();
+
+        w_directory.push_back(P.central);
+    }
+
+    w_pending.clear();
+    w_pending_size = 0;
+}
+
 void ZIPF_CloseWrite(void) {
-    w_zip_fp << std::flush;
+    flush_pending_entries();
 
     // write the directory
 
     LogPrintf("Writing ZIP directory\n");
 
-    int dir_offset = w_zip_fp.tellp();
+    int dir_offset = w_offset;
     int dir_size = 0;
 
     int total_entries = 0;
@@ -707,37 +829,29 @@ void ZIPF_NewLump(const char *name) {
                          ZIPF_MAX_PATH);
     }
 
-    // remember position
-    w_local_start = w_zip_fp.tellp();
-    w_local_length = 0;
+    w_pending.emplace_back();
 
-    // setup the zip_local_entry_t fields
-    memcpy(w_local.hdr.magic, ZIPF_LOCAL_MAGIC, 4);
+    zip_central_entry_t *central = &w_pending.back().central;
 
-    w_local.hdr.req_version = LE_U16(ZIPF_REQ_VERSION);
-    w_local.hdr.flags = 0;
+    // setup the fields which don't depend on the data.
+    // the rest are filled in by compress_pending_entry().
+    memcpy(central->hdr.magic, ZIPF_CENTRAL_MAGIC, 4);
 
-    // no compression... yet...
-    w_local.hdr.comp_method = LE_U16(ZIPF_COMP_STORE);
+    central->hdr.made_version = LE_U16(ZIPF_MADE_VERSION);
 
-    w_local.hdr.file_date = LE_U16(zipf_date);
-    w_local.hdr.file_time = LE_U16(zipf_time);
+    central->hdr.flags = 0;
+    central->hdr.file_time = LE_U16(zipf_time);
+    central->hdr.file_date = LE_U16(zipf_date);
 
-    /* CRC and sizes are fixed up in ZIPF_FinishLump */
-    w_local.hdr.crc = crc32(0, NULL, 0);
-    w_local.hdr.compress_size = 0;
-    w_local.hdr.full_size = 0;
+    central->hdr.name_length = LE_U16(strlen(name));
+    central->hdr.extra_length = 0;
+    central->hdr.comment_length = 0;
 
-    int name_length = strlen(name);
+    central->hdr.start_disk = 0;
+    central->hdr.internal_attrib = 0;
+    central->hdr.external_attrib = LE_U32(ZIPF_ATTRIB_NORMAL);
 
-    w_local.hdr.name_length = LE_U16(name_length);
-    w_local.hdr.extra_length = 0;
-
-    strcpy(w_local.name, name);
-
-    w_zip_fp.write(reinterpret_cast<const char *>(&w_local.hdr),
-                   sizeof(w_local.hdr));
-    w_zip_fp.write(w_local.name, name_length);
+    strcpy(central->name, name);
 }
 
 bool ZIPF_AppendData(const void *data, int length) {
@@ -746,68 +860,20 @@ bool ZIPF_AppendData(const void *data, int length) {
     }
 
     SYS_ASSERT(length > 0);
+    SYS_ASSERT(!w_pending.empty());
 
-    if (!w_zip_fp.write(static_cast<const char *>(data), length)) {
-        return false;
-    }
-
-    // compute the CRC -- use function from zlib
-    w_local.hdr.crc = crc32(w_local.hdr.crc, (const Bytef *)data, (uInt)length);
+    w_pending.back().data.append(static_cast<const char *>(data), length);
 
-    w_local_length += length;
+    w_pending_size += length;
 
     return true;
 }
 
 void ZIPF_FinishLump(void) {
-    w_zip_fp << std::flush;
-
-    w_local.hdr.full_size = LE_U32(w_local_length);
-    w_local.hdr.compress_size = LE_U32(w_local_length);
-
-    // seek back and fix up the CRC and size fields
-    w_zip_fp.seekp(w_local_start + LOCAL_CRC_OFFSET, std::ios::beg);
-
-    w_zip_fp.write(reinterpret_cast<const char *>(w_local.hdr.crc), 4);
-    w_zip_fp.write(reinterpret_cast<const char *>(w_local.hdr.compress_size),
-                   4);
-    w_zip_fp.write(reinterpret_cast<const char *>(w_local.hdr.full_size), 4);
-
-    w_zip_fp << std::flush;
-
-    // seek back to end of file
-    w_zip_fp.seekp(0, std::ios::end);
-
-    // create the central entry from the local entry
-    zip_central_entry_t central;
-
-    memcpy(central.hdr.magic, ZIPF_CENTRAL_MAGIC, 4);
-
-    central.hdr.made_version = LE_U16(ZIPF_MADE_VERSION);
-    central.hdr.req_version = w_local.hdr.req_version;
-
-    central.hdr.flags = w_local.hdr.flags;
-    central.hdr.comp_method = w_local.hdr.comp_method;
-    central.hdr.file_time = w_local.hdr.file_time;
-    central.hdr.file_date = w_local.hdr.file_date;
-
-    central.hdr.crc = w_local.hdr.crc;
-    central.hdr.compress_size = w_local.hdr.compress_size;
-    central.hdr.full_size = w_local.hdr.full_size;
-
-    central.hdr.name_length = w_local.hdr.name_length;
-    central.hdr.extra_length = 0;
-    central.hdr.comment_length = 0;
-
-    central.hdr.start_disk = 0;
-    central.hdr.internal_attrib = 0;
-    central.hdr.external_attrib = LE_U32(ZIPF_ATTRIB_NORMAL);
-
-    central.hdr.local_offset = LE_U32(w_local_start);
-
-    strcpy(central.name, w_local.name);
-
-    w_directory.push_back(central);
+    // the entry stays pending until enough have built up
+    if (w_pending_size >= ZIPF_FLUSH_SIZE) {
+        flush_pending_entries();
+    }
 }
 
 //--- editor settings ---
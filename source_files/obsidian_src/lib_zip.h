@@ -41,6 +41,9 @@ void ZIPF_ListEntries();
 
 /* ZIP writing */
 
+// deflate level for new entries, 1-9, or zero to store them as-is.
+extern int zip_compression;
+
 bool ZIPF_OpenWrite(const std::filesystem::path &filename);
 void ZIPF_CloseWrite();
 
@@ -147,6 +150,7 @@ constexpr int ZIPF_COMP_DEFLATE = 8;
 
 // version numbers:
 constexpr unsigned int ZIPF_REQ_VERSION = 0x00A;
+constexpr unsigned int ZIPF_REQ_VERSION_DEFLATE = 0x014;
 constexpr unsigned int ZIPF_MADE_VERSION = 0x314;
 
 // external attributes:
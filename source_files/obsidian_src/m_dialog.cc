@@ -201,7 +201,7 @@ void DLG_ShowError(const char *msg, ...) {
 
     buffer[MSG_BUF_LEN - 2] = 0;
 
-    LogPrintf("\n{}\n\n", buffer);
+    LogMessage<LOG_LEVEL_ERROR>("\n{}\n\n", buffer);
 
     const char *link_title = NULL;
     const char *link_url = NULL;
@@ -21,6 +21,8 @@
 #include "m_lua.h"
 
 #include <algorithm>
+#include <cstdint>
+#include <fstream>
 #ifdef WIN32
 #include <iso646.h>
 #endif
@@ -799,6 +801,40 @@ int gui_set_module_button_option(lua_State *L) {
     return 0;
 }
 
+// in batch mode there are no widgets, so the value stored in the
+// option's definition (the default or from a config file) is used.
+static int batch_module_value(lua_State *L, const std::string &module,
+                              const std::string &option) {
+    lua_getglobal(L, "ob_find_mod_option");
+    lua_getglobal(L, "OB_MODULES");
+    lua_getfield(L, -1, module.c_str());
+    lua_remove(L, -2);
+
+    if (lua_isnil(L, -1)) {
+        lua_pop(L, 2);
+        return 0;
+    }
+
+    lua_pushstring(L, option.c_str());
+    lua_call(L, 2, 1);
+
+    if (!lua_istable(L, -1)) {
+        lua_pop(L, 1);
+        return 0;
+    }
+
+    lua_getfield(L, -1, "value");
+    lua_remove(L, -2);
+
+    // sliders and buttons give numbers, except for the special choices
+    if (lua_isnumber(L, -1)) {
+        lua_pushnumber(L, lua_tonumber(L, -1));
+        lua_remove(L, -2);
+    }
+
+    return 1;
+}
+
 // LUA: get_module_slider_value(module, option)
 int gui_get_module_slider_value(lua_State *L) {
     std::string module = luaL_optstring(L, 1, "");
@@ -810,7 +846,7 @@ int gui_get_module_slider_value(lua_State *L) {
     // value);
 
     if (!main_win) {
-        return 0;
+        return batch_module_value(L, module, option);
     }
 
     double value;
@@ -894,7 +930,7 @@ int gui_get_module_button_value(lua_State *L) {
     // value);
 
     if (!main_win) {
-        return 0;
+        return batch_module_value(L, module, option);
     }
 
     int value;
@@ -996,6 +1032,97 @@ int gui_random_int(lua_State *L) {
     return 1;
 }
 
+#define RNG_STREAM_META "rng_stream"
+
+static rng_stream_c *check_rng_stream(lua_State *L) {
+    return (rng_stream_c *)luaL_checkudata(L, 1, RNG_STREAM_META);
+}
+
+// LUA: stream:random() --> number
+//
+static int rng_stream_random(lua_State *L) {
+    rng_stream_c *rng = check_rng_stream(L);
+
+    lua_pushnumber(L, rng->Double());
+    return 1;
+}
+
+// LUA: stream:random_int() --> integer
+//
+static int rng_stream_random_int(lua_State *L) {
+    rng_stream_c *rng = check_rng_stream(L);
+
+    lua_pushinteger(L, (lua_Integer)(rng->UInt() >> 1));
+    return 1;
+}
+
+// LUA: stream:irange(low, high) --> integer
+//
+static int rng_stream_irange(lua_State *L) {
+    rng_stream_c *rng = check_rng_stream(L);
+
+    int low = luaL_checkinteger(L, 2);
+    int high = luaL_checkinteger(L, 3);
+
+    if (high < low) {
+        return luaL_error(L, "rng_stream:irange: bad range %d..%d", low, high);
+    }
+
+    lua_pushinteger(L, rng->Between(low, high));
+    return 1;
+}
+
+static void push_rng_stream(lua_State *L, const rng_stream_c &rng);
+
+// LUA: stream:split(name) --> stream
+//
+static int rng_stream_split(lua_State *L) {
+    rng_stream_c *rng = check_rng_stream(L);
+
+    if (lua_isinteger(L, 2)) {
+        push_rng_stream(L, rng->Split((std::uint64_t)lua_tointeger(L, 2)));
+    } else {
+        push_rng_stream(L, rng->Split(luaL_checkstring(L, 2)));
+    }
+    return 1;
+}
+
+static const luaL_Reg rng_stream_methods[] = {
+    {"random", rng_stream_random},
+    {"random_int", rng_stream_random_int},
+    {"irange", rng_stream_irange},
+    {"split", rng_stream_split},
+
+    {NULL, NULL}  // the end
+};
+
+static void push_rng_stream(lua_State *L, const rng_stream_c &rng) {
+    rng_stream_c *dest =
+        (rng_stream_c *)lua_newuserdatauv(L, sizeof(rng_stream_c), 0);
+
+    *dest = rng;
+
+    if (luaL_newmetatable(L, RNG_STREAM_META)) {
+        luaL_newlib(L, rng_stream_methods);
+        lua_setfield(L, -2, "__index");
+    }
+
+    lua_setmetatable(L, -2);
+}
+
+// LUA: rng_stream(name) --> stream
+//
+// The stream only depends on the name and the last rand_seed() value,
+// e.g. rng_stream("caves"):split(LEVEL.id) gives every level its own
+// numbers, whichever order the levels are built in.
+//
+int gui_rng_stream(lua_State *L) {
+    const char *name = luaL_checkstring(L, 1);
+
+    push_rng_stream(L, twister_Stream(name));
+    return 1;
+}
+
 // LUA: bit_and(A, B) --> number
 //
 int gui_bit_and(lua_State *L) {
@@ -1135,8 +1262,10 @@ extern int CSG_end_level(lua_State *L);
 extern int CSG_property(lua_State *L);
 extern int CSG_tex_property(lua_State *L);
 extern int CSG_add_brush(lua_State *L);
+extern int CSG_add_brushes(lua_State *L);
 extern int CSG_add_entity(lua_State *L);
 extern int CSG_trace_ray(lua_State *L);
+extern int CSG_trace_rays(lua_State *L);
 
 extern int WF_wolf_block(lua_State *L);
 extern int WF_wolf_read(lua_State *L);
@@ -1183,6 +1312,7 @@ extern int wadfab_get_line_hexen(lua_State *L);
 extern int wadfab_get_3d_floor(lua_State *L);
 extern int wadfab_get_thing(lua_State *L);
 extern int wadfab_get_thing_hexen(lua_State *L);
+extern int wadfab_export(lua_State *L);
 
 extern int Q1_add_mapmodel(lua_State *L);
 extern int Q1_add_tex_wad(lua_State *L);
@@ -1223,6 +1353,7 @@ static const luaL_Reg gui_script_funcs[] = {
     {"rand_seed", gui_rand_seed},
     {"random", gui_random},
     {"random_int", gui_random_int},
+    {"rng_stream", gui_rng_stream},
 
     // file & directory functions
     {"import", gui_import},
@@ -1237,8 +1368,10 @@ static const luaL_Reg gui_script_funcs[] = {
     {"property", CSG_property},
     {"tex_property", CSG_tex_property},
     {"add_brush", CSG_add_brush},
+    {"add_brushes", CSG_add_brushes},
     {"add_entity", CSG_add_entity},
     {"trace_ray", CSG_trace_ray},
+    {"trace_rays", CSG_trace_rays},
 
     // Mini-Map functions
     {"minimap_begin", gui_minimap_begin},
@@ -1291,6 +1424,7 @@ static const luaL_Reg gui_script_funcs[] = {
     {"wadfab_get_3d_floor", wadfab_get_3d_floor},
     {"wadfab_get_thing", wadfab_get_thing},
     {"wadfab_get_thing_hexen", wadfab_get_thing_hexen},
+    {"wadfab_export", wadfab_export},
 
     // Quake functions
     {"q1_add_mapmodel", Q1_add_mapmodel},
@@ -1368,12 +1502,17 @@ static bool Script_CallFunc(std::string func_name, int nresult = 0,
         }
 
         // this will appear in the log file too
-        main_win->label(
-            fmt::format("[ ERROR ] {} {}", _(OBSIDIAN_TITLE), OBSIDIAN_VERSION)
-                .c_str());
+        if (main_win) {
+            main_win->label(fmt::format("[ ERROR ] {} {}", _(OBSIDIAN_TITLE),
+                                        OBSIDIAN_VERSION)
+                                .c_str());
+        }
         DLG_ShowError(_("Script Error: %s"), err_msg);
-        main_win->label(
-            fmt::format("{} {}", _(OBSIDIAN_TITLE), OBSIDIAN_VERSION).c_str());
+        if (main_win) {
+            main_win->label(
+                fmt::format("{} {}", _(OBSIDIAN_TITLE), OBSIDIAN_VERSION)
+                    .c_str());
+        }
 
         lua_pop(LUA_ST, 2);  // ob_traceback, message
         return false;
@@ -1441,74 +1580,172 @@ bool Script_RunString(const char *str, ...)
 }
 */
 
-typedef struct load_info_t {
-    PHYSFS_File *fp;
-    std::string error_msg;
-    char buffer[2048];
+//------------------------------------------------------------------------
+// SCRIPT CACHE
+//------------------------------------------------------------------------
 
-} load_info_t;
+// Compiled scripts are kept in the "cache" folder of the home dir, one
+// file per script path.  Each file begins with a header holding the
+// size and hash of the source it was compiled from, so edited scripts
+// (or ones replaced by an addon) are simply compiled again.
 
-static const char *my_reader(lua_State *L, void *ud, size_t *size) {
-    (void)L;
+static constexpr char SCRIPT_CACHE_MAGIC[8] = "OBLUAC1";
 
-    load_info_t *info = (load_info_t *)ud;
+struct script_cache_header_t {
+    char magic[8];
+    std::uint64_t source_size;
+    std::uint64_t source_hash;
+};
 
-    if (PHYSFS_eof(info->fp)) {
-        return NULL;
+static int script_cache_hits;
+static int script_cache_misses;
+
+static std::filesystem::path ScriptCacheFile(
+    const std::filesystem::path &filename) {
+    const std::string name = filename.generic_string();
+
+    return home_dir / "cache" /
+           fmt::format("{:016x}.luac", FNV1aHash(name));
+}
+
+static bool ScriptCache_Load(lua_State *L, const std::filesystem::path &filename,
+                             const std::string &source) {
+    std::ifstream fp{ScriptCacheFile(filename), std::ios::binary};
+
+    if (!fp.is_open()) {
+        return false;
     }
 
-    PHYSFS_sint64 len =
-        PHYSFS_readBytes(info->fp, info->buffer, sizeof(info->buffer));
+    script_cache_header_t header;
 
-    // negative result indicates a "complete failure"
-    if (len < 0) {
-        info->error_msg = PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode());
-        len = 0;
+    if (!fp.read((char *)&header, sizeof(header)) ||
+        memcmp(header.magic, SCRIPT_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.source_size != source.size() ||
+        header.source_hash != FNV1aHash(source)) {
+        return false;
     }
 
-    *size = (size_t)len;
+    std::string chunk{std::istreambuf_iterator<char>(fp),
+                      std::istreambuf_iterator<char>()};
 
-    if (!size) {
-        return NULL;
+    const std::string chunk_name = "@" + filename.generic_string();
+
+    // a chunk from another Lua version (etc) is rejected here
+    if (luaL_loadbufferx(L, chunk.data(), chunk.size(), chunk_name.c_str(),
+                         "b") != 0) {
+        lua_pop(L, 1);  // error message
+        return false;
     }
 
-    return info->buffer;  // OK
+    return true;
 }
 
-static int my_loadfile(lua_State *L, const std::filesystem::path &filename) {
-    /* index of filename on the stack */
-    int fnameindex = lua_gettop(L) + 1;
+static int ScriptCache_Writer(lua_State *L, const void *p, size_t sz,
+                              void *ud) {
+    (void)L;
+
+    ((std::string *)ud)->append((const char *)p, sz);
+    return 0;
+}
 
-    lua_pushfstring(L, "@%s", filename.generic_string().c_str());
+static void ScriptCache_Save(lua_State *L, const std::filesystem::path &filename,
+                             const std::string &source) {
+    script_cache_header_t header;
 
-    load_info_t info;
+    memcpy(header.magic, SCRIPT_CACHE_MAGIC, sizeof(header.magic));
+    header.source_size = source.size();
+    header.source_hash = FNV1aHash(source);
 
-    info.fp = PHYSFS_openRead(filename.generic_string().c_str());
-    info.error_msg.clear();
+    std::string data((const char *)&header, sizeof(header));
 
-    if (!info.fp) {
-        lua_pushfstring(L, "file open error: %s",
-                        PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
-        lua_remove(L, fnameindex);
+    // keep the debug info, error messages need the line numbers
+    if (lua_dump(L, ScriptCache_Writer, &data, 0) != 0) {
+        return;
+    }
 
-        return LUA_ERRFILE;
+    FileSaveAtomic(ScriptCacheFile(filename), data);
+}
+
+//------------------------------------------------------------------------
+
+static bool ReadScriptFile(const std::filesystem::path &filename,
+                           std::string &buffer, std::string &error_msg) {
+    PHYSFS_File *fp = PHYSFS_openRead(filename.generic_string().c_str());
+
+    if (!fp) {
+        error_msg = fmt::format("file open error: {}",
+                                PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+        return false;
+    }
+
+    // read the whole file at once (the length may be unknown, e.g. for
+    // compressed files, then read it in large pieces).
+    PHYSFS_sint64 length = PHYSFS_fileLength(fp);
+
+    buffer.clear();
+
+    if (length > 0) {
+        buffer.resize(length);
+
+        PHYSFS_sint64 got = PHYSFS_readBytes(fp, buffer.data(), length);
+
+        buffer.resize(MAX(got, 0));
+
+        if (got < 0) {
+            error_msg = PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode());
+        }
+    } else {
+        char piece[65536];
+
+        while (!PHYSFS_eof(fp)) {
+            PHYSFS_sint64 got = PHYSFS_readBytes(fp, piece, sizeof(piece));
+
+            // negative result indicates a "complete failure"
+            if (got < 0) {
+                error_msg = PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode());
+                break;
+            }
+            if (got == 0) {
+                break;
+            }
+
+            buffer.append(piece, got);
+        }
+    }
+
+    PHYSFS_close(fp);
+
+    if (!error_msg.empty()) {
+        error_msg = fmt::format("file read error: {}", error_msg);
+        return false;
     }
 
-    int status = lua_load(L, my_reader, &info, lua_tostring(L, -1), "bt");
+    return true;
+}
 
-    /* close file (even in case of errors) */
-    PHYSFS_close(info.fp);
+static int my_loadfile(lua_State *L, const std::filesystem::path &filename) {
+    std::string source;
+    std::string error_msg;
 
-    if (!info.error_msg.empty()) {
-        /* ignore results from 'lua_load' */
-        lua_settop(L, fnameindex);
-        status = LUA_ERRFILE;
+    if (!ReadScriptFile(filename, source, error_msg)) {
+        lua_pushstring(L, error_msg.c_str());
+        return LUA_ERRFILE;
+    }
 
-        lua_pushstring(
-            L, fmt::format("file read error: {}", info.error_msg).c_str());
+    if (ScriptCache_Load(L, filename, source)) {
+        script_cache_hits++;
+        return LUA_OK;
     }
 
-    lua_remove(L, fnameindex);
+    const std::string chunk_name = "@" + filename.generic_string();
+
+    int status = luaL_loadbufferx(L, source.data(), source.size(),
+                                  chunk_name.c_str(), "bt");
+
+    if (status == LUA_OK) {
+        script_cache_misses++;
+        ScriptCache_Save(L, filename, source);
+    }
 
     return status;
 }
@@ -1561,6 +1798,9 @@ void Script_Open() {
 
     import_dir = "scripts";
 
+    script_cache_hits = 0;
+    script_cache_misses = 0;
+
     Script_Load("oblige.lua");
 
     has_loaded = true;
@@ -1573,6 +1813,9 @@ void Script_Open() {
         Main::FatalError("The ob_init script failed.\n");
     }
 
+    LogPrintf("Script cache: {} loaded, {} compiled\n\n", script_cache_hits,
+              script_cache_misses);
+
     has_added_buttons = true;
 }
 
@@ -1694,12 +1937,17 @@ void ob_invoke_hook(std::string hookname) {
 
 bool ob_build_cool_shit() {
     if (!Script_CallFunc("ob_build_cool_shit", 1)) {
-        main_win->label(
-            fmt::format("[ ERROR ] {} {}", _(OBSIDIAN_TITLE), OBSIDIAN_VERSION)
-                .c_str());
+        if (main_win) {
+            main_win->label(fmt::format("[ ERROR ] {} {}", _(OBSIDIAN_TITLE),
+                                        OBSIDIAN_VERSION)
+                                .c_str());
+        }
         Main::ProgStatus(_("Script Error"));
-        main_win->label(
-            fmt::format("{} {}", _(OBSIDIAN_TITLE), OBSIDIAN_VERSION).c_str());
+        if (main_win) {
+            main_win->label(
+                fmt::format("{} {}", _(OBSIDIAN_TITLE), OBSIDIAN_VERSION)
+                    .c_str());
+        }
         return false;
     }
 
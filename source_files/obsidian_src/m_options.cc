@@ -24,6 +24,7 @@
 #include "headers.h"
 #include "lib_argv.h"
 #include "lib_util.h"
+#include "lib_zip.h"
 #include "m_addons.h"
 #include "m_cookie.h"
 #include "m_trans.h"
@@ -53,6 +54,8 @@ static void Parse_Option(std::string name, std::string value) {
         filename_prefix = StringToInt(value);
     } else if (StringCaseCmp(name, "custom_prefix") == 0) {
         custom_prefix = value;
+    } else if (StringCaseCmp(name, "zip_compression") == 0) {
+        zip_compression = std::clamp(StringToInt(value), 0, 9);
     } else {
         LogPrintf("Unknown option: '{}'\n", name);
     }
@@ -142,6 +145,7 @@ bool Options_Save(std::filesystem::path filename) {
     option_fp << "limit_break = " << (limit_break ? 1 : 0) << "\n";
     option_fp << "filename_prefix = " << filename_prefix << "\n";
     option_fp << "custom_prefix = " << custom_prefix << "\n";
+    option_fp << "zip_compression = " << zip_compression << "\n";
 
     if (!last_directory.empty()) {
         option_fp << "\n";
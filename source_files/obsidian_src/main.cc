@@ -22,13 +22,23 @@
 #include "fmt/core.h"
 #include "images.h"
 
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#ifndef WIN32
+#include <sys/wait.h>
+#endif
+
 #include "csg_main.h"
+#include "dm_prefab.h"
 #include "g_nukem.h"
 #include "hdr_fltk.h"
 #include "hdr_ui.h"
 #include "headers.h"
 #include "lib_argv.h"
 #include "lib_file.h"
+#include "lib_parallel.h"
 #include "lib_util.h"
 #include "m_addons.h"
 #include "m_cookie.h"
@@ -146,6 +156,12 @@ static void ShowInfo() {
         "  -l --load     <file>     Load settings from a file\n"
         "  -k --keep                Keep SEED from loaded settings\n"
         "\n"
+        "     --batch-many <count>  Batch mode, build many seeds\n"
+        "     --jobs     <num>      Worker processes for --batch-many\n"
+        "     --out-dir  <dir>      Output directory for --batch-many\n"
+        "\n"
+        "  -j --threads  <num>      Number of worker threads to use\n"
+        "     --bench-dummies <num> Time Doom extrafloor dummy lookups\n"
         "  -d --debug               Enable debugging\n"
         "  -v --verbose             Print log messages to stdout\n"
         "  -h --help                Show this help message\n"
@@ -832,14 +848,18 @@ bool Build_Cool_Shit() {
     bool was_ok = game_object->Start(def_filename.c_str());
 
     // coerce FLTK to redraw the main window
-    for (int r_loop = 0; r_loop < 6; r_loop++) {
-        Fl::wait(0.06);
+    if (main_win) {
+        for (int r_loop = 0; r_loop < 6; r_loop++) {
+            Fl::wait(0.06);
+        }
     }
 
     if (was_ok) {
         // run the scripts Scotty!
         was_ok = ob_build_cool_shit();
 
+        WadFab_CacheStats();
+
         was_ok = game_object->Finish(was_ok);
     }
     if (was_ok) {
@@ -882,6 +902,281 @@ bool Build_Cool_Shit() {
     return was_ok;
 }
 
+/* ----- batch farm ----------------------------- */
+
+// --batch-many splits the seeds over several worker processes, each
+// of which opens the scripts once and then builds every J-th seed.
+// The driver process only spawns the workers and collects their
+// reports into a single manifest file.
+
+// extrafloors for --bench-dummies, zero when not benchmarking
+static int bench_dummies = 0;
+
+static int farm_count = 0;
+static int farm_jobs = 0;
+static std::filesystem::path farm_out_dir;
+
+// these are only set in a worker process (via --farm-worker)
+static int farm_worker = -1;
+static int farm_start = 0;  // first index, the stride is farm_jobs
+static unsigned long long farm_base_seed = 0;
+
+struct farm_result_t {
+    unsigned long long seed = 0;
+    std::string status = "missing";
+    u32_t millis = 0;
+    std::string file;
+};
+
+static std::string Farm_QuoteArg(const std::string &arg) {
+#ifdef WIN32
+    return fmt::format("\"{}\"", arg);
+#else
+    std::string result = "'";
+
+    for (char ch : arg) {
+        if (ch == '\'') {
+            result += "'\\''";
+        } else {
+            result += ch;
+        }
+    }
+
+    return result + "'";
+#endif
+}
+
+static int Farm_ExitStatus(int status) {
+#ifdef WIN32
+    return status;
+#else
+    if (status != -1 && WIFEXITED(status)) {
+        return WEXITSTATUS(status);
+    }
+    return -1;
+#endif
+}
+
+static std::string Farm_OutputExt() {
+    const std::string format = ob_game_format();
+
+    if (StringCaseCmp(format, "nukem") == 0) {
+        return "grp";
+    } else if (StringCaseCmp(format, "quake") == 0 ||
+               StringCaseCmp(format, "quake2") == 0) {
+        return "pak";
+    } else if (StringCaseCmp(format, "quake3") == 0) {
+        return "pk3";
+    }
+
+    return "wad";
+}
+
+static std::filesystem::path Farm_ReportFile(int slot) {
+    return farm_out_dir / fmt::format("farm_{}.txt", slot);
+}
+
+static int Farm_RunWorker(int argc, char **argv, int slot, int start) {
+    std::string cmd = Farm_QuoteArg(argv[0]);
+
+    // forward our own arguments, except for the log file
+    for (int i = 1; i < argc; i++) {
+        if (StringCaseCmp(argv[i], "--log") == 0 ||
+            StringCaseCmp(argv[i], "-log") == 0) {
+            i++;
+            continue;
+        }
+
+        cmd += " " + Farm_QuoteArg(argv[i]);
+    }
+
+    // don't let every worker use every core
+    if (argv::Find('j', "threads") < 0) {
+        const int cores = PAR_NumWorkers();
+        cmd += fmt::format(" --threads {}", MAX(1, cores / farm_jobs));
+    }
+
+    const std::filesystem::path log_file =
+        farm_out_dir / fmt::format("farm_{}.log", start);
+
+    cmd += " --log " + Farm_QuoteArg(log_file.string());
+    cmd += fmt::format(" --farm-worker {} {} {} {}", slot, start, farm_jobs,
+                       farm_base_seed);
+
+#ifdef WIN32
+    // cmd.exe strips the outermost quotes of the whole command
+    cmd = "\"" + cmd + "\"";
+#endif
+
+    return Farm_ExitStatus(std::system(cmd.c_str()));
+}
+
+static void Farm_ReadReport(int slot, std::vector<farm_result_t> &results) {
+    std::ifstream fp{Farm_ReportFile(slot)};
+
+    std::string line;
+
+    while (std::getline(fp, line)) {
+        std::istringstream row{line};
+
+        int index = -1;
+        farm_result_t res;
+
+        if (!(row >> index >> res.seed >> res.status >> res.millis)) {
+            continue;
+        }
+
+        row >> res.file;
+
+        if (index >= 0 && index < farm_count) {
+            results[index] = res;
+        }
+    }
+}
+
+static void Farm_DriveSlot(int argc, char **argv, int slot,
+                           std::vector<farm_result_t> &results) {
+    int next = slot;
+
+    while (next < farm_count) {
+        std::filesystem::remove(Farm_ReportFile(slot));
+
+        const u32_t start_time = TimeGetMillies();
+
+        const int code = Farm_RunWorker(argc, argv, slot, next);
+
+        Farm_ReadReport(slot, results);
+
+        // skip everything the worker got through
+        while (next < farm_count && results[next].status != "missing") {
+            next += farm_jobs;
+        }
+
+        if (next >= farm_count) {
+            break;
+        }
+
+        // the worker died while building this seed, so mark it as failed
+        // and start a fresh worker on the seed after it.
+        farm_result_t &res = results[next];
+
+        res.seed = farm_base_seed + next;
+        res.status = fmt::format("crashed({})", code);
+        res.millis = TimeGetMillies() - start_time;
+
+        next += farm_jobs;
+    }
+}
+
+static int Farm_Driver(int argc, char **argv) {
+    // the base seed can be given on the command line, otherwise the
+    // freshly generated seed is used.  Seeds are base + index.
+    farm_base_seed = next_rand_seed;
+
+    for (const std::string &arg : argv::list) {
+        if (StringCaseCmpPartial(arg, "seed=") == 0 && arg.size() > 5) {
+            try {
+                farm_base_seed = std::stoull(arg.substr(5));
+            } catch (std::exception &) {
+                Main::FatalError("Invalid seed: {}\n", arg);
+            }
+        }
+    }
+
+    farm_jobs = MAX(1, MIN(farm_jobs, farm_count));
+
+    LogPrintf("Batch farm: {} seeds from {}, {} jobs, output in {}\n\n",
+              farm_count, farm_base_seed, farm_jobs, farm_out_dir.string());
+
+    std::vector<farm_result_t> results(farm_count);
+
+    const u32_t start_time = TimeGetMillies();
+
+    {
+        std::vector<std::thread> threads;
+
+        for (int slot = 0; slot < farm_jobs; slot++) {
+            threads.emplace_back(Farm_DriveSlot, argc, argv, slot,
+                                 std::ref(results));
+        }
+
+        for (std::thread &T : threads) {
+            T.join();
+        }
+    }
+
+    const u32_t total_time = TimeGetMillies() - start_time;
+
+    std::ofstream fp{farm_out_dir / "manifest.tsv"};
+
+    if (!fp.is_open()) {
+        Main::FatalError("Cannot create manifest in: {}\n",
+                         farm_out_dir.string());
+    }
+
+    fp << "index\tseed\tstatus\tmillis\tfile\n";
+
+    int num_ok = 0;
+
+    for (int i = 0; i < farm_count; i++) {
+        const farm_result_t &res = results[i];
+
+        if (res.status == "ok") {
+            num_ok++;
+        }
+
+        fp << fmt::format("{}\t{}\t{}\t{}\t{}\n", i, res.seed, res.status,
+                          res.millis, res.file);
+    }
+
+    fp.close();
+
+    for (int slot = 0; slot < farm_jobs; slot++) {
+        std::filesystem::remove(Farm_ReportFile(slot));
+    }
+
+    const std::string summary =
+        fmt::format("Batch farm: {} of {} seeds built in {:.2f} seconds\n",
+                    num_ok, farm_count, total_time / 1000.0);
+
+    fmt::print("{}", summary);
+    LogPrintf("{}", summary);
+
+    Main::Detail::Shutdown(false);
+
+    return (num_ok == farm_count) ? 0 : 3;
+}
+
+static void Farm_Worker() {
+    const std::string ext = Farm_OutputExt();
+
+    std::ofstream fp{Farm_ReportFile(farm_worker), std::ios::app};
+
+    if (!fp.is_open()) {
+        Main::FatalError("Cannot create farm report in: {}\n",
+                         farm_out_dir.string());
+    }
+
+    for (int i = farm_start; i < farm_count; i += farm_jobs) {
+        next_rand_seed = farm_base_seed + i;
+        batch_output_file =
+            farm_out_dir / fmt::format("{}.{}", next_rand_seed, ext);
+
+        Main_SetSeed();
+
+        const u32_t start_time = TimeGetMillies();
+
+        const bool was_ok = Build_Cool_Shit();
+
+        const u32_t millis = TimeGetMillies() - start_time;
+
+        fp << fmt::format("{}\t{}\t{}\t{}\t{}\n", i, next_rand_seed,
+                          was_ok ? "ok" : "failed", millis,
+                          batch_output_file.filename().string())
+           << std::flush;
+    }
+}
+
 /* ----- main program ----------------------------- */
 
 int main(int argc, char **argv) {
@@ -911,6 +1206,82 @@ restart:;
         batch_output_file = argv::list[batch_arg + 1];
     }
 
+    if (const int many_arg = argv::Find(0, "batch-many"); many_arg >= 0) {
+        if (many_arg + 1 >= (int)argv::list.size() ||
+            argv::IsOption(many_arg + 1)) {
+            fmt::print(stderr,
+                       "OBSIDIAN ERROR: missing count for --batch-many\n");
+            exit(9);
+        }
+
+        if (batch_mode) {
+            fmt::print(stderr,
+                       "OBSIDIAN ERROR: --batch and --batch-many conflict\n");
+            exit(9);
+        }
+
+        batch_mode = true;
+        farm_count = StringToInt(argv::list[many_arg + 1]);
+
+        if (farm_count <= 0) {
+            fmt::print(stderr, "OBSIDIAN ERROR: bad count for --batch-many\n");
+            exit(9);
+        }
+
+        if (const int jobs_arg = argv::Find(0, "jobs"); jobs_arg >= 0) {
+            if (jobs_arg + 1 >= (int)argv::list.size() ||
+                argv::IsOption(jobs_arg + 1)) {
+                fmt::print(stderr,
+                           "OBSIDIAN ERROR: missing number for --jobs\n");
+                exit(9);
+            }
+
+            farm_jobs = StringToInt(argv::list[jobs_arg + 1]);
+        }
+
+        farm_out_dir = ".";
+
+        if (const int dir_arg = argv::Find(0, "out-dir"); dir_arg >= 0) {
+            if (dir_arg + 1 >= (int)argv::list.size() ||
+                argv::IsOption(dir_arg + 1)) {
+                fmt::print(stderr,
+                           "OBSIDIAN ERROR: missing path for --out-dir\n");
+                exit(9);
+            }
+
+            farm_out_dir = argv::list[dir_arg + 1];
+
+            std::error_code err;
+            std::filesystem::create_directories(farm_out_dir, err);
+        }
+
+        // this one is passed to the worker processes by the driver
+        if (const int worker_arg = argv::Find(0, "farm-worker");
+            worker_arg >= 0) {
+            if (worker_arg + 4 >= (int)argv::list.size()) {
+                fmt::print(stderr, "OBSIDIAN ERROR: bad --farm-worker\n");
+                exit(9);
+            }
+
+            farm_worker = StringToInt(argv::list[worker_arg + 1]);
+            farm_start = StringToInt(argv::list[worker_arg + 2]);
+            farm_jobs = StringToInt(argv::list[worker_arg + 3]);
+            farm_base_seed = std::stoull(argv::list[worker_arg + 4]);
+        }
+    }
+
+    if (const int bench_arg = argv::Find(0, "bench-dummies"); bench_arg >= 0) {
+        if (bench_arg + 1 >= (int)argv::list.size() ||
+            argv::IsOption(bench_arg + 1)) {
+            fmt::print(stderr,
+                       "OBSIDIAN ERROR: missing count for --bench-dummies\n");
+            exit(9);
+        }
+
+        batch_mode = true;
+        bench_dummies = MAX(1, StringToInt(argv::list[bench_arg + 1]));
+    }
+
     Determine_WorkingPath(argv[0]);
     Determine_InstallDir(argv[0]);
 
@@ -925,6 +1296,18 @@ restart:;
         debug_messages = true;
     }
 
+    if (const int threads_arg = argv::Find('j', "threads");
+        threads_arg >= 0) {
+        if (threads_arg + 1 >= (int)argv::list.size() ||
+            argv::IsOption(threads_arg + 1)) {
+            fmt::print(stderr,
+                       "OBSIDIAN ERROR: missing number for --threads\n");
+            exit(9);
+        }
+
+        num_worker_threads = StringToInt(argv::list[threads_arg + 1]);
+    }
+
     // accept -t and --terminal for backwards compatibility
     if (argv::Find('v', "verbose") >= 0 || argv::Find('t', "terminal") >= 0) {
         LogEnableTerminal(true);
@@ -963,6 +1346,23 @@ restart:;
 
     Main_CalcNewSeed();
 
+    if (farm_count > 0 && farm_worker < 0) {
+        if (farm_jobs <= 0) {
+            farm_jobs = PAR_NumWorkers();
+        }
+
+        return Farm_Driver(argc, argv);
+    }
+
+    if (bench_dummies > 0) {
+        LogEnableTerminal(true);
+
+        const bool same = CSG_DOOM_BenchDummies(bench_dummies);
+
+        Main::Detail::Shutdown(false);
+        return same ? 0 : 3;
+    }
+
     //	TX_TestSynth(next_rand_seed); - Fractal testing stuff
 
     VFS_InitAddons(argv[0]);
@@ -998,6 +1398,13 @@ restart:;
 
         Cookie_ParseArguments();
 
+        if (farm_worker >= 0) {
+            Farm_Worker();
+
+            Main::Detail::Shutdown(false);
+            return 0;
+        }
+
         Main_SetSeed();
         if (!Build_Cool_Shit()) {
             fmt::print(stderr, "FAILED!\n");
@@ -685,11 +685,9 @@ void BSP_WriteEntities(int lump_num, const char *description) {
 
     csg_entity_c *ob_world = FindObligeWorldspawn();
 
-    csg_property_set_c::iterator PI;
-
     if (ob_world) {
-        for (PI = ob_world->props.begin(); PI != ob_world->props.end(); PI++) {
-            lump->KeyPair(PI->first.c_str(), "%s", PI->second.c_str());
+        for (const auto &P : ob_world->props) {
+            lump->KeyPair(P.Key().c_str(), "%s", P.Value().c_str());
         }
     }
 
@@ -722,8 +720,8 @@ void BSP_WriteEntities(int lump_num, const char *description) {
         lump->Printf("{\n");
 
         // write entity properties
-        for (PI = E->props.begin(); PI != E->props.end(); PI++) {
-            lump->KeyPair(PI->first.c_str(), "%s", PI->second.c_str());
+        for (const auto &P : E->props) {
+            lump->KeyPair(P.Key().c_str(), "%s", P.Value().c_str());
         }
 
         // skip origin when same as default value
@@ -25,6 +25,9 @@
 
 #include "q_light.h"
 
+#include <algorithm>
+#include <atomic>
+
 #include "csg_main.h"
 #include "csg_quake.h"
 #include "fmt/core.h"
@@ -32,6 +35,7 @@
 #include "hdr_ui.h"
 #include "headers.h"
 #include "lib_file.h"
+#include "lib_parallel.h"
 #include "lib_util.h"
 #include "main.h"
 #include "q_common.h"
@@ -492,14 +496,6 @@ void QLIT_FreeLightmaps() {
     }
 }
 
-static qLightmap_c *QLIT_NewLightmap(int w, int h) {
-    qLightmap_c *lmap = new qLightmap_c(w, h);
-
-    qk_all_lightmaps.push_back(lmap);
-
-    return lmap;
-}
-
 static void WriteFlatBlock(int level, int count) {
     byte datum = (byte)level;
 
@@ -572,26 +568,79 @@ typedef struct {
 
 } light_point_t;
 
-// Lighting variables
+// Per-face lighting state.  Each worker thread owns one of these,
+// which lets faces be lit in parallel once the trace nodes exist
+// (nothing here is shared between faces).
+
+class qLightWorker_c {
+   public:
+    quake_face_c *lt_face;
+
+    double lt_plane_normal[3];
+    double lt_plane_dist;
+
+    quake_bbox_c lt_face_bbox;
 
-static quake_face_c *lt_face;
+    int lt_W, lt_H;
+
+    int lt_current_style;
+
+    light_point_t lt_points[MAX_LM_SIZE * 2][MAX_LM_SIZE * 2];
+
+    int blocklights[MAX_LM_SIZE * 2][MAX_LM_SIZE * 2][3];
+
+    // the current packet of luxels to trace
+    int pk_count;
+    int pk_s[QVIS_PACKET_SIZE];
+    int pk_t[QVIS_PACKET_SIZE];
+    float pk_x[QVIS_PACKET_SIZE];
+    float pk_y[QVIS_PACKET_SIZE];
+    float pk_z[QVIS_PACKET_SIZE];
+    bool pk_ok[QVIS_PACKET_SIZE];
+
+    // indices of lights which may reach the current face
+    std::vector<int> lt_lights;
+
+    // statistics
+    long long lt_tested;
+    long long lt_culled;
+
+   public:
+    qLightWorker_c()
+        : lt_face(NULL),
+          pk_count(0),
+          lt_lights(),
+          lt_tested(0),
+          lt_culled(0) {}
+    ~qLightWorker_c() {}
 
-static double lt_plane_normal[3];
-static double lt_plane_dist;
+    void LightFace(quake_face_c *F);
 
-static quake_bbox_c lt_face_bbox;
+   private:
+    void Q1_CalcFaceStuff(quake_face_c *F);
+    void Q3_CalcFaceStuff(quake_face_c *F);
 
-static int lt_W, lt_H;
+    void ClearLightBuffer(int level);
 
-static int lt_current_style;
+    bool Luxel_HasSetNeighbor(int s, int t);
+    void Luxel_ComputeAverage(int s, int t, bool do_avg);
 
-#define MAX_LM_SIZE 64
+    void HandleOffFaceLuxels();
+    void FilterSuperSamples();
 
-static light_point_t lt_points[MAX_LM_SIZE * 2][MAX_LM_SIZE * 2];
+    inline void Bump(int s, int t, int value, rgb_color_t color) {
+        blocklights[s][t][0] += value * RGB_RED(color);
+        blocklights[s][t][1] += value * RGB_GREEN(color);
+        blocklights[s][t][2] += value * RGB_BLUE(color);
+    }
 
-static int blocklights[MAX_LM_SIZE * 2][MAX_LM_SIZE * 2][3];
+    bool TracePacket(quake_light_t &light);
+    void ProcessLight(qLightmap_c *lmap, quake_light_t &light, int pass);
+    void LiquidLighting(qLightmap_c *lmap);
+    void TestingStuff(qLightmap_c *lmap);
+};
 
-static void Q1_CalcFaceStuff(quake_face_c *F) {
+void qLightWorker_c::Q1_CalcFaceStuff(quake_face_c *F) {
     lt_plane_normal[0] = F->plane.nx;
     lt_plane_normal[1] = F->plane.ny;
     lt_plane_normal[2] = F->plane.nz;
@@ -616,7 +665,7 @@ static void Q1_CalcFaceStuff(quake_face_c *F) {
 
     // calculate a normal to the texture axis.  points can be moved
     // along this without changing their S/T
-    static quake_plane_c texnormal;
+    quake_plane_c texnormal;
 
     texnormal.nx = UV->s[2] * UV->t[1] - UV->s[1] * UV->t[2];
     texnormal.ny = UV->s[0] * UV->t[2] - UV->s[2] * UV->t[0];
@@ -704,7 +753,7 @@ static void Q1_CalcFaceStuff(quake_face_c *F) {
 
     /// fprintf(stderr, "FACE %p  EXTENTS %d %d\n", F, lt_W, lt_H);
 
-    F->lmap = QLIT_NewLightmap(lt_W, lt_H);
+    F->lmap = new qLightmap_c(lt_W, lt_H);
 
     /* Calc Points... */
 
@@ -792,7 +841,7 @@ static bool CheckLightPoint(light_point_t &P, quake_face_c *F, double s,
     return !(P.medium == MEDIUM_OFF_FACE || P.medium == MEDIUM_SOLID);
 }
 
-static void Q3_CalcFaceStuff(quake_face_c *F) {
+void qLightWorker_c::Q3_CalcFaceStuff(quake_face_c *F) {
     float px = F->plane.x;
     float py = F->plane.y;
     float pz = F->plane.z;
@@ -910,7 +959,7 @@ static void Q3_CalcFaceStuff(quake_face_c *F) {
     lt_W = CLAMP(1, lt_W, MAX_LM_SIZE);
     lt_H = CLAMP(1, lt_H, MAX_LM_SIZE);
 
-    F->lmap = QLIT_NewLightmap(lt_W, lt_H);
+    F->lmap = new qLightmap_c(lt_W, lt_H);
 
     // compute the UV matrix...
     // [ the offsets in s[3] and t[3] are updated later, when block is allocated
@@ -1001,7 +1050,7 @@ static void Q3_CalcFaceStuff(quake_face_c *F) {
     }
 }
 
-static void ClearLightBuffer(int level) {
+void qLightWorker_c::ClearLightBuffer(int level) {
     level <<= 8;
 
     for (int s = 0; s < lt_W; s++) {
@@ -1013,7 +1062,7 @@ static void ClearLightBuffer(int level) {
     }
 }
 
-void qLightmap_c::Store() {
+void qLightmap_c::Store(const int blocklights[][MAX_LM_SIZE * 2][3]) {
     rgb_color_t *dest = current_pos;
 
     float scale = q_light_scale / 1024.0;
@@ -1051,41 +1100,48 @@ void qLightmap_c::Store() {
     if (qk_game >= 3 && isDark()) {
         fmt::print(stderr, "DARK LIGHTMAP !\n");
         offset = 0;
-    } else if (qk_game >= 3) {
-        // this is lousy for memory usage...
-        // [ but some stuff is using samples[], like CalcAverage() ]
+    }
+}
 
-        offset = Q3_AllocLightBlock(width, height, &lx, &ly);
-        SYS_ASSERT(offset >= 0);
+void qLightmap_c::AllocBlock() {
+    // dark lightmaps use the shared block (see Store)
+    if (offset >= 0) {
+        return;
+    }
 
-        fmt::print(stderr, "LM POSITION: block #{} ({:3} {})\n", offset, lx,
-                   ly);
+    // this is lousy for memory usage...
+    // [ but some stuff is using samples[], like CalcAverage() ]
 
-        double s1 = (lx + 0.5) / (double)LIGHTMAP_WIDTH;
-        double t1 = (ly + 0.5) / (double)LIGHTMAP_HEIGHT;
+    offset = Q3_AllocLightBlock(width, height, &lx, &ly);
+    SYS_ASSERT(offset >= 0);
 
-        lm_mat->s[3] += s1;
-        lm_mat->t[3] += t1;
+    fmt::print(stderr, "LM POSITION: block #{} ({:3} {})\n", offset, lx, ly);
 
-        q3_lightmap_block_c *BL = all_q3_light_blocks[offset];
-        SYS_ASSERT(BL);
+    double s1 = (lx + 0.5) / (double)LIGHTMAP_WIDTH;
+    double t1 = (ly + 0.5) / (double)LIGHTMAP_HEIGHT;
 
-        for (int y = 0; y < height; y++) {
-            for (int x = 0; x < width; x++) {
-                const rgb_color_t col = At(x, y);
+    lm_mat->s[3] += s1;
+    lm_mat->t[3] += t1;
 
-                const int bx = lx + x;
-                const int by = ly + y;
+    q3_lightmap_block_c *BL = all_q3_light_blocks[offset];
+    SYS_ASSERT(BL);
 
-                BL->samples[bx][by][0] = RGB_RED(col);
-                BL->samples[bx][by][1] = RGB_GREEN(col);
-                BL->samples[bx][by][2] = RGB_BLUE(col);
-            }
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            // the first style, other styles may exist by now
+            const rgb_color_t col = samples[y * width + x];
+
+            const int bx = lx + x;
+            const int by = ly + y;
+
+            BL->samples[bx][by][0] = RGB_RED(col);
+            BL->samples[bx][by][1] = RGB_GREEN(col);
+            BL->samples[bx][by][2] = RGB_BLUE(col);
         }
     }
 }
 
-static bool Luxel_HasSetNeighbor(int s, int t) {
+bool qLightWorker_c::Luxel_HasSetNeighbor(int s, int t) {
     for (int side = 0; side < 4; side++) {
         int ds = (side == 0) ? -1 : (side == 1) ? +1 : 0;
         int dt = (side == 2) ? -1 : (side == 3) ? +1 : 0;
@@ -1105,7 +1161,7 @@ static bool Luxel_HasSetNeighbor(int s, int t) {
     return false;
 }
 
-static void Luxel_ComputeAverage(int s, int t, bool do_avg) {
+void qLightWorker_c::Luxel_ComputeAverage(int s, int t, bool do_avg) {
     int total = 0;
 
     int sum_r = 0;
@@ -1145,7 +1201,7 @@ static void Luxel_ComputeAverage(int s, int t, bool do_avg) {
     }
 }
 
-static void HandleOffFaceLuxels() {
+void qLightWorker_c::HandleOffFaceLuxels() {
     // set luxels in blocklights[] which are off the face or
     // underneath a solid brush to the average of nearby luxels.
     //
@@ -1185,7 +1241,7 @@ static void HandleOffFaceLuxels() {
     }
 }
 
-static void FilterSuperSamples() {
+void qLightWorker_c::FilterSuperSamples() {
     // the "best" mode visits 4 times as many points as normal,
     // then computes the average of each 2x2 block.
 
@@ -1246,14 +1302,168 @@ static void QLIT_FindLights() {
     }
 }
 
-static inline void Bump(int s, int t, int value, rgb_color_t color) {
-    blocklights[s][t][0] += value * RGB_RED(color);
-    blocklights[s][t][1] += value * RGB_GREEN(color);
-    blocklights[s][t][2] += value * RGB_BLUE(color);
+//------------------------------------------------------------------------
+
+// Spatial index over the lights.  Normal lights are stored in each
+// cell of a 2D grid which their sphere touches, sun lights are kept
+// in a separate list since they can reach any face.
+
+#define LIGHT_CELL_SIZE 256
+#define LIGHT_GRID_MAX 256
+
+static std::vector<int> qk_sun_lights;
+
+static std::vector<std::vector<int>> light_grid;
+
+static int light_grid_X, light_grid_Y;
+static int light_grid_W, light_grid_H;
+static int light_cell_size;
+
+static void QLIT_FreeLightIndex() {
+    qk_sun_lights.clear();
+    light_grid.clear();
+
+    light_grid_W = light_grid_H = 0;
+}
+
+static inline int LightCell(float v, int origin) {
+    return (int)floor((v - origin) / (double)light_cell_size);
+}
+
+static void QLIT_BuildLightIndex() {
+    QLIT_FreeLightIndex();
+
+    double min_x = +9e9, min_y = +9e9;
+    double max_x = -9e9, max_y = -9e9;
+
+    for (unsigned int i = 0; i < qk_all_lights.size(); i++) {
+        const quake_light_t &L = qk_all_lights[i];
+
+        if (L.kind == LTK_Sun) {
+            qk_sun_lights.push_back((int)i);
+            continue;
+        }
+
+        min_x = MIN(min_x, L.x - L.radius);
+        min_y = MIN(min_y, L.y - L.radius);
+        max_x = MAX(max_x, L.x + L.radius);
+        max_y = MAX(max_y, L.y + L.radius);
+    }
+
+    // no normal lights?
+    if (min_x > max_x) {
+        return;
+    }
+
+    // use bigger cells for huge maps
+    light_cell_size = LIGHT_CELL_SIZE;
+
+    while ((max_x - min_x) / light_cell_size >= LIGHT_GRID_MAX ||
+           (max_y - min_y) / light_cell_size >= LIGHT_GRID_MAX) {
+        light_cell_size *= 2;
+    }
+
+    light_grid_X = (int)floor(min_x);
+    light_grid_Y = (int)floor(min_y);
+
+    light_grid_W = LightCell(max_x, light_grid_X) + 1;
+    light_grid_H = LightCell(max_y, light_grid_Y) + 1;
+
+    light_grid.resize(light_grid_W * light_grid_H);
+
+    for (unsigned int i = 0; i < qk_all_lights.size(); i++) {
+        const quake_light_t &L = qk_all_lights[i];
+
+        if (L.kind == LTK_Sun) {
+            continue;
+        }
+
+        int cx1 = LightCell(L.x - L.radius, light_grid_X);
+        int cy1 = LightCell(L.y - L.radius, light_grid_Y);
+        int cx2 = LightCell(L.x + L.radius, light_grid_X);
+        int cy2 = LightCell(L.y + L.radius, light_grid_Y);
+
+        for (int cy = cy1; cy <= cy2; cy++) {
+            for (int cx = cx1; cx <= cx2; cx++) {
+                light_grid[cy * light_grid_W + cx].push_back((int)i);
+            }
+        }
+    }
 }
 
-static void QLIT_ProcessLight(qLightmap_c *lmap, quake_light_t &light,
-                              int pass) {
+static void QLIT_QueryLights(const quake_bbox_c &bbox, std::vector<int> &out) {
+    // finds all lights which may touch the bbox, result is sorted
+    // into the same order as qk_all_lights[].
+
+    out.clear();
+
+    if (light_grid_W > 0) {
+        int cx1 = LightCell(bbox.mins[0], light_grid_X);
+        int cy1 = LightCell(bbox.mins[1], light_grid_Y);
+        int cx2 = LightCell(bbox.maxs[0], light_grid_X);
+        int cy2 = LightCell(bbox.maxs[1], light_grid_Y);
+
+        cx1 = MAX(cx1, 0);
+        cy1 = MAX(cy1, 0);
+        cx2 = MIN(cx2, light_grid_W - 1);
+        cy2 = MIN(cy2, light_grid_H - 1);
+
+        for (int cy = cy1; cy <= cy2; cy++) {
+            for (int cx = cx1; cx <= cx2; cx++) {
+                const std::vector<int> &cell =
+                    light_grid[cy * light_grid_W + cx];
+
+                out.insert(out.end(), cell.begin(), cell.end());
+            }
+        }
+    }
+
+    out.insert(out.end(), qk_sun_lights.begin(), qk_sun_lights.end());
+
+    // a light can be in several cells
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+bool qLightWorker_c::TracePacket(quake_light_t &light) {
+    // returns true if any luxel in the packet was hit by the light
+
+    bool hit_it = false;
+
+    QVIS_TraceRays(pk_count, pk_x, pk_y, pk_z, light.x, light.y, light.z,
+                   pk_ok);
+
+    for (int i = 0; i < pk_count; i++) {
+        if (!pk_ok[i]) {
+            continue;
+        }
+
+        hit_it = true;
+
+        int s = pk_s[i];
+        int t = pk_t[i];
+
+        if (light.kind == LTK_Sun) {
+            Bump(s, t, (int)light.level, light.color);
+        } else {
+            float dist = ComputeDist(pk_x[i], pk_y[i], pk_z[i], light.x,
+                                     light.y, light.z);
+
+            if (dist < light.radius) {
+                int value = light.level * (1.0 - dist / light.radius);
+
+                Bump(s, t, value, light.color);
+            }
+        }
+    }
+
+    pk_count = 0;
+
+    return hit_it;
+}
+
+void qLightWorker_c::ProcessLight(qLightmap_c *lmap, quake_light_t &light,
+                                  int pass) {
     // first pass is normal lights, other passes are for styled lights
     if (pass == 0) {
         if (light.style) {
@@ -1305,6 +1515,11 @@ static void QLIT_ProcessLight(qLightmap_c *lmap, quake_light_t &light,
 
     bool hit_it = false;
 
+    // the luxels are traced in packets, since they all share the
+    // light as their end point (and mostly the same path too).
+
+    pk_count = 0;
+
     for (int t = 0; t < lt_H; t++) {
         for (int s = 0; s < lt_W; s++) {
             const light_point_t &P = lt_points[s][t];
@@ -1314,27 +1529,23 @@ static void QLIT_ProcessLight(qLightmap_c *lmap, quake_light_t &light,
                 continue;
             }
 
-            if (!QVIS_TraceRay(P.x, P.y, P.z, light.x, light.y, light.z)) {
-                continue;
-            }
-
-            hit_it = true;
+            pk_s[pk_count] = s;
+            pk_t[pk_count] = t;
 
-            if (light.kind == LTK_Sun) {
-                Bump(s, t, (int)light.level, light.color);
-            } else {
-                float dist =
-                    ComputeDist(P.x, P.y, P.z, light.x, light.y, light.z);
+            pk_x[pk_count] = P.x;
+            pk_y[pk_count] = P.y;
+            pk_z[pk_count] = P.z;
 
-                if (dist < light.radius) {
-                    int value = light.level * (1.0 - dist / light.radius);
+            pk_count++;
 
-                    Bump(s, t, value, light.color);
-                }
+            if (pk_count == QVIS_PACKET_SIZE) {
+                hit_it |= TracePacket(light);
             }
         }
     }
 
+    hit_it |= TracePacket(light);
+
     // don't create a new style in the lightmap if the light never
     // touched the face (e.g. when on the other side of a wall).
 
@@ -1349,7 +1560,7 @@ static void QLIT_ProcessLight(qLightmap_c *lmap, quake_light_t &light,
     }
 }
 
-static void QLIT_LiquidLighting(qLightmap_c *lmap) {
+void qLightWorker_c::LiquidLighting(qLightmap_c *lmap) {
     for (int t = 0; t < lt_H; t++) {
         for (int s = 0; s < lt_W; s++) {
             const light_point_t &P = lt_points[s][t];
@@ -1373,7 +1584,7 @@ static void QLIT_LiquidLighting(qLightmap_c *lmap) {
     }
 }
 
-void QLIT_TestingStuff(qLightmap_c *lmap) {
+void qLightWorker_c::TestingStuff(qLightmap_c *lmap) {
     int W = lmap->width;
     int H = lmap->height;
 
@@ -1397,7 +1608,7 @@ void QLIT_TestingStuff(qLightmap_c *lmap) {
     }
 }
 
-void QLIT_LightFace(quake_face_c *F) {
+void qLightWorker_c::LightFace(quake_face_c *F) {
     lt_face = F;
 
     F->GetBounds(&lt_face_bbox);
@@ -1409,21 +1620,26 @@ void QLIT_LightFace(quake_face_c *F) {
     }
 
 #if 0  // DEBUG
-	QLIT_TestingStuff(F->lmap);
+	TestingStuff(F->lmap);
 	return;
 #endif
 
+    QLIT_QueryLights(lt_face_bbox, lt_lights);
+
+    lt_tested += (long long)lt_lights.size();
+    lt_culled += (long long)(qk_all_lights.size() - lt_lights.size());
+
     for (int pass = 0; pass < 4; pass++) {
         lt_current_style = (pass == 0) ? 0 : -1;
 
         ClearLightBuffer(pass ? 0 : q_low_light);
 
-        for (unsigned int i = 0; i < qk_all_lights.size(); i++) {
-            QLIT_ProcessLight(F->lmap, qk_all_lights[i], pass);
+        for (unsigned int i = 0; i < lt_lights.size(); i++) {
+            ProcessLight(F->lmap, qk_all_lights[lt_lights[i]], pass);
         }
 
         if (pass == 0) {
-            QLIT_LiquidLighting(F->lmap);
+            LiquidLighting(F->lmap);
 
             HandleOffFaceLuxels();
 
@@ -1431,7 +1647,7 @@ void QLIT_LightFace(quake_face_c *F) {
                 FilterSuperSamples();
             }
 
-            F->lmap->Store();
+            F->lmap->Store(blocklights);
         }
     }
 }
@@ -1730,12 +1946,13 @@ void QLIT_LightAllFaces() {
 
     LogPrintf("found {} lights\n", qk_all_lights.size());
 
+    QLIT_BuildLightIndex();
+
     QVIS_MakeTraceNodes();
 
-    int lit_faces = 0;
-    int lit_luxels = 0;
+    // collect the faces to light, including Q3 detail and map-model faces
 
-    // visit all faces, including Q3 detail and map-model faces
+    std::vector<quake_face_c *> faces;
 
     for (unsigned int i = 0; i < qk_all_faces.size(); i++) {
         quake_face_c *F = qk_all_faces[i];
@@ -1744,21 +1961,72 @@ void QLIT_LightAllFaces() {
             continue;
         }
 
-        QLIT_LightFace(F);
+        faces.push_back(F);
+    }
 
-        lit_faces++;
-        lit_luxels += F->lmap->width * F->lmap->height;
+    // light the faces in parallel.  the workers only create the
+    // lightmaps, they are registered afterwards in face order so
+    // that the output does not depend on thread timing.
+
+    int num_workers = MIN(PAR_NumWorkers(), (int)faces.size());
+
+    std::vector<qLightWorker_c *> workers;
+
+    for (int w = 0; w < MAX(1, num_workers); w++) {
+        workers.push_back(new qLightWorker_c);
+    }
+
+    LogPrintf("using {} lighting threads\n", (int)workers.size());
+
+    std::atomic<bool> cancelled(false);
+
+    PAR_ForEach((int)faces.size(), [&](int index, int worker) {
+        if (cancelled) {
+            return;
+        }
+
+        workers[worker]->LightFace(faces[index]);
 
-        if (lit_faces % 400 == 0) {
+        // only the main thread may touch the GUI
+        if (worker == 0) {
             Main::Ticker();
 
             if (main_action >= MAIN_CANCEL) {
-                break;
+                cancelled = true;
             }
+        }
+    });
+
+    long long tested = 0;
+    long long culled = 0;
+
+    for (qLightWorker_c *W : workers) {
+        tested += W->lt_tested;
+        culled += W->lt_culled;
+
+        delete W;
+    }
+
+    LogPrintf("light index: {} candidates tested, {} culled\n", tested,
+              culled);
+
+    int lit_faces = 0;
+    int lit_luxels = 0;
+
+    for (quake_face_c *F : faces) {
+        // skipped by a cancel?
+        if (!F->lmap) {
+            continue;
+        }
 
-            // fprintf(stderr, "lit %d faces (of %u)\n", lit_faces,
-            // qk_all_faces.size());
+        qk_all_lightmaps.push_back(F->lmap);
+
+        if (qk_game >= 3) {
+            F->lmap->AllocBlock();
         }
+
+        lit_faces++;
+        lit_luxels += F->lmap->width * F->lmap->height;
     }
 
     LogPrintf("lit {} faces (of {}) using {} luxels\n", lit_faces,
@@ -1777,6 +2045,7 @@ void QLIT_LightAllFaces() {
 	}
 #endif
 
+    QLIT_FreeLightIndex();
     QLIT_FreeLights();
     QVIS_FreeTraceNodes();
 }
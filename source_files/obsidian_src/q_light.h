@@ -33,6 +33,9 @@ class uv_matrix_c;
 // the maximum size of a face's lightmap in Quake I/II
 constexpr int FLAT_LIGHTMAP_SIZE = 17 * 17;
 
+// the maximum size of a Q3 lightmap, doubled when supersampling
+constexpr int MAX_LM_SIZE = 64;
+
 class qLightmap_c {
    public:
     int width, height;
@@ -73,8 +76,12 @@ class qLightmap_c {
     // true if all samples are zero
     bool isDark() const;
 
-    // transfer from blocklights[] array
-    void Store();
+    // transfer from a worker's blocklights[] array
+    void Store(const int blocklights[][MAX_LM_SIZE * 2][3]);
+
+    // for Q3, place lightmap into a shared block.
+    // must be called in face order (after Store).
+    void AllocBlock();
 
     void Write(qLump_c *lump);
 };
@@ -26,10 +26,13 @@
 
 #include "q_vis.h"
 
+#include <atomic>
+
 #include "csg_main.h"
 #include "csg_quake.h"
 #include "headers.h"
 #include "lib_file.h"
+#include "lib_parallel.h"
 #include "lib_util.h"
 #include "main.h"
 #include "q_common.h"
@@ -325,6 +328,203 @@ bool QVIS_TraceRay(float x1, float y1, float z1, float x2, float y2, float z2) {
     return true;
 }
 
+//------------------------------------------------------------------------
+
+// Packet tracing.  The rays of a packet are walked through the trace
+// nodes together, lanes which classify the same way at a node stay
+// in the same sub-packet.  Each lane does exactly the same arithmetic
+// as RecursiveTestRay() and visits leafs in the same order, so the
+// results are identical to tracing the rays one at a time.
+//
+// The per-lane loops use fixed-size arrays (structure of arrays)
+// so that the compiler can turn them into SIMD code.
+
+typedef struct {
+    float x[QVIS_PACKET_SIZE];
+    float y[QVIS_PACKET_SIZE];
+    float z[QVIS_PACKET_SIZE];
+} trace_lanes_t;
+
+static void PacketTestRay(int nodenum, unsigned int mask,
+                          const trace_lanes_t &A, const trace_lanes_t &B,
+                          int *result) {
+    for (;;) {
+        if (nodenum < 0) {
+            if (nodenum != TRACE_EMPTY) {
+                for (int i = 0; i < QVIS_PACKET_SIZE; i++) {
+                    if (mask & (1U << i)) {
+                        result[i] = nodenum;
+                    }
+                }
+            }
+            return;
+        }
+
+        const tnode_t *TN = &trace_nodes[nodenum];
+
+        float dist1[QVIS_PACKET_SIZE];
+        float dist2[QVIS_PACKET_SIZE];
+
+        switch (TN->type) {
+            case PLANE_X:
+                for (int i = 0; i < QVIS_PACKET_SIZE; i++) {
+                    dist1[i] = A.x[i] - TN->dist;
+                    dist2[i] = B.x[i] - TN->dist;
+                }
+                break;
+
+            case PLANE_Y:
+                for (int i = 0; i < QVIS_PACKET_SIZE; i++) {
+                    dist1[i] = A.y[i] - TN->dist;
+                    dist2[i] = B.y[i] - TN->dist;
+                }
+                break;
+
+            case PLANE_Z:
+                for (int i = 0; i < QVIS_PACKET_SIZE; i++) {
+                    dist1[i] = A.z[i] - TN->dist;
+                    dist2[i] = B.z[i] - TN->dist;
+                }
+                break;
+
+            default: {
+                const float nx = TN->normal[0];
+                const float ny = TN->normal[1];
+                const float nz = TN->normal[2];
+
+                for (int i = 0; i < QVIS_PACKET_SIZE; i++) {
+                    dist1[i] = A.x[i] * nx + A.y[i] * ny + A.z[i] * nz;
+                    dist2[i] = B.x[i] * nx + B.y[i] * ny + B.z[i] * nz;
+
+                    dist1[i] -= TN->dist;
+                    dist2[i] -= TN->dist;
+                }
+                break;
+            }
+        }
+
+        // classify each active lane
+        unsigned int front = 0;
+        unsigned int back = 0;
+        unsigned int cross[2] = {0, 0};
+
+        for (int i = 0; i < QVIS_PACKET_SIZE; i++) {
+            unsigned int bit = 1U << i;
+
+            if (!(mask & bit)) {
+                continue;
+            }
+
+            if (dist1[i] >= -T_EPSILON && dist2[i] >= -T_EPSILON) {
+                front |= bit;
+            } else if (dist1[i] < T_EPSILON && dist2[i] < T_EPSILON) {
+                back |= bit;
+            } else {
+                cross[(dist1[i] < 0) ? 1 : 0] |= bit;
+            }
+        }
+
+        // lanes which cross the node plane.
+        // check the front half of each ray, then the back half.
+
+        for (int side = 0; side < 2; side++) {
+            if (!cross[side]) {
+                continue;
+            }
+
+            trace_lanes_t M;
+
+            for (int i = 0; i < QVIS_PACKET_SIZE; i++) {
+                double frac = dist1[i] / (double)(dist1[i] - dist2[i]);
+
+                M.x[i] = A.x[i] + (B.x[i] - A.x[i]) * frac;
+                M.y[i] = A.y[i] + (B.y[i] - A.y[i]) * frac;
+                M.z[i] = A.z[i] + (B.z[i] - A.z[i]) * frac;
+            }
+
+            PacketTestRay(TN->children[side], cross[side], A, M, result);
+
+            // only the lanes which got through continue
+            unsigned int rest = 0;
+
+            for (int i = 0; i < QVIS_PACKET_SIZE; i++) {
+                if ((cross[side] & (1U << i)) && result[i] == TRACE_EMPTY) {
+                    rest |= (1U << i);
+                }
+            }
+
+            if (rest) {
+                PacketTestRay(TN->children[side ^ 1], rest, M, B, result);
+            }
+        }
+
+        // lanes completely on one side.  the common case is that the
+        // whole packet goes one way, so loop instead of recursing.
+
+        if (front && back) {
+            PacketTestRay(TN->children[1], back, A, B, result);
+            back = 0;
+        }
+
+        if (front) {
+            nodenum = TN->children[0];
+            mask = front;
+        } else if (back) {
+            nodenum = TN->children[1];
+            mask = back;
+        } else {
+            return;
+        }
+    }
+}
+
+void QVIS_TraceRays(int count, const float *x1, const float *y1,
+                    const float *z1, float x2, float y2, float z2, bool *ok) {
+    SYS_ASSERT(count <= QVIS_PACKET_SIZE);
+
+    if (count <= 0) {
+        return;
+    }
+
+    trace_lanes_t A;
+    trace_lanes_t B;
+
+    int result[QVIS_PACKET_SIZE];
+
+    for (int i = 0; i < QVIS_PACKET_SIZE; i++) {
+        // unused lanes get a copy of the first ray
+        int k = (i < count) ? i : 0;
+
+        A.x[i] = x1[k];
+        A.y[i] = y1[k];
+        A.z[i] = z1[k];
+
+        B.x[i] = x2;
+        B.y[i] = y2;
+        B.z[i] = z2;
+
+        result[i] = TRACE_EMPTY;
+    }
+
+    unsigned int mask = (1U << count) - 1;
+
+    PacketTestRay(0, mask, A, B, result);
+
+    for (int i = 0; i < count; i++) {
+        if (result[i] == TRACE_SOLID) {
+            ok[i] = false;
+            continue;
+        }
+
+        // check for detail faces *after* the main trace
+
+        int r = RecursiveTestDetail(qk_bsp_root, NULL, x1[i], y1[i], z1[i], x2,
+                                    y2, z2);
+
+        ok[i] = (r != TRACE_SOLID);
+    }
+}
+
 static int RecursiveTestPoint(int nodenum, float x, float y, float z) {
     for (;;) {
         if (nodenum < 0) {
@@ -562,9 +762,6 @@ static void FloodAmbientSounds() {
 
 static qLump_c *q_visibility;
 
-static byte *v_row_buffer;
-static byte *v_compress_buffer;
-
 static int v_row_bits;  // number of leafs or clusters
 static int v_bytes_per_row;
 
@@ -617,14 +814,55 @@ typedef struct {
 static vis_statistics_t pvs_stats;
 static vis_statistics_t phs_stats;
 
-static int WriteCompressedRow(bool PHS) {
-    // returns offset for the written data block
-    int visofs = (int)q_visibility->GetSize();
+// Each worker thread has its own copy of the vis buffer and its
+// own row buffers, so the clusters can be processed in parallel.
+// The finished rows are kept per cluster and appended to the lump
+// afterwards in cluster order, so the offsets are deterministic.
+
+class vis_worker_c {
+   public:
+    Vis_Buffer *visbuf;
+
+    byte *row_buffer;
+    byte *compress_buffer;
+
+   public:
+    vis_worker_c(const Vis_Buffer &src) {
+        visbuf = new Vis_Buffer(src);
+
+        row_buffer = new byte[1 + v_bytes_per_row];
+
+        // the worst case scenario for compression is 50% larger
+        compress_buffer = new byte[1 + 2 * v_bytes_per_row];
+    }
+
+    ~vis_worker_c() {
+        delete visbuf;
+
+        delete[] row_buffer;
+        delete[] compress_buffer;
+    }
+
+    void CompressRow(std::vector<byte> &out);
+
+    float CollectRowData(int src_x, int src_y);
+};
+
+// the finished data for a single cluster
+typedef struct {
+    std::vector<byte> pvs;  // compressed, except for Quake III
+    std::vector<byte> phs;  // Quake II only
+
+    float pvs_perc;
+    float phs_perc;
 
-    const byte *src = v_row_buffer;
+} vis_row_t;
+
+void vis_worker_c::CompressRow(std::vector<byte> &out) {
+    const byte *src = row_buffer;
     const byte *s_end = src + v_bytes_per_row;
 
-    byte *dest = v_compress_buffer;
+    byte *dest = compress_buffer;
 
     while (src < s_end) {
         if (*src) {
@@ -644,36 +882,20 @@ static int WriteCompressedRow(bool PHS) {
         *dest++ = repeat;
     }
 
-    int length = (dest - v_compress_buffer);
-
-    q_visibility->Append(v_compress_buffer, length);
-
-    if (PHS) {
-        phs_stats.uncompressed += v_bytes_per_row;
-        phs_stats.compressed += length;
-    } else {
-        pvs_stats.uncompressed += v_bytes_per_row;
-        pvs_stats.compressed += length;
-    }
-
-    return visofs;
+    out.assign(compress_buffer, dest);
 }
 
-static void WriteUncompressedRow() {
-    int length = v_bytes_per_row;
-
-    q_visibility->Append(v_row_buffer, length);
-}
+float vis_worker_c::CollectRowData(int src_x, int src_y) {
+    // returns the visibility percentage (for statistics)
 
-static void CollectRowData(int src_x, int src_y, bool PHS) {
     // initial state : everything visible
-    memset(v_row_buffer, 0xFF, v_bytes_per_row);
+    memset(row_buffer, 0xFF, v_bytes_per_row);
 
     unsigned int blocked = 0;  // statistics
 
     for (int cy = 0; cy < cluster_H; cy++) {
         for (int cx = 0; cx < cluster_W; cx++) {
-            if ((cx == src_x && cy == src_y) || qk_visbuf->CanSee(cx, cy)) {
+            if ((cx == src_x && cy == src_y) || visbuf->CanSee(cx, cy)) {
                 continue;
             }
 
@@ -686,7 +908,7 @@ static void CollectRowData(int src_x, int src_y, bool PHS) {
                 SYS_ASSERT(index >= 0);
                 SYS_ASSERT((index >> 3) < v_bytes_per_row);
 
-                v_row_buffer[index >> 3] &= ~(1 << (index & 7));
+                row_buffer[index >> 3] &= ~(1 << (index & 7));
 
                 blocked++;
             } else  // original Quake, data is indexed by leaf number
@@ -705,7 +927,7 @@ static void CollectRowData(int src_x, int src_y, bool PHS) {
                     SYS_ASSERT(index >= 0);
                     SYS_ASSERT((index >> 3) < v_bytes_per_row);
 
-                    v_row_buffer[index >> 3] &= ~(1 << (index & 7));
+                    row_buffer[index >> 3] &= ~(1 << (index & 7));
                 }
             }
         }
@@ -716,74 +938,140 @@ static void CollectRowData(int src_x, int src_y, bool PHS) {
 			src_x, src_y, blocked, blocked * 100.0 / v_row_bits);
 #endif
 
-    // update statistics
-    float perc = (v_row_bits - blocked) * 100.0 / (float)MAX(1, v_row_bits);
+#ifdef DEBUG_INVERT_MAP
+    for (int n = 0; n < v_bytes_per_row; n++) row_buffer[n] ^= 0xFF;
+#endif
+
+    return (v_row_bits - blocked) * 100.0 / (float)MAX(1, v_row_bits);
+}
+
+static void WriteRow(const std::vector<byte> &data, bool PHS) {
+    q_visibility->Append(data.data(), (int)data.size());
+
+    if (qk_game == 3) {
+        return;
+    }
 
     if (PHS) {
-        phs_stats.AddValue(perc);
+        phs_stats.uncompressed += v_bytes_per_row;
+        phs_stats.compressed += (int)data.size();
     } else {
-        pvs_stats.AddValue(perc);
+        pvs_stats.uncompressed += v_bytes_per_row;
+        pvs_stats.compressed += (int)data.size();
     }
-
-#ifdef DEBUG_INVERT_MAP
-    for (int n = 0; n < v_bytes_per_row; n++) v_row_buffer[n] ^= 0xFF;
-#endif
 }
 
 static void Build_PVS() {
     qk_visbuf->SimplifySolid();
 
-    int done = 0;
+    int num_clusters = cluster_W * cluster_H;
 
-    for (int cy = 0; cy < cluster_H; cy++) {
-        for (int cx = 0; cx < cluster_W; cx++) {
-            qCluster_c *cluster = qk_clusters[cy * cluster_W + cx];
+    std::vector<vis_row_t> rows(num_clusters);
 
-            if (cluster->leafs.empty()) {
-                if (qk_game == 3) {
-                    memset(v_row_buffer, 0, v_bytes_per_row);
-                    WriteUncompressedRow();
-                }
+    std::vector<vis_worker_c *> workers;
 
-                continue;
+    int num_workers = MAX(1, MIN(PAR_NumWorkers(), num_clusters));
+
+    for (int w = 0; w < num_workers; w++) {
+        workers.push_back(new vis_worker_c(*qk_visbuf));
+    }
+
+    std::atomic<bool> cancelled(false);
+
+    PAR_ForEach(num_clusters, [&](int index, int worker) {
+        if (cancelled) {
+            return;
+        }
+
+        int cx = index % cluster_W;
+        int cy = index / cluster_W;
+
+        qCluster_c *cluster = qk_clusters[index];
+
+        if (cluster->leafs.empty()) {
+            return;
+        }
+
+        vis_worker_c *VW = workers[worker];
+        vis_row_t &row = rows[index];
+
+        VW->visbuf->ClearVis();
+        VW->visbuf->ProcessVis(cx, cy);
+
+        row.pvs_perc = VW->CollectRowData(cx, cy);
+
+        if (qk_game == 3) {
+            row.pvs.assign(VW->row_buffer, VW->row_buffer + v_bytes_per_row);
+        } else {
+            VW->CompressRow(row.pvs);
+        }
+
+        if (qk_game == 2) {
+            // Quake II's Potentially Hearable Set
+            //
+            // 1. start off with the PVS set
+            // 2. flood fill for a few passes
+            // 3. truncate it based on distance
+
+            VW->visbuf->FloodFill(4);
+            VW->visbuf->Truncate(8);
+
+            row.phs_perc = VW->CollectRowData(cx, cy);
+
+            VW->CompressRow(row.phs);
+        }
+
+        // only the main thread may touch the GUI
+        if (worker == 0) {
+            Main::Ticker();
+
+            if (main_action >= MAIN_CANCEL) {
+                cancelled = true;
             }
+        }
+    });
+
+    for (vis_worker_c *VW : workers) {
+        delete VW;
+    }
+
+    if (cancelled) {
+        return;
+    }
+
+    // append the rows in cluster order
+
+    std::vector<byte> empty_row(v_bytes_per_row, 0);
 
-            qk_visbuf->ClearVis();
-            qk_visbuf->ProcessVis(cx, cy);
+    for (int index = 0; index < num_clusters; index++) {
+        qCluster_c *cluster = qk_clusters[index];
 
-            CollectRowData(cx, cy, false);
+        vis_row_t &row = rows[index];
 
+        if (cluster->leafs.empty()) {
             if (qk_game == 3) {
-                WriteUncompressedRow();
-                cluster->visofs = 1;  // dummy value, unused
-            } else {
-                cluster->visofs = WriteCompressedRow(false);
+                WriteRow(empty_row, false);
             }
 
-            if (qk_game == 2) {
-                // Quake II's Potentially Hearable Set
-                //
-                // 1. start off with the PVS set
-                // 2. flood fill for a few passes
-                // 3. truncate it based on distance
+            continue;
+        }
 
-                qk_visbuf->FloodFill(4);
-                qk_visbuf->Truncate(8);
+        pvs_stats.AddValue(row.pvs_perc);
 
-                CollectRowData(cx, cy, true);
+        if (qk_game == 3) {
+            cluster->visofs = 1;  // dummy value, unused
+        } else {
+            cluster->visofs = (int)q_visibility->GetSize();
+        }
 
-                cluster->hearofs = WriteCompressedRow(true);
-            }
+        WriteRow(row.pvs, false);
 
-            if (done % 80 == 0) {
-                Main::Ticker();
+        if (qk_game == 2) {
+            phs_stats.AddValue(row.phs_perc);
 
-                if (main_action >= MAIN_CANCEL) {
-                    return;
-                }
-            }
+            cluster->hearofs = (int)q_visibility->GetSize();
 
-            done++;
+            WriteRow(row.phs, true);
         }
     }
 }
@@ -866,11 +1154,6 @@ void QVIS_Visibility(int lump, int max_size, int numleafs) {
 
     LogPrintf("bits per row: {} --> bytes: {}\n", v_row_bits, v_bytes_per_row);
 
-    v_row_buffer = new byte[1 + v_bytes_per_row];
-
-    // the worst case scenario for compression is 50% larger
-    v_compress_buffer = new byte[1 + 2 * v_bytes_per_row];
-
     q_visibility = BSP_NewLump(lump);
 
     if (qk_game == 3) {
@@ -901,9 +1184,6 @@ void QVIS_Visibility(int lump, int max_size, int numleafs) {
                 "Quake build failure: exceeded VISIBILITY limit\n");
         }
     }
-
-    delete[] v_row_buffer;
-    delete[] v_compress_buffer;
 }
 
 //--- editor settings ---
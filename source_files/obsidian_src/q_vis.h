@@ -74,6 +74,15 @@ void QVIS_FreeTraceNodes();
 // returns true if OK, false if blocked
 bool QVIS_TraceRay(float x1, float y1, float z1, float x2, float y2, float z2);
 
+// maximum number of rays in a single QVIS_TraceRays() call
+constexpr int QVIS_PACKET_SIZE = 16;
+
+// traces a packet of rays which all end at the same point (e.g. a
+// light), giving the same results as calling QVIS_TraceRay for each
+// one.  ok[i] becomes true if ray 'i' is OK, false if blocked.
+void QVIS_TraceRays(int count, const float *x1, const float *y1,
+                    const float *z1, float x2, float y2, float z2, bool *ok);
+
 // returns true if point is in air, false for solid or sky
 bool QVIS_TracePoint(float x, float y, float z);
 
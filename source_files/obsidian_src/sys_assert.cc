@@ -19,12 +19,15 @@
 //----------------------------------------------------------------------------
 
 #include "headers.h"
+#include "lib_parallel.h"
 #include "main.h"
 
 assert_fail_c::assert_fail_c(const char *_msg) {
-    strncpy(message, _msg, sizeof(message));
+    // long messages are cut short
+    size_t len = MIN(strlen(_msg), sizeof(message) - 1);
 
-    message[sizeof(message) - 1] = 0;
+    memcpy(message, _msg, len);
+    message[len] = 0;
 }
 
 assert_fail_c::~assert_fail_c() { /* nothing needed */
@@ -45,7 +48,7 @@ assert_fail_c &assert_fail_c::operator=(const assert_fail_c &other) {
 //----------------------------------------------------------------------------
 
 void AssertFail(const char *msg, ...) {
-    static char buffer[MSG_BUF_LEN];
+    char buffer[MSG_BUF_LEN];
 
     va_list argptr;
 
@@ -57,6 +60,12 @@ void AssertFail(const char *msg, ...) {
 
     // NO WORKY WITH LUA :( ---> throw assert_fail_c(buffer);
 
+    // but a worker thread cannot show the error, so hand it back to
+    // PAR_ForEach, which reports it on the calling thread.
+    if (PAR_InWorker()) {
+        throw assert_fail_c(buffer);
+    }
+
     Main::FatalError("Sorry, an internal error occurred.\n{}", buffer);
 }
 
@@ -18,20 +18,316 @@
 //
 //------------------------------------------------------------------------
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <fstream>
 #include <iostream>
+#include <mutex>
+#include <thread>
+
 #include "headers.h"
 #include "lib_util.h"
 #include "main.h"
 
 #define DEBUG_BUF_LEN 20000
 
-std::fstream log_file;
+// size of the queue between LogPrintf() and the writer thread
+#define LOG_RING_SIZE (1 << 20)
+
+// longest piece of a message which is queued in one go
+#define LOG_RECORD_MAX (LOG_RING_SIZE / 8)
+
+// how often the writer thread wakes up when nobody asks it to
+#define LOG_WRITER_INTERVAL 50  // milliseconds
+
+static std::fstream log_file;
 static std::filesystem::path log_filename;
 
 bool debugging = false;
 bool terminal = false;
 
+// Messages are queued in a ring buffer as a record header followed by
+// the text, and written out by a background thread so the generator
+// never waits on file or terminal I/O.  Producers only hold log_put_lock
+// to serialize themselves (LogPrintf is called from worker threads too),
+// the writer thread reads the ring without taking any lock.
+
+typedef struct {
+    u32_t length;
+
+    u8_t level;
+    u8_t terminal;  // show it on stdout too
+    u8_t more;      // the message continues in the next record
+    u8_t pad;
+} log_record_t;
+
+static char log_ring[LOG_RING_SIZE];
+
+static std::atomic<size_t> log_head;  // advanced by producers
+static std::atomic<size_t> log_tail;  // advanced by the writer thread
+
+static std::mutex log_put_lock;
+
+// these are protected by log_put_lock
+static bool log_running;
+static std::thread log_writer;
+
+static std::mutex log_wake_lock;
+static std::condition_variable log_wake;
+static std::condition_variable log_synced_cond;
+
+// these are protected by log_wake_lock
+static bool log_sync_wanted;
+static bool log_quit;
+static size_t log_synced;  // everything before this has been written
+
+// only touched by whoever is writing the output
+static bool log_debug_midline;
+
+static void LogOutput(const log_record_t &R, const char *text) {
+    if (R.level == LOG_LEVEL_DEBUG) {
+        // debug messages are shown on the terminal, one "#" per line
+        const char *end = text + R.length;
+
+        while (text < end) {
+            const char *next = std::find(text, end, '\n');
+
+            if (next < end) {
+                next++;
+            }
+
+            if (!log_debug_midline) {
+                fputs("# ", stdout);
+            }
+
+            fwrite(text, 1, next - text, stdout);
+
+            log_debug_midline = (next[-1] != '\n');
+
+            text = next;
+        }
+
+        if (log_debug_midline && !R.more) {
+            fputc('\n', stdout);
+            log_debug_midline = false;
+        }
+        return;
+    }
+
+    log_file.write(text, R.length);
+
+    if (R.terminal) {
+        fwrite(text, 1, R.length, stdout);
+    }
+}
+
+static void LogSyncOutput() {
+    log_file.flush();
+    fflush(stdout);
+}
+
+static void LogRingRead(size_t pos, void *dest, size_t length) {
+    size_t ofs = pos % LOG_RING_SIZE;
+    size_t first = std::min(length, (size_t)LOG_RING_SIZE - ofs);
+
+    memcpy(dest, log_ring + ofs, first);
+    memcpy((char *)dest + first, log_ring, length - first);
+}
+
+static void LogRingWrite(size_t pos, const void *src, size_t length) {
+    size_t ofs = pos % LOG_RING_SIZE;
+    size_t first = std::min(length, (size_t)LOG_RING_SIZE - ofs);
+
+    memcpy(log_ring + ofs, src, first);
+    memcpy(log_ring, (const char *)src + first, length - first);
+}
+
+// writes out every record between the tail and the given position.
+static void LogDrain(size_t head) {
+    size_t tail = log_tail.load(std::memory_order_relaxed);
+
+    std::string wrapped;
+
+    while (tail < head) {
+        log_record_t R;
+
+        LogRingRead(tail, &R, sizeof(R));
+
+        size_t ofs = (tail + sizeof(R)) % LOG_RING_SIZE;
+
+        if (ofs + R.length <= LOG_RING_SIZE) {
+            LogOutput(R, log_ring + ofs);
+        } else {
+            wrapped.resize(R.length);
+            LogRingRead(tail + sizeof(R), wrapped.data(), R.length);
+            LogOutput(R, wrapped.data());
+        }
+
+        tail += sizeof(R) + R.length;
+
+        log_tail.store(tail, std::memory_order_release);
+    }
+}
+
+static void LogWriterThread() {
+    for (;;) {
+        bool quit;
+
+        {
+            std::unique_lock<std::mutex> lock(log_wake_lock);
+
+            log_wake.wait_for(
+                lock, std::chrono::milliseconds(LOG_WRITER_INTERVAL),
+                [] { return log_sync_wanted || log_quit; });
+
+            log_sync_wanted = false;
+            quit = log_quit;
+        }
+
+        size_t head = log_head.load(std::memory_order_acquire);
+
+        if (head != log_tail.load(std::memory_order_relaxed)) {
+            LogDrain(head);
+            LogSyncOutput();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(log_wake_lock);
+            log_synced = head;
+        }
+
+        log_synced_cond.notify_all();
+
+        if (quit) {
+            return;
+        }
+    }
+}
+
+static void LogWakeWriter() {
+    {
+        std::lock_guard<std::mutex> lock(log_wake_lock);
+        log_sync_wanted = true;
+    }
+
+    log_wake.notify_one();
+}
+
+// caller must hold log_put_lock
+static void LogPush(const log_record_t &R, const char *text) {
+    size_t need = sizeof(R) + R.length;
+    size_t head = log_head.load(std::memory_order_relaxed);
+
+    // wait for the writer thread to make room
+    if (LOG_RING_SIZE - (head - log_tail.load(std::memory_order_acquire)) <
+        need) {
+        LogWakeWriter();
+
+        std::unique_lock<std::mutex> lock(log_wake_lock);
+
+        log_synced_cond.wait(lock, [&] {
+            return LOG_RING_SIZE -
+                       (head - log_tail.load(std::memory_order_acquire)) >=
+                   need;
+        });
+    }
+
+    LogRingWrite(head, &R, sizeof(R));
+    LogRingWrite(head + sizeof(R), text, R.length);
+
+    log_head.store(head + need, std::memory_order_release);
+
+    // give the writer a nudge when the ring is getting full
+    size_t used = head + need - log_tail.load(std::memory_order_relaxed);
+
+    if (used >= LOG_RING_SIZE / 2 && used - need < LOG_RING_SIZE / 2) {
+        LogWakeWriter();
+    }
+}
+
+void LogWrite(log_level_e level, std::string_view text) {
+    log_record_t R;
+
+    R.level = level;
+    R.terminal = terminal ? 1 : 0;
+    R.pad = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(log_put_lock);
+
+        do {
+            R.length = std::min(text.size(), (size_t)LOG_RECORD_MAX);
+            R.more = (R.length < text.size()) ? 1 : 0;
+
+            if (log_running) {
+                LogPush(R, text.data());
+            } else {
+                LogOutput(R, text.data());
+            }
+
+            text.remove_prefix(R.length);
+        } while (!text.empty());
+    }
+
+    if (level >= LOG_LEVEL_ERROR) {
+        LogFlush();
+    }
+}
+
+void LogFlush(void) {
+    size_t target;
+
+    {
+        std::lock_guard<std::mutex> lock(log_put_lock);
+
+        if (!log_running) {
+            LogSyncOutput();
+            return;
+        }
+
+        target = log_head.load(std::memory_order_relaxed);
+    }
+
+    LogWakeWriter();
+
+    std::unique_lock<std::mutex> lock(log_wake_lock);
+
+    log_synced_cond.wait(lock, [target] { return log_synced >= target; });
+}
+
+static void LogStartWriter() {
+    std::lock_guard<std::mutex> lock(log_put_lock);
+
+    if (log_running) {
+        return;
+    }
+
+    log_quit = false;
+    log_running = true;
+
+    log_writer = std::thread(LogWriterThread);
+}
+
+static void LogStopWriter() {
+    // holding this keeps the producers out until the ring is empty
+    std::lock_guard<std::mutex> lock(log_put_lock);
+
+    if (!log_running) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> wake_lock(log_wake_lock);
+        log_quit = true;
+    }
+
+    log_wake.notify_one();
+    log_writer.join();
+
+    log_running = false;
+}
+
 bool LogInit(const std::filesystem::path &filename) {
     if (!filename.empty()) {
         log_filename = filename;
@@ -43,6 +339,16 @@ bool LogInit(const std::filesystem::path &filename) {
         }
     }
 
+    // make sure nothing is lost when exit() is called directly
+    static bool registered_exit = false;
+
+    if (!registered_exit) {
+        std::atexit(LogStopWriter);
+        registered_exit = true;
+    }
+
+    LogStartWriter();
+
     LogPrintf("====== START OF OBSIDIAN LOGS ======\n");
 
     return true;
@@ -67,6 +373,8 @@ void LogEnableTerminal(bool enable) { terminal = enable; }
 void LogClose(void) {
     LogPrintf("\n====== END OF OBSIDIAN LOGS ======\n\n");
 
+    LogStopWriter();
+
     log_file.close();
     log_filename.clear();
 }
@@ -76,6 +384,9 @@ void LogReadLines(log_display_func_t display_func, void *priv_data) {
         return;
     }
 
+    // the writer thread must not touch the file while it is re-opened
+    LogStopWriter();
+
     // we close the log file so we can read it, and then open it
     // again when finished.  That is because Windows OSes can be
     // fussy about opening already open files (in Linux it would
@@ -87,6 +398,7 @@ void LogReadLines(log_display_func_t display_func, void *priv_data) {
 
     // this is very unlikely to happen, but check anyway
     if (!log_file) {
+        LogStartWriter();
         return;
     }
 
@@ -106,6 +418,8 @@ void LogReadLines(log_display_func_t display_func, void *priv_data) {
     // open the log file for writing again
     // [ it is unlikely to fail, but if it does then no biggie ]
     log_file.open(log_filename, std::ios::app);
+
+    LogStartWriter();
 }
 
 //--- editor settings ---
@@ -27,35 +27,56 @@
 #include <string>
 #include <fmt/core.h>
 #include <fmt/ostream.h>
+
+// message levels, least important first
+enum log_level_e {
+    LOG_LEVEL_DEBUG = 0,  // terminal only, and only when debugging
+    LOG_LEVEL_NORMAL,
+    LOG_LEVEL_ERROR,  // flushed to the log file straight away
+};
+
+// messages below this level are not compiled in at all
+#ifndef OBSIDIAN_LOG_LEVEL
+#define OBSIDIAN_LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+
 extern bool terminal;
 extern bool debugging;
-extern std::fstream log_file;
+
 bool LogInit(const std::filesystem::path &filename);  // NULL for none
 void LogClose(void);
 
 void LogEnableDebug(bool enable);
 void LogEnableTerminal(bool enable);
 
-template <typename... Args>
-void LogPrintf(std::string_view str, Args &&...args) {
-    fmt::print(log_file, str, args...);
+// queues a formatted message for the log writer thread.
+void LogWrite(log_level_e level, std::string_view text);
+
+// waits until everything logged so far has been written out.
+void LogFlush(void);
+
+template <log_level_e level, typename... Args>
+void LogMessage(std::string_view str, Args &&...args) {
+    if constexpr (level >= OBSIDIAN_LOG_LEVEL) {
+        if (level == LOG_LEVEL_DEBUG && !debugging) {
+            return;
+        }
+
+        fmt::memory_buffer buffer;
+        fmt::vformat_to(fmt::appender(buffer), str,
+                        fmt::make_format_args(args...));
 
-    // show on the Linux terminal too
-    if (terminal) {
-        fmt::print(str, args...);
+        LogWrite(level, std::string_view(buffer.data(), buffer.size()));
     }
 }
+
+template <typename... Args>
+void LogPrintf(std::string_view str, Args &&...args) {
+    LogMessage<LOG_LEVEL_NORMAL>(str, std::forward<Args>(args)...);
+}
 template <typename... Args>
 void DebugPrintf(std::string_view format, Args &&...args) {
-    if (debugging) {
-        std::string buffer = fmt::format(format, args...);
-        auto next = std::find(buffer.begin(), buffer.end(), '\n');
-        for (auto pos = buffer.begin(); pos != buffer.end();) {
-            fmt::print("# {}\n", std::string{pos, next});
-            pos = next;
-            next = std::find(pos + 1, buffer.end(), '\n');
-        }
-    }
+    LogMessage<LOG_LEVEL_DEBUG>(format, std::forward<Args>(args)...);
 }
 
 using log_display_func_t = void (*)(std::string_view line, void *priv_data);
@@ -13,6 +13,8 @@ other sections of code.
 
 #include "sys_twister.h"
 
+#include "lib_util.h"
+
 std::independent_bits_engine<
     std::mersenne_twister_engine<unsigned long long, 64, 312, 156, 31,
                                  0xb5026f5aa96619e9, 29, 0x5555555555555555, 17,
@@ -21,9 +23,62 @@ std::independent_bits_engine<
     63, unsigned long long>
     twister;
 
-void twister_Init() { twister.seed(std::chrono::system_clock::to_time_t(std::chrono::system_clock::now())); }
+// root key of the named streams, follows the twister's seed
+static std::uint64_t stream_root;
+
+static std::uint64_t stream_mix(std::uint64_t z) {
+    // the SplitMix64 finalizer
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+std::uint64_t rng_stream_c::UInt() {
+    counter++;
+
+    return stream_mix(key + counter * 0x9e3779b97f4a7c15ULL);
+}
+
+double rng_stream_c::Double() { return ldexp(UInt() >> 11, -53); }
+
+int rng_stream_c::Between(int low, int high) {
+    std::uint64_t range = (std::uint64_t)((std::int64_t)high - low) + 1;
+
+    // reject the values which would make some results more likely
+    std::uint64_t limit = (0 - range) % range;
+
+    for (;;) {
+        std::uint64_t value = UInt();
+
+        if (value >= limit) {
+            return (int)(low + (std::int64_t)(value % range));
+        }
+    }
+}
+
+rng_stream_c rng_stream_c::Split(std::string_view name) const {
+    return rng_stream_c(stream_mix(key ^ stream_mix(FNV1aHash(name))));
+}
 
-void twister_Reseed(unsigned long long random) { twister.seed(random); }
+rng_stream_c rng_stream_c::Split(std::uint64_t index) const {
+    return rng_stream_c(
+        stream_mix(key ^ stream_mix(index + 0x632be59bd9b4e019ULL)));
+}
+
+rng_stream_c twister_Stream(std::string_view name) {
+    return rng_stream_c(stream_root).Split(name);
+}
+
+void twister_Init() {
+    twister_Reseed(std::chrono::system_clock::to_time_t(
+        std::chrono::system_clock::now()));
+}
+
+void twister_Reseed(unsigned long long random) {
+    twister.seed(random);
+
+    stream_root = stream_mix(random);
+}
 
 unsigned long long twister_UInt() { return twister(); }
 
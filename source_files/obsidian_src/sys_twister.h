@@ -11,8 +11,42 @@ similar to AJ_Random as possible in order to minimize changes to
 other sections of code
 */
 
+#ifndef __SYS_TWISTER_H__
+#define __SYS_TWISTER_H__
+
 #include <chrono>
+#include <cstdint>
 #include <random>
+#include <string_view>
+
+/*
+Counter-based random streams
+
+Each stream is just a key and a counter, value N of a stream is a hash
+of (key, N), so streams are cheap to create and copy.  Streams are
+named and derived from the seed given to twister_Reseed(), so two
+subsystems (or two workers) can each draw from their own stream and get
+the same numbers no matter which order they run in.
+*/
+
+class rng_stream_c {
+   public:
+    std::uint64_t key;
+    std::uint64_t counter;
+
+   public:
+    rng_stream_c() : key(0), counter(0) {}
+
+    explicit rng_stream_c(std::uint64_t _key) : key(_key), counter(0) {}
+
+    std::uint64_t UInt();  // full 64 bits
+    double Double();       // 0.0 <= value < 1.0
+    int Between(int low, int high);
+
+    // a new stream, independent of this one
+    rng_stream_c Split(std::string_view name) const;
+    rng_stream_c Split(std::uint64_t index) const;
+};
 
 void twister_Init();
 
@@ -23,3 +57,8 @@ unsigned long long twister_UInt();
 double twister_Double();
 
 int twister_Between(int low, int high);
+
+// the named stream for the current seed
+rng_stream_c twister_Stream(std::string_view name);
+
+#endif /* __SYS_TWISTER_H__ */
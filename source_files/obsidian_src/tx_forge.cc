@@ -169,6 +169,8 @@ static void fourn(float data[], int nn[], int ndim, int isign) {
 
 static double gauss_add, gauss_mul; /* Gaussian random parameters */
 
+static rng_stream_c synth_rng;
+
 static void init_gauss(void) {
     /* Range of random generator */
     gauss_add = sqrt(3.0 * NRAND);
@@ -181,13 +183,13 @@ static double rand_gauss(void) {
     double sum = 0.0;
 
     for (int i = 0; i < NRAND; i++) {
-        sum += (twister_UInt() & 0xFFFF);
+        sum += (synth_rng.UInt() & 0xFFFF);
     }
 
     return sum * gauss_mul - gauss_add;
 }
 
-static double rand_phase(void) { return 2 * M_PI * twister_Double(); }
+static double rand_phase(void) { return 2 * M_PI * synth_rng.Double(); }
 
 /*  SPECTRALSYNTH  --  Spectrally  synthesized  fractal  motion in two
                        dimensions.  This algorithm is given under  the
@@ -304,7 +306,7 @@ void TX_SpectralSynth(unsigned long long seed, float *buf, int width,
         }
     }
 
-    twister_Reseed(seed);
+    synth_rng = rng_stream_c(seed).Split("spectral");
 
     init_gauss();
 
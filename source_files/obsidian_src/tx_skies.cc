@@ -100,16 +100,16 @@ void SKY_AddStars(unsigned long long seed, byte *pixels, int W, int H,
     SYS_ASSERT(powscale > 0);
     SYS_ASSERT(thresh < 0.99);
 
-    twister_Reseed(seed);
+    rng_stream_c rng = rng_stream_c(seed).Split("stars");
 
     for (int y = 0; y < H; y++) {
         byte *dest = &pixels[y * W];
         byte *d_end = dest + W;
 
         while (dest < d_end) {
-            double v = twister_Double();
-            v *= twister_Double();
-            v *= twister_Double();
+            double v = rng.Double();
+            v *= rng.Double();
+            v *= rng.Double();
 
             v = pow(v, powscale);
 
@@ -139,9 +139,9 @@ void SKY_AddHills(unsigned long long seed, byte *pixels, int W, int H,
 
     TX_SpectralSynth(seed, height_map, W, fracdim, powscale);
 
-    twister_Reseed(seed ^ 0x1234567);
+    rng_stream_c rng = rng_stream_c(seed).Split("hills");
 
-    bool use_slope_z = (twister_UInt() & 255) < 20;
+    bool use_slope_z = (rng.UInt() & 255) < 20;
 
     // convert range from 0.0 .. 1.0 to min_h . max_h
     int x, z;
@@ -243,7 +243,7 @@ void SKY_AddBuilding(unsigned long long seed, byte *pixels, int W, int H,
 
     win_prob = win_prob * 65535 / 100;
 
-    twister_Reseed(seed);
+    rng_stream_c rng = rng_stream_c(seed).Split("building");
 
     int x, y;
 
@@ -274,7 +274,7 @@ void SKY_AddBuilding(unsigned long long seed, byte *pixels, int W, int H,
             for (win_x = x1 + 2; win_x + win_w <= x2 - 2; win_x += win_w + 1) {
                 byte fg = colors[1];
 
-                if (((int)twister_UInt() & 0xFFFF) > win_prob) {
+                if (((int)rng.UInt() & 0xFFFF) > win_prob) {
                     fg = (numcol >= 3) ? colors[2] : bg;
                 }
 
@@ -28,14 +28,34 @@ Vis_Buffer::Vis_Buffer(int width, int height)
     : W(width),
       H(height),
       quick_mode(false),
+      loc_x(0),
+      loc_y(0),
       flip_x(0),
       flip_y(0),
+      limit_x(0),
+      limit_y(0),
       saved_cells() {
     data = new short[W * H];
 
     Clear();
 }
 
+Vis_Buffer::Vis_Buffer(const Vis_Buffer &other)
+    : W(other.W),
+      H(other.H),
+      quick_mode(other.quick_mode),
+      loc_x(other.loc_x),
+      loc_y(other.loc_y),
+      flip_x(other.flip_x),
+      flip_y(other.flip_y),
+      limit_x(other.limit_x),
+      limit_y(other.limit_y),
+      saved_cells(other.saved_cells) {
+    data = new short[W * H];
+
+    memcpy(data, other.data, sizeof(short) * W * H);
+}
+
 Vis_Buffer::~Vis_Buffer() { delete[] data; }
 
 void Vis_Buffer::Clear() { memset(data, 0, sizeof(short) * W * H); }
@@ -62,8 +62,11 @@ class Vis_Buffer {
 
    public:
     Vis_Buffer(int width, int height);
+    Vis_Buffer(const Vis_Buffer &other);
     ~Vis_Buffer();
 
+    Vis_Buffer &operator=(const Vis_Buffer &other) = delete;
+
    public:
     inline int Trans_X(int x) { return flip_x ? (loc_x * 2 - x) : x; }
 
@@ -978,6 +978,7 @@ void make_secret_level(dumphandle dh, haa *oldhaa, config *c)
   DumpLevel(dh,SecConfig,&SecLevel,SecConfig->episode,
                                    SecConfig->mission,
                                    SecConfig->map);
+  FreeLevel(&SecLevel);
   if (SecConfig->map==31) {
     SecConfig->map=32;
     SecConfig->secret_themes = SLUMP_TRUE;
@@ -985,6 +986,7 @@ void make_secret_level(dumphandle dh, haa *oldhaa, config *c)
     DumpLevel(dh,SecConfig,&SecLevel,SecConfig->episode,
                                      SecConfig->mission,
                                      SecConfig->map);
+    FreeLevel(&SecLevel);
   }
 
 }
@@ -32,15 +32,25 @@
 #include "m_lua.h"
 #include "lib_util.h"
 #include <assert.h>
+#include <algorithm>
 #include <cstdlib>
 #include <string.h>
+#include <vector>
 
 // Shim functions to replace old SLUMP RNG
+/* SLUMP draws from its own stream, so it neither disturbs nor depends
+   on anything else using random numbers */
+static rng_stream_c slump_rng;
+
+void slump_rng_begin(int level) {
+  slump_rng = twister_Stream("slump").Split((std::uint64_t)level);
+}
+
 int roll(int n) {   
     if (n<1) {
         return 0;
     }
-    return (twister_UInt() % n);
+    return (slump_rng.UInt() % n);
 }
 
 boolean rollpercent(int n) {
@@ -53,6 +63,180 @@ extern int current_level_number;
 extern int global_verbosity;    /* Oooh, a global variable! */
 extern boolean ok_to_roll;  /* Stop breaking -seed...   */
 
+/* A uniform grid over the level, so the geometry queries only  */
+/* have to look at the linedefs, vertexes and things near the   */
+/* spot in question, rather than walking the whole lists.  A    */
+/* linedef is filed under every cell its bounding box touches,  */
+/* a vertex or thing under the cell it is in.  Anything outside */
+/* the grid is filed under the nearest edge cell.               */
+#define GRID_SHIFT (8)          /* 256-unit cells */
+#define GRID_SIZE (256)         /* cells on a side */
+#define GRID_ORIGIN (-32768)
+
+typedef struct s_grid_cell {
+  std::vector<linedef *> linedefs;
+  std::vector<vertex *> vertexes;
+  std::vector<thing *> things;
+} grid_cell;
+
+struct s_level_grid {
+  std::vector<grid_cell> cells;
+  /* The cells which have ever had a linedef in them */
+  int minx, miny, maxx, maxy;
+  int linedef_serial;
+  unsigned int stamp;
+  int max_thing_width;   /* Widest thing (or monster) on the level */
+};
+
+level_grid *new_level_grid(void)
+{
+  level_grid *answer = new level_grid;
+
+  answer->cells.resize(GRID_SIZE*GRID_SIZE);
+  answer->minx = answer->miny = GRID_SIZE;
+  answer->maxx = answer->maxy = -1;
+  answer->linedef_serial = 0;
+  answer->stamp = 0;
+  answer->max_thing_width = 64;   /* MONSTER_WIDTH(), at least */
+  return answer;
+}
+
+/* The grid column or row for the given coordinate */
+int grid_pos(int x)
+{
+  if (x<GRID_ORIGIN) return 0;
+  x = (x - GRID_ORIGIN) >> GRID_SHIFT;
+  if (x>=GRID_SIZE) return GRID_SIZE-1;
+  return x;
+}
+
+grid_cell *grid_cell_at(level *l, int x, int y)
+{
+  return &l->grid->cells[grid_pos(y)*GRID_SIZE + grid_pos(x)];
+}
+
+/* File the linedef under every cell its bounding box touches */
+void grid_link_linedef(level *l, linedef *ld)
+{
+  level_grid *g = l->grid;
+  int x,y;
+
+  ld->grid_minx = grid_pos(std::min(ld->from->x,ld->to->x));
+  ld->grid_miny = grid_pos(std::min(ld->from->y,ld->to->y));
+  ld->grid_maxx = grid_pos(std::max(ld->from->x,ld->to->x));
+  ld->grid_maxy = grid_pos(std::max(ld->from->y,ld->to->y));
+  for (y=ld->grid_miny;y<=ld->grid_maxy;y++)
+    for (x=ld->grid_minx;x<=ld->grid_maxx;x++)
+      g->cells[y*GRID_SIZE + x].linedefs.push_back(ld);
+  if (ld->grid_minx<g->minx) g->minx = ld->grid_minx;
+  if (ld->grid_miny<g->miny) g->miny = ld->grid_miny;
+  if (ld->grid_maxx>g->maxx) g->maxx = ld->grid_maxx;
+  if (ld->grid_maxy>g->maxy) g->maxy = ld->grid_maxy;
+}
+
+/* Take the linedef out of the cells it was filed under.  Doesn't */
+/* look at its vertexes, which may be gone already.               */
+void grid_unlink_linedef(level *l, linedef *ld)
+{
+  int x,y;
+
+  for (y=ld->grid_miny;y<=ld->grid_maxy;y++)
+    for (x=ld->grid_minx;x<=ld->grid_maxx;x++) {
+      std::vector<linedef *> &list = l->grid->cells[y*GRID_SIZE + x].linedefs;
+      auto it = std::find(list.begin(),list.end(),ld);
+      if (it==list.end()) {
+        announce(WARNING,"Linedef missing from its grid cell.");
+        continue;
+      }
+      *it = list.back();
+      list.pop_back();
+    }
+}
+
+/* Refile a linedef whose from or to has been changed */
+void relink_linedef(level *l, linedef *ld)
+{
+  grid_unlink_linedef(l,ld);
+  grid_link_linedef(l,ld);
+}
+
+void grid_unlink_vertex(level *l, vertex *v)
+{
+  std::vector<vertex *> &list = grid_cell_at(l,v->x,v->y)->vertexes;
+  auto it = std::find(list.begin(),list.end(),v);
+  if (it==list.end()) {
+    announce(WARNING,"Vertex missing from its grid cell.");
+    return;
+  }
+  *it = list.back();
+  list.pop_back();
+}
+
+/* Collect the linedefs which start or end at the given vertex, */
+/* in the same order as they are in the level's list.           */
+void grid_vertex_users(level *l, vertex *v, std::vector<linedef *> &answer)
+{
+  answer.clear();
+  /* Any linedef using it is filed under its cell */
+  for (linedef *ld : grid_cell_at(l,v->x,v->y)->linedefs)
+    if ((ld->from==v)||(ld->to==v)) answer.push_back(ld);
+  std::sort(answer.begin(),answer.end(),
+            [](linedef *a, linedef *b) { return a->serial > b->serial; });
+}
+
+/* Move a vertex, refiling it and the linedefs that use it. */
+/* All vertex movement needs to come through here.          */
+void move_vertex(level *l, vertex *v, int x, int y)
+{
+  std::vector<linedef *> users;
+
+  grid_vertex_users(l,v,users);
+  for (linedef *ld : users) grid_unlink_linedef(l,ld);
+  grid_unlink_vertex(l,v);
+  v->x = x;
+  v->y = y;
+  grid_cell_at(l,v->x,v->y)->vertexes.push_back(v);
+  for (linedef *ld : users) grid_link_linedef(l,ld);
+}
+
+/* Collect the linedefs whose bounding boxes may touch the given */
+/* box, each once.  Caller must check the actual geometry.       */
+void grid_find_linedefs(level *l, int minx, int miny, int maxx, int maxy,
+                        std::vector<linedef *> &answer)
+{
+  level_grid *g = l->grid;
+  int x,y;
+  int x1 = std::max(grid_pos(minx),g->minx), x2 = std::min(grid_pos(maxx),g->maxx);
+  int y1 = std::max(grid_pos(miny),g->miny), y2 = std::min(grid_pos(maxy),g->maxy);
+
+  answer.clear();
+  g->stamp++;
+  for (y=y1;y<=y2;y++)
+    for (x=x1;x<=x2;x++)
+      for (linedef *ld : g->cells[y*GRID_SIZE + x].linedefs)
+        if (ld->grid_stamp!=g->stamp) {
+          ld->grid_stamp = g->stamp;
+          answer.push_back(ld);
+        }
+}
+
+/* Collect the vertexes or things filed under the cells the */
+/* given box touches.  Caller must check the actual spots.  */
+template <typename T>
+void grid_find_points(level *l, int minx, int miny, int maxx, int maxy,
+                      std::vector<T *> grid_cell::*member,
+                      std::vector<T *> &answer)
+{
+  int x,y;
+
+  answer.clear();
+  for (y=grid_pos(miny);y<=grid_pos(maxy);y++)
+    for (x=grid_pos(minx);x<=grid_pos(maxx);x++) {
+      std::vector<T *> &list = l->grid->cells[y*GRID_SIZE + x].*member;
+      answer.insert(answer.end(),list.begin(),list.end());
+    }
+}
+
 /* Free up all the allocated structures associated with the */
 /* level, so we can start on a new one without burning too  */
 /* much memory.                                             */
@@ -113,6 +297,8 @@ void FreeLevel(level *l)
     free(gate);
   }
   l->gate_anchor = NULL;
+  delete l->grid;
+  l->grid = NULL;
 }
 
 /* Get the next unused tag for the level */
@@ -153,6 +339,7 @@ void delete_vertex(level *l, vertex *v)
       }
     }
   }
+  grid_unlink_vertex(l,v);
   free(v);  /* oh, that'll help a lot, eh? */
 }
 
@@ -167,6 +354,7 @@ vertex *new_vertex(level *l,int x,int y)
   answer->marked = 0;
   answer->next = l->vertex_anchor;
   l->vertex_anchor = answer;
+  grid_cell_at(l,answer->x,answer->y)->vertexes.push_back(answer);
   return answer;
 }
 
@@ -186,6 +374,7 @@ void delete_linedef(level *l, linedef *ld)
       }
     }
   }
+  grid_unlink_linedef(l,ld);
   free(ld);  /* ooohhh, look, he freed something! */
 }
 
@@ -207,7 +396,10 @@ linedef *new_linedef(level *l,vertex *from,vertex *to)
   answer->group_previous = NULL;
   answer->next = l->linedef_anchor;
   answer->marked = 0;
+  answer->serial = l->grid->linedef_serial++;
+  answer->grid_stamp = 0;
   l->linedef_anchor = answer;
+  grid_link_linedef(l,answer);
   return answer;
 }
 
@@ -291,6 +483,9 @@ thing *new_thing(level *l, int x, int y, short angle, short type,
   answer->options = options;
   answer->next = l->thing_anchor;
   l->thing_anchor = answer;
+  grid_cell_at(l,answer->x,answer->y)->things.push_back(answer);
+  if (answer->pgenus->width>l->grid->max_thing_width)
+    l->grid->max_thing_width = answer->pgenus->width;
   return answer;
 }
 
@@ -829,6 +1024,7 @@ linedef *split_linedef(level *l, linedef *ld, int len, config *c)
   v = new_vertex(l,ld->from->x+dx,ld->from->y+dy);
   answer = new_linedef(l,v,ld->to);
   ld->to = v;
+  relink_linedef(l,ld);
   answer->flags = ld->flags;
   answer->type = ld->type;
   answer->tag = ld->tag;
@@ -1076,7 +1272,7 @@ config *get_config(std::filesystem::path filename) {
     }
     std::string levelsize = ob_get_param("float_minrooms_slump");
     if (StringCaseCmp(levelsize, "Mix It Up") == 0) {
-        answer->minrooms = twister_Between(2, 37);
+        answer->minrooms = slump_rng.Between(2, 37);
     } else {
         answer->minrooms = StringToInt(levelsize);
     }
@@ -2022,11 +2218,12 @@ boolean common_texture(sidedef *sd1, sidedef *sd2)
 void global_align_forward(level *l, linedef *ld)
 {
   vertex *v;
-  linedef *ld2;
+  std::vector<linedef *> users;
   int newoff;
 
   v = ld->to;
-  for (ld2=l->linedef_anchor;ld2;ld2=ld2->next) {
+  grid_vertex_users(l,v,users);
+  for (linedef *ld2 : users) {
     if (ld2->from==v)
       if (common_texture(ld->right,ld2->right)) {
         newoff = ld->right->x_offset + linelen(ld);
@@ -2047,11 +2244,12 @@ void global_align_forward(level *l, linedef *ld)
 void global_align_backward(level *l, linedef *ld)
 {
   vertex *v;
-  linedef *ld2;
+  std::vector<linedef *> users;
   int newoff;
 
   v = ld->from;
-  for (ld2=l->linedef_anchor;ld2;ld2=ld2->next) {
+  grid_vertex_users(l,v,users);
+  for (linedef *ld2 : users) {
     if (ld2->to==v)
       if (common_texture(ld->right,ld2->right)) {
         newoff = ld->right->x_offset - linelen(ld2);
@@ -2277,12 +2475,11 @@ linedef *make_parallel(level *l,linedef *ld,int depth,linedef *old)
   point_from(ld->from->x, ld->from->y, ld->to->x, ld->to->y,
              LEFT_TURN,depth,&x,&y);
   if (old) {
-    old->to->x = x;     /* Assumes no one else is using */
-    old->to->y = y;     /* these vertexes.  OK?         */
+    /* Assumes no one else is using these vertexes.  OK? */
+    move_vertex(l,old->to,x,y);
     x += ld->from->x - ld->to->x;
     y += ld->from->y - ld->to->y;
-    old->from->x = x;
-    old->from->y = y;
+    move_vertex(l,old->from,x,y);
     return old;
   } else {
     v1 = new_vertex(l,x,y);
@@ -2476,9 +2673,9 @@ boolean empty_rectangle(level *l, int x1, int y1, int x2, int y2,
                                   int x3, int y3, int x4, int y4)
 {
   int minx, maxx, miny, maxy;
-  vertex *v;
   sector *s;
-  linedef *ld;
+  std::vector<vertex *> vertexes;
+  std::vector<linedef *> lines;
 
   /* Find the enclosing rectangle of these points */
   if (x1>x2) {
@@ -2515,12 +2712,17 @@ boolean empty_rectangle(level *l, int x1, int y1, int x2, int y2,
 
   /* Look at all unmarked vertexes, see if any */
   /* are within the enclosing rectangle.       */
-  for (v=l->vertex_anchor;v;v=v->next) {
+  grid_find_points(l,minx,miny,maxx,maxy,&grid_cell::vertexes,vertexes);
+  for (vertex *v : vertexes) {
     if (v->marked==0)
       if ( ( (v->x <= maxx) && (v->x >= minx) ) &&
            ( (v->y <= maxy) && (v->y >= miny) ) ) return 0;
   }
 
+  /* Any linedef crossing the sides is in the enclosing rectangle */
+  /* too; find_rec() below reuses minx and friends.               */
+  grid_find_linedefs(l,minx,miny,maxx,maxy,lines);
+
   /* Now look at all sectors, see if any of these four */
   /* proposed vertexes is inside the rectangular envelope */
   for (s=l->sector_anchor;s;s=s->next) {
@@ -2541,7 +2743,7 @@ boolean empty_rectangle(level *l, int x1, int y1, int x2, int y2,
   /* any of the four implied boundary lines.  Doesn't assume */
   /* axis-parallel lines, for a change!  Does assume there are */
   /* only four sides, though.  Need true polygons. */
-  for (ld=l->linedef_anchor;ld;ld=ld->next) {
+  for (linedef *ld : lines) {
     if (ld->to->marked==0)
       if (ld->from->marked==0) {
         if (intersects(x1,y1,x2,y2,ld->from->x,ld->from->y,ld->to->x,ld->to->y))
@@ -2640,10 +2842,17 @@ int point_from_linedef(level *l, int x, int y, linedef *ld)
 /* monster would be stuck? */
 boolean no_monsters_stuck_on(level *l, linedef *ld)
 {
-  thing *m;
   int dist;
-
-  for (m=l->thing_anchor;m;m=m->next) {
+  int reach = l->grid->max_thing_width/2;
+  std::vector<thing *> things;
+
+  /* Nothing further than that from the linedef's box can be stuck */
+  grid_find_points(l,std::min(ld->from->x,ld->to->x)-reach,
+                     std::min(ld->from->y,ld->to->y)-reach,
+                     std::max(ld->from->x,ld->to->x)+reach,
+                     std::max(ld->from->y,ld->to->y)+reach,
+                     &grid_cell::things,things);
+  for (thing *m : things) {
     if (!(m->pgenus->bits&MONSTER)) continue;   /* Only monsters */
     if (m->pgenus->bits&FLIES) continue;   /* Fliers can escape */
     dist = abs(point_from_linedef(l,m->x,m->y,ld));
@@ -2668,36 +2877,71 @@ boolean no_monsters_stuck_on(level *l, linedef *ld)
 sector *point_sector(level *l,int x, int y, int *dist, boolean *danger)
 {
   int thisdist, closest;
-  linedef *ld, *ldbest;
+  linedef *ldbest = NULL;
   sector *answer = NULL;
+  level_grid *g = l->grid;
+  int cx = grid_pos(x), cy = grid_pos(y);
+  int r, i, j, bound;
 
   if (danger!=NULL) *danger = SLUMP_FALSE;
   closest = HUGE_NUMBER;
-  for (ld=l->linedef_anchor;ld;ld=ld->next) {
-    thisdist = point_from_linedef(l,x,y,ld);
-    if (abs(thisdist)<49)
-      if (ld->type!=LINEDEF_NORMAL)
-        if (danger!=NULL)
-          *danger = SLUMP_TRUE;
-    if (abs(thisdist)<closest) {
-      if (thisdist>0) {
-        answer = ld->right->psector;
-        closest = abs(thisdist);
-        ldbest = ld;
-      } else if (ld->left) {
-        /* Actually, if we find that the closest thing is the left side */
-        /* of a one-sided linedef, we should set answer to NULL, and */
-        /* update closest and ldbest.  But, because sometimes the crude */
-        /* point_from_linedef() seriously underestimates distances, we'll */
-        /* actually do nothing in that case, on the theory that some */
-        /* linedef that gives us a non-NULL answer is *really* the */
-        /* closest one.  This is a hack; we should fix point_from_linedef */
-        /* instead. */
-        answer = ld->left->psector;
-        closest = abs(thisdist);
-        ldbest = ld;
+  /* Search outward a ring of grid cells at a time.  A linedef is */
+  /* never nearer (by point_from_linedef()) than its bounding box, */
+  /* so we can stop once the best find is nearer than anything not */
+  /* looked at yet could be, and nothing dangerous can be missed.  */
+  /* Ties go to the newest linedef, the first in the list.         */
+  auto check_cell = [&](int i, int j) {
+    for (linedef *ld : g->cells[j*GRID_SIZE + i].linedefs) {
+      thisdist = point_from_linedef(l,x,y,ld);
+      if (abs(thisdist)<49)
+        if (ld->type!=LINEDEF_NORMAL)
+          if (danger!=NULL)
+            *danger = SLUMP_TRUE;
+      if ((abs(thisdist)<closest) || (ldbest && (abs(thisdist)==closest) &&
+                                      (ld->serial>ldbest->serial))) {
+        if (thisdist>0) {
+          answer = ld->right->psector;
+          closest = abs(thisdist);
+          ldbest = ld;
+        } else if (ld->left) {
+          /* Actually, if we find that the closest thing is the left side */
+          /* of a one-sided linedef, we should set answer to NULL, and */
+          /* update closest and ldbest.  But, because sometimes the crude */
+          /* point_from_linedef() seriously underestimates distances, we'll */
+          /* actually do nothing in that case, on the theory that some */
+          /* linedef that gives us a non-NULL answer is *really* the */
+          /* closest one.  This is a hack; we should fix point_from_linedef */
+          /* instead. */
+          answer = ld->left->psector;
+          closest = abs(thisdist);
+          ldbest = ld;
+        }
       }
     }
+  };
+
+  for (r=0;;r++) {
+    for (j=std::max(cy-r,g->miny);j<=std::min(cy+r,g->maxy);j++) {
+      if ((j==cy-r)||(j==cy+r)) {
+        for (i=std::max(cx-r,g->minx);i<=std::min(cx+r,g->maxx);i++)
+          check_cell(i,j);
+      } else {
+        if ((cx-r>=g->minx)&&(cx-r<=g->maxx)) check_cell(cx-r,j);
+        if ((cx+r>=g->minx)&&(cx+r<=g->maxx)) check_cell(cx+r,j);
+      }
+    }
+    /* How near could a linedef outside these rings be? */
+    bound = HUGE_NUMBER;
+    if (cx-r>g->minx)
+      bound = std::min(bound,x-(((cx-r)<<GRID_SHIFT)+GRID_ORIGIN)+1);
+    if (cx+r<g->maxx)
+      bound = std::min(bound,(((cx+r+1)<<GRID_SHIFT)+GRID_ORIGIN)-x);
+    if (cy-r>g->miny)
+      bound = std::min(bound,y-(((cy-r)<<GRID_SHIFT)+GRID_ORIGIN)+1);
+    if (cy+r<g->maxy)
+      bound = std::min(bound,(((cy+r+1)<<GRID_SHIFT)+GRID_ORIGIN)-y);
+    if (bound==HUGE_NUMBER) break;        /* Seen them all */
+    if ((bound>=49)&&(closest<bound)) break;
   }
 
   if (dist!=NULL) *dist = closest;
@@ -3622,6 +3866,8 @@ boolean make_decroom(level *l,linedef *ldf1,linedef *ldf2,config *c)
     lt1->right->psector = ldf2->right->psector;
     lt1->right->y_offset = ldf2->right->y_offset;
     ldf2->to = lt1->from;
+    relink_linedef(l,ldf1);
+    relink_linedef(l,ldf2);
   }
 
   place_plants(l,48,newsec,c);    /* Put in some plants for decor */
@@ -5466,10 +5712,9 @@ short death_room(level *l,linedef *ld,style *ThisStyle,config *c)
   ldnew = make_linkto(l,ld,gatelink,ThisStyle,c,NULL);
   if (ldnew==NULL) return 0;
   for (;linelen(ldnew)<320;) {
-    ldnew->to->x = ldnew->from->x + 2 *
-      (ldnew->to->x - ldnew->from->x);
-    ldnew->to->y = ldnew->from->y + 2 *
-      (ldnew->to->y - ldnew->from->y);
+    move_vertex(l,ldnew->to,
+      ldnew->from->x + 2 * (ldnew->to->x - ldnew->from->x),
+      ldnew->from->y + 2 * (ldnew->to->y - ldnew->from->y));
   }
   newsector = generate_room_outline(l,ldnew,ThisStyle,SLUMP_FALSE,c);
   newsector->pstyle = ThisStyle;
@@ -6328,10 +6573,8 @@ linedef *make_linkto(level *l,linedef *ld,link *ThisLink, style *ThisStyle,
     }
     if (newsize< 256 * l->hugeness) newsize = 256 * l->hugeness;
     if (old) {
-      old->from->x = minx;
-      old->to->x = minx;
-      old->from->y = newsize/2;
-      old->to->y = 0-newsize/2;
+      move_vertex(l,old->from,minx,newsize/2);
+      move_vertex(l,old->to,minx,0-newsize/2);
       ldnew = old;
     } else {
       v = new_vertex(l,minx,newsize/2);
@@ -6886,20 +7129,20 @@ void make_lightstrip(level *l, linedef *ld,style *ThisStyle,int ll,int depth,
   /* avoid colliding with orthogonal doors and stuff, if we're */
   /* not gonna do a full area check.  Use rather silly shortening */
   if (ldnew->to->x>ldnew->from->x) {
-    ldnew->to->x-=2;
-    ldnew->from->x+=2;
+    move_vertex(l,ldnew->to,ldnew->to->x-2,ldnew->to->y);
+    move_vertex(l,ldnew->from,ldnew->from->x+2,ldnew->from->y);
   }
   if (ldnew->to->x<ldnew->from->x) {
-    ldnew->to->x+=2;
-    ldnew->from->x-=2;
+    move_vertex(l,ldnew->to,ldnew->to->x+2,ldnew->to->y);
+    move_vertex(l,ldnew->from,ldnew->from->x-2,ldnew->from->y);
   }
   if (ldnew->to->y>ldnew->from->y) {
-    ldnew->to->y-=2;
-    ldnew->from->y+=2;
+    move_vertex(l,ldnew->to,ldnew->to->x,ldnew->to->y-2);
+    move_vertex(l,ldnew->from,ldnew->from->x,ldnew->from->y+2);
   }
   if (ldnew->to->y<ldnew->from->y) {
-    ldnew->to->y+=2;
-    ldnew->from->y-=2;
+    move_vertex(l,ldnew->to,ldnew->to->x,ldnew->to->y+2);
+    move_vertex(l,ldnew->from,ldnew->from->x,ldnew->from->y-2);
   }
   ldnew->right->middle_texture = ThisStyle->walllight;
   /* Sometimes use bottom of lights. */
@@ -6964,14 +7207,12 @@ void swell_linedef(level *l,linedef *ld,style *ThisStyle,config *c,
   if (sno==3) point_from(ldnew1->from->x,ldnew1->from->y,
                          ldnew1->to->x,ldnew1->to->y,
                          LEFT_TURN,sdepth,&newx2,&newy2);
-  ld->to->x = newx1;
-  ld->to->y = newy1;
+  move_vertex(l,ld->to,newx1,newy1);
   sprintf(logstring,"Swol to (%d,%d)-(%d,%d)...\n",ld->from->x,ld->from->y,
     ld->to->x,ld->to->y);
   announce(VERBOSE,logstring);
   if (sno==3) {
-    ldnew1->to->x = newx2;
-    ldnew1->to->y = newy2;
+    move_vertex(l,ldnew1->to,newx2,newy2);
     sprintf(logstring,"    and (%d,%d)-(%d,%d)...\n",ldnew1->from->x,ldnew1->from->y,
       ldnew1->to->x,ldnew1->to->y);
     announce(VERBOSE,logstring);
@@ -6992,14 +7233,21 @@ boolean coalignable(texture *t1, texture *t2)
 /* width?                                                        */
 boolean room_at(level *l,genus *g,int x,int y,int width,config *c)
 {
-  thing *t;
+  int reach = width;
+  std::vector<thing *> things;
+
+  /* Only things nearer than the widest test below matter */
+  if (!(g->bits&PICKABLE))
+    reach = std::max({reach,(int)g->width,l->grid->max_thing_width});
+  grid_find_points(l,x-reach,y-reach,x+reach,y+reach,
+                   &grid_cell::things,things);
 
   /* Check for requested length */
-  for (t=l->thing_anchor;t;t=t->next)
+  for (thing *t : things)
     if (infinity_norm(t->x,t->y,x,y)<width) return SLUMP_FALSE;
   /* If it's not pickable, make sure not stuck-together */
   if (!(g->bits&PICKABLE))
-    for (t=l->thing_anchor;t;t=t->next) {
+    for (thing *t : things) {
       if (t->pgenus->bits&PICKABLE) continue;
       /* This is overly conservative; the real check should */
       /* be against g->width/2 + t->pgenus->width/2, eh?     */
@@ -12230,6 +12478,7 @@ void empty_level(level *l, config *c)
    l->link_anchor = NULL;
    l->arena_anchor = NULL;
    l->gate_anchor = NULL;
+   l->grid = new_level_grid();
    l->used_red = SLUMP_FALSE;
    l->used_blue = SLUMP_FALSE;
    l->used_yellow = SLUMP_FALSE;
@@ -476,6 +476,10 @@ struct s_linedef {
   boolean b_misaligned;
   struct s_linedef *group_next;         /* Used during texture-alignment */
   struct s_linedef *group_previous;     /* A group gets aligned together */
+  int serial;          /* Creation order; the list runs newest-first */
+  short grid_minx, grid_miny;     /* The grid cells it's filed under */
+  short grid_maxx, grid_maxy;
+  unsigned int grid_stamp;        /* Last grid query that looked at it */
   struct s_linedef *next;
 };   /* linedef and plinedef defined above; gcc chokes if we do it again! */
 
@@ -666,6 +670,9 @@ typedef struct s_arena {
   struct s_arena *next;
 } arena, *parena;
 
+/* A uniform grid over the level; see slump.cc */
+typedef struct s_level_grid level_grid;
+
 typedef struct s_level {
   thing *thing_anchor;
   sector *sector_anchor;
@@ -728,6 +735,8 @@ typedef struct s_level {
   link *link_anchor;
   gate *gate_anchor;
   arena *arena_anchor;
+  /* Index of the linedefs, vertexes and things by position */
+  level_grid *grid;
 } level, *plevel;
 
 /* The config is the static architectural knowledge and stuff. */
@@ -810,6 +819,8 @@ config *get_config(std::filesystem::path filename);
 void NewLevel(level *l, haa *init_haa, config *c);
 void DumpLevel(dumphandle dh,config *c,level *l,int episode,int mission,int map);
 void FreeLevel(level *l);
+void move_vertex(level *l, vertex *v, int x, int y);
+void relink_linedef(level *l, linedef *ld);
 dumphandle OpenDump(config *c);
 void CloseDump(dumphandle dh);
 quest *starting_quest(level *l,config *c);
@@ -818,6 +829,7 @@ style *random_style(level *l,config *c);
 boolean enough_quest(level *l,sector *s,quest *ThisQuest,config *c);
 boolean rollpercent(int n);
 int roll(int n);
+void slump_rng_begin(int level);
 linedef *starting_linedef(level *l,style *ThisStyle,config *c);
 int mark_adequate_linedefs(level *l,sector *s,style *ThisStyle,config *c);
 int mark_decent_boundary_linedefs(level *l,sector *s,int minlen);
@@ -73,6 +73,9 @@ void machioize(config *c,float amount) {
 		  "based on SLIGE by Dave Chess, dmchess@aol.com\n\n",
            SOURCE_VERSION,SOURCE_SERIAL,SOURCE_PATCHLEVEL);
 
+  /* the config gets stream zero, level N gets stream N */
+  slump_rng_begin(0);
+
   ThisConfig = get_config(filename);
   if (ThisConfig==NULL) {
     Usage();
@@ -102,6 +105,7 @@ void machioize(config *c,float amount) {
     /* Each level starts with a new ThisHaa */
     free(ThisHaa);
     ThisHaa = starting_haa();
+    slump_rng_begin(i+1);
     hardwired_nonswitch_nontheme_config(ThisConfig);
     macho_amount = 1 - ((float)(ThisConfig->map) * .008);
     macho_amount -= ((float)(ThisConfig->mission) * .025);
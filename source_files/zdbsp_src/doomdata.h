@@ -6,13 +6,16 @@
 #endif
 
 #include "tarray.h"
+#include "udmfmap.h"
 #include "zdbsp.h"
 
 enum { BOXTOP, BOXBOTTOM, BOXLEFT, BOXRIGHT };
 
 struct UDMFKey {
     const char *key;
+    // the unprocessed value, or NULL when it is written from prop
     const char *value;
+    const FUDMFProp *prop;
 };
 
 struct MapVertex {
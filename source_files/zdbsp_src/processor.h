@@ -117,13 +117,26 @@ class FProcessor {
     void ParseMapProperties();
     void ParseTextMap(int lump);
 
-    void WriteProps(FWadWriter &out, TArray<UDMFKey> &props);
-    void WriteIntProp(FWadWriter &out, const char *key, int value);
-    void WriteThingUDMF(FWadWriter &out, IntThing *th, int num);
-    void WriteLinedefUDMF(FWadWriter &out, IntLineDef *ld, int num);
-    void WriteSidedefUDMF(FWadWriter &out, IntSideDef *sd, int num);
-    void WriteSectorUDMF(FWadWriter &out, IntSector *sec, int num);
-    void WriteVertexUDMF(FWadWriter &out, IntVertex *vt, int num);
+    void CopyThing(IntThing *th, const FUDMFMap &map, const FUDMFBlock &block);
+    void CopyLinedef(IntLineDef *ld, const FUDMFMap &map,
+                     const FUDMFBlock &block);
+    void CopySidedef(IntSideDef *sd, const FUDMFMap &map,
+                     const FUDMFBlock &block);
+    void CopySector(IntSector *sec, const FUDMFMap &map,
+                    const FUDMFBlock &block);
+    void CopyVertex(WideVertex *vt, IntVertex *vtp, const FUDMFMap &map,
+                    const FUDMFBlock &block);
+    void CopyMapProperties(const FUDMFMap &map);
+    void CopyUDMFMap(const FUDMFMap &map);
+
+    void WriteProps(std::string &out, TArray<UDMFKey> &props);
+    void WriteIntProp(std::string &out, const char *key, int value);
+    void WriteBlockStart(std::string &out, const char *name, int num);
+    void WriteThingUDMF(std::string &out, IntThing *th, int num);
+    void WriteLinedefUDMF(std::string &out, IntLineDef *ld, int num);
+    void WriteSidedefUDMF(std::string &out, IntSideDef *sd, int num);
+    void WriteSectorUDMF(std::string &out, IntSector *sec, int num);
+    void WriteVertexUDMF(std::string &out, IntVertex *vt, int num);
     void WriteTextMap(FWadWriter &out);
     void WriteUDMF(FWadWriter &out);
 
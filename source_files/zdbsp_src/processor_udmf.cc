@@ -144,7 +144,7 @@ void FProcessor::ParseThing(IntThing *th) {
         }
 
         // now store the key in its unprocessed form
-        UDMFKey k = {key, value};
+        UDMFKey k = {key, value, NULL};
         th->props.Push(k);
     }
 }
@@ -183,7 +183,7 @@ void FProcessor::ParseLinedef(IntLineDef *ld) {
         }
 
         // now store the key in its unprocessed form
-        UDMFKey k = {key, value};
+        UDMFKey k = {key, value, NULL};
         ld->props.Push(k);
     }
 }
@@ -207,7 +207,7 @@ void FProcessor::ParseSidedef(IntSideDef *sd) {
         }
 
         // now store the key in its unprocessed form
-        UDMFKey k = {key, value};
+        UDMFKey k = {key, value, NULL};
         sd->props.Push(k);
     }
 }
@@ -228,7 +228,7 @@ void FProcessor::ParseSector(IntSector *sec) {
         // so everything can go directly to the props array.
 
         // now store the key in its unprocessed form
-        UDMFKey k = {key, value};
+        UDMFKey k = {key, value, NULL};
         sec->props.Push(k);
     }
 }
@@ -253,7 +253,7 @@ void FProcessor::ParseVertex(WideVertex *vt, IntVertex *vtp) {
         }
 
         // now store the key in its unprocessed form
-        UDMFKey k = {key, value};
+        UDMFKey k = {key, value, NULL};
         vtp->props.Push(k);
     }
 }
@@ -278,7 +278,7 @@ void FProcessor::ParseMapProperties() {
         }
 
         // now store the key in its unprocessed form
-        UDMFKey k = {key, value};
+        UDMFKey k = {key, value, NULL};
         Level.props.Push(k);
     }
 }
@@ -327,13 +327,272 @@ void FProcessor::ParseTextMap(int lump) {
     delete[] buffer;
 }
 
+//===========================================================================
+//
+// Typed property values, for maps which were never turned into text.
+// Keys which are stored keep a pointer to their property, except for
+// strings which are already held in their TEXTMAP form.
+//
+//===========================================================================
+
+static UDMFKey TypedKey(const FUDMFMap &map, const FUDMFProp &prop) {
+    if (prop.type == UDMF_String) {
+        UDMFKey k = {prop.key, map.StringValue(prop), NULL};
+        return k;
+    }
+    UDMFKey k = {prop.key, NULL, &prop};
+    return k;
+}
+
+static int PropInt(const FUDMFProp &prop) {
+    if (prop.type != UDMF_Int) {
+        throw std::runtime_error(
+            std::string("Integer value expected for key '") + prop.key + "'");
+    }
+    return prop.ival;
+}
+
+static fixed_t PropFixed(const FUDMFProp &prop) {
+    double val;
+
+    if (prop.type == UDMF_Float) {
+        val = prop.fval;
+    } else if (prop.type == UDMF_Int) {
+        val = prop.ival;
+    } else {
+        throw std::runtime_error(
+            std::string("Floating point value expected for key '") +
+            prop.key + "'");
+    }
+
+    if (val < -32768 || val > 32767) {
+        char buffer[200];
+        snprintf(buffer, sizeof(buffer),
+                 "Fixed point value is out of range for key '%s'\n\t%.2f "
+                 "should be within [-32768,32767]",
+                 prop.key, val);
+        throw std::runtime_error(buffer);
+    }
+    return xs_Fix<16>::ToFix(val);
+}
+
+//===========================================================================
+//
+// Copy a thing block
+//
+//===========================================================================
+
+void FProcessor::CopyThing(IntThing *th, const FUDMFMap &map,
+                           const FUDMFBlock &block) {
+    th->props.Grow(block.count);
+
+    for (unsigned i = 0; i < block.count; i++) {
+        const FUDMFProp &prop = map.Props[block.first + i];
+        const char *key = prop.key;
+
+        if (!strcasecmp(key, "x")) {
+            th->x = PropFixed(prop);
+        } else if (!strcasecmp(key, "y")) {
+            th->y = PropFixed(prop);
+        } else if (!strcasecmp(key, "angle")) {
+            th->angle = (short)PropInt(prop);
+        } else if (!strcasecmp(key, "type")) {
+            th->type = (short)PropInt(prop);
+        }
+
+        th->props.Push(TypedKey(map, prop));
+    }
+}
+
+//===========================================================================
+//
+// Copy a linedef block
+//
+//===========================================================================
+
+void FProcessor::CopyLinedef(IntLineDef *ld, const FUDMFMap &map,
+                             const FUDMFBlock &block) {
+    ld->v1 = ld->v2 = ld->sidenum[0] = ld->sidenum[1] = NO_INDEX;
+    ld->special = 0;
+    ld->props.Grow(block.count);
+
+    for (unsigned i = 0; i < block.count; i++) {
+        const FUDMFProp &prop = map.Props[block.first + i];
+        const char *key = prop.key;
+
+        if (!strcasecmp(key, "v1")) {
+            ld->v1 = PropInt(prop);
+            continue;  // do not store in props
+        } else if (!strcasecmp(key, "v2")) {
+            ld->v2 = PropInt(prop);
+            continue;  // do not store in props
+        } else if (!strcasecmp(key, "sidefront")) {
+            ld->sidenum[0] = PropInt(prop);
+            continue;  // do not store in props
+        } else if (!strcasecmp(key, "sideback")) {
+            ld->sidenum[1] = PropInt(prop);
+            continue;  // do not store in props
+        } else if (Extended && !strcasecmp(key, "special")) {
+            ld->special = PropInt(prop);
+        } else if (Extended && !strcasecmp(key, "arg0")) {
+            ld->args[0] = PropInt(prop);
+        }
+
+        ld->props.Push(TypedKey(map, prop));
+    }
+}
+
+//===========================================================================
+//
+// Copy a sidedef block
+//
+//===========================================================================
+
+void FProcessor::CopySidedef(IntSideDef *sd, const FUDMFMap &map,
+                             const FUDMFBlock &block) {
+    sd->sector = NO_INDEX;
+    sd->props.Grow(block.count);
+
+    for (unsigned i = 0; i < block.count; i++) {
+        const FUDMFProp &prop = map.Props[block.first + i];
+
+        if (!strcasecmp(prop.key, "sector")) {
+            sd->sector = PropInt(prop);
+            continue;  // do not store in props
+        }
+
+        sd->props.Push(TypedKey(map, prop));
+    }
+}
+
+//===========================================================================
+//
+// Copy a sector block
+//
+//===========================================================================
+
+void FProcessor::CopySector(IntSector *sec, const FUDMFMap &map,
+                            const FUDMFBlock &block) {
+    sec->props.Grow(block.count);
+
+    for (unsigned i = 0; i < block.count; i++) {
+        sec->props.Push(TypedKey(map, map.Props[block.first + i]));
+    }
+}
+
+//===========================================================================
+//
+// Copy a vertex block
+//
+//===========================================================================
+
+void FProcessor::CopyVertex(WideVertex *vt, IntVertex *vtp,
+                            const FUDMFMap &map, const FUDMFBlock &block) {
+    vt->x = vt->y = 0;
+    vtp->props.Grow(block.count);
+
+    for (unsigned i = 0; i < block.count; i++) {
+        const FUDMFProp &prop = map.Props[block.first + i];
+
+        if (!strcasecmp(prop.key, "x")) {
+            vt->x = PropFixed(prop);
+        } else if (!strcasecmp(prop.key, "y")) {
+            vt->y = PropFixed(prop);
+        }
+
+        vtp->props.Push(TypedKey(map, prop));
+    }
+}
+
+//===========================================================================
+//
+// Copy the global map properties
+//
+//===========================================================================
+
+void FProcessor::CopyMapProperties(const FUDMFMap &map) {
+    for (const FUDMFProp &prop : map.Globals) {
+        UDMFKey k = TypedKey(map, prop);
+
+        if (!strcasecmp(k.key, "namespace") && k.value != NULL) {
+            // all unknown namespaces are assumed to be standard.
+            Extended = !strcasecmp(k.value, "\"ZDoom\"") ||
+                       !strcasecmp(k.value, "\"Hexen\"") ||
+                       !strcasecmp(k.value, "\"Vavoom\"");
+        }
+
+        Level.props.Push(k);
+    }
+}
+
+//===========================================================================
+//
+// Takes a map which is already in memory, this does the same job as
+// ParseTextMap() without any text being involved.
+//
+//===========================================================================
+
+void FProcessor::CopyUDMFMap(const FUDMFMap &map) {
+    CopyMapProperties(map);
+
+    int numverts = map.NumBlocks(UDMF_Vertex);
+
+    unsigned thing = Level.Things.Reserve(map.NumBlocks(UDMF_Thing));
+    unsigned line = Level.Lines.Reserve(map.NumBlocks(UDMF_Linedef));
+    unsigned side = Level.Sides.Reserve(map.NumBlocks(UDMF_Sidedef));
+    unsigned sec = Level.Sectors.Reserve(map.NumBlocks(UDMF_Sector));
+    unsigned vert = Level.VertexProps.Reserve(numverts);
+
+    Level.Vertices = new WideVertex[numverts];
+    Level.NumVertices = numverts;
+
+    for (const FUDMFBlock &block : map.Blocks) {
+        switch (block.kind) {
+            case UDMF_Thing:
+                CopyThing(&Level.Things[thing++], map, block);
+                break;
+
+            case UDMF_Linedef:
+                CopyLinedef(&Level.Lines[line++], map, block);
+                break;
+
+            case UDMF_Sidedef:
+                CopySidedef(&Level.Sides[side++], map, block);
+                break;
+
+            case UDMF_Sector:
+                CopySector(&Level.Sectors[sec++], map, block);
+                break;
+
+            case UDMF_Vertex: {
+                WideVertex *vt = &Level.Vertices[vert];
+                vt->index = vert + 1;
+                CopyVertex(vt, &Level.VertexProps[vert], map, block);
+                vert++;
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+}
+
 //===========================================================================
 //
 // parse an UDMF map
 //
 //===========================================================================
 
-void FProcessor::LoadUDMF() { ParseTextMap(Lump + 1); }
+void FProcessor::LoadUDMF() {
+    const FUDMFMap *map = Wad.LumpUDMF(Lump + 1);
+
+    if (map != NULL) {
+        CopyUDMFMap(*map);
+    } else {
+        ParseTextMap(Lump + 1);
+    }
+}
 
 //===========================================================================
 //
@@ -341,12 +600,16 @@ void FProcessor::LoadUDMF() { ParseTextMap(Lump + 1); }
 //
 //===========================================================================
 
-void FProcessor::WriteProps(FWadWriter &out, TArray<UDMFKey> &props) {
+void FProcessor::WriteProps(std::string &out, TArray<UDMFKey> &props) {
     for (unsigned i = 0; i < props.Size(); i++) {
-        out.AddToLump(props[i].key, (int)strlen(props[i].key));
-        out.AddToLump(" = ", 3);
-        out.AddToLump(props[i].value, (int)strlen(props[i].value));
-        out.AddToLump(";\n", 2);
+        out.append(props[i].key);
+        out.append(" = ");
+        if (props[i].value != NULL) {
+            out.append(props[i].value);
+        } else {
+            UDMF_AppendNumber(out, *props[i].prop);
+        }
+        out.append(";\n");
     }
 }
 
@@ -356,31 +619,39 @@ void FProcessor::WriteProps(FWadWriter &out, TArray<UDMFKey> &props) {
 //
 //===========================================================================
 
-void FProcessor::WriteIntProp(FWadWriter &out, const char *key, int value) {
-    char buffer[20];
-
-    out.AddToLump(key, (int)strlen(key));
-    out.AddToLump(" = ", 3);
-    sprintf(buffer, "%d;\n", value);
-    out.AddToLump(buffer, (int)strlen(buffer));
+void FProcessor::WriteIntProp(std::string &out, const char *key, int value) {
+    out.append(key);
+    out.append(" = ");
+    UDMF_AppendInt(out, value);
+    out.append(";\n");
 }
 
 //===========================================================================
 //
-// writes a UDMF thing
+// writes the start of a block, with the block number as a comment
 //
 //===========================================================================
 
-void FProcessor::WriteThingUDMF(FWadWriter &out, IntThing *th, int num) {
-    out.AddToLump("thing", 5);
+void FProcessor::WriteBlockStart(std::string &out, const char *name,
+                                 int num) {
+    out.append(name);
     if (WriteComments) {
-        char buffer[32];
-        int len = sprintf(buffer, " // %d", num);
-        out.AddToLump(buffer, len);
+        out.append(" // ");
+        UDMF_AppendInt(out, num);
     }
-    out.AddToLump("\n{\n", 3);
+    out.append("\n{\n");
+}
+
+//===========================================================================
+//
+// writes a UDMF thing
+//
+//===========================================================================
+
+void FProcessor::WriteThingUDMF(std::string &out, IntThing *th, int num) {
+    WriteBlockStart(out, "thing", num);
     WriteProps(out, th->props);
-    out.AddToLump("}\n\n", 3);
+    out.append("}\n\n");
 }
 
 //===========================================================================
@@ -389,14 +660,8 @@ void FProcessor::WriteThingUDMF(FWadWriter &out, IntThing *th, int num) {
 //
 //===========================================================================
 
-void FProcessor::WriteLinedefUDMF(FWadWriter &out, IntLineDef *ld, int num) {
-    out.AddToLump("linedef", 7);
-    if (WriteComments) {
-        char buffer[32];
-        int len = sprintf(buffer, " // %d", num);
-        out.AddToLump(buffer, len);
-    }
-    out.AddToLump("\n{\n", 3);
+void FProcessor::WriteLinedefUDMF(std::string &out, IntLineDef *ld, int num) {
+    WriteBlockStart(out, "linedef", num);
     WriteIntProp(out, "v1", ld->v1);
     WriteIntProp(out, "v2", ld->v2);
     if (ld->sidenum[0] != NO_INDEX)
@@ -404,7 +669,7 @@ void FProcessor::WriteLinedefUDMF(FWadWriter &out, IntLineDef *ld, int num) {
     if (ld->sidenum[1] != NO_INDEX)
         WriteIntProp(out, "sideback", ld->sidenum[1]);
     WriteProps(out, ld->props);
-    out.AddToLump("}\n\n", 3);
+    out.append("}\n\n");
 }
 
 //===========================================================================
@@ -413,17 +678,11 @@ void FProcessor::WriteLinedefUDMF(FWadWriter &out, IntLineDef *ld, int num) {
 //
 //===========================================================================
 
-void FProcessor::WriteSidedefUDMF(FWadWriter &out, IntSideDef *sd, int num) {
-    out.AddToLump("sidedef", 7);
-    if (WriteComments) {
-        char buffer[32];
-        int len = sprintf(buffer, " // %d", num);
-        out.AddToLump(buffer, len);
-    }
-    out.AddToLump("\n{\n", 3);
+void FProcessor::WriteSidedefUDMF(std::string &out, IntSideDef *sd, int num) {
+    WriteBlockStart(out, "sidedef", num);
     WriteIntProp(out, "sector", sd->sector);
     WriteProps(out, sd->props);
-    out.AddToLump("}\n\n", 3);
+    out.append("}\n\n");
 }
 
 //===========================================================================
@@ -432,16 +691,10 @@ void FProcessor::WriteSidedefUDMF(FWadWriter &out, IntSideDef *sd, int num) {
 //
 //===========================================================================
 
-void FProcessor::WriteSectorUDMF(FWadWriter &out, IntSector *sec, int num) {
-    out.AddToLump("sector", 6);
-    if (WriteComments) {
-        char buffer[32];
-        int len = sprintf(buffer, " // %d", num);
-        out.AddToLump(buffer, len);
-    }
-    out.AddToLump("\n{\n", 3);
+void FProcessor::WriteSectorUDMF(std::string &out, IntSector *sec, int num) {
+    WriteBlockStart(out, "sector", num);
     WriteProps(out, sec->props);
-    out.AddToLump("}\n\n", 3);
+    out.append("}\n\n");
 }
 
 //===========================================================================
@@ -450,29 +703,29 @@ void FProcessor::WriteSectorUDMF(FWadWriter &out, IntSector *sec, int num) {
 //
 //===========================================================================
 
-void FProcessor::WriteVertexUDMF(FWadWriter &out, IntVertex *vt, int num) {
-    out.AddToLump("vertex", 6);
-    if (WriteComments) {
-        char buffer[32];
-        int len = sprintf(buffer, " // %d", num);
-        out.AddToLump(buffer, len);
-    }
-    out.AddToLump("\n{\n", 3);
+void FProcessor::WriteVertexUDMF(std::string &out, IntVertex *vt, int num) {
+    WriteBlockStart(out, "vertex", num);
     WriteProps(out, vt->props);
-    out.AddToLump("}\n\n", 3);
+    out.append("}\n\n");
 }
 
 //===========================================================================
 //
 // writes a UDMF text map
 //
+// The text is collected in memory and added to the lump in one go.
+//
 //===========================================================================
 
 void FProcessor::WriteTextMap(FWadWriter &out) {
-    out.StartWritingLump("TEXTMAP");
-    WriteProps(out, Level.props);
+    std::string text;
+
+    // a rough guess, lines and sides make up most of the map
+    text.reserve((Level.NumLines() + Level.NumSides()) * 128);
+
+    WriteProps(text, Level.props);
     for (int i = 0; i < Level.NumThings(); i++) {
-        WriteThingUDMF(out, &Level.Things[i], i);
+        WriteThingUDMF(text, &Level.Things[i], i);
     }
 
     for (int i = 0; i < Level.NumOrgVerts; i++) {
@@ -481,20 +734,23 @@ void FProcessor::WriteTextMap(FWadWriter &out) {
             // not valid!
             throw std::runtime_error("Invalid vertex data.");
         }
-        WriteVertexUDMF(out, &Level.VertexProps[vt->index - 1], i);
+        WriteVertexUDMF(text, &Level.VertexProps[vt->index - 1], i);
     }
 
     for (int i = 0; i < Level.NumLines(); i++) {
-        WriteLinedefUDMF(out, &Level.Lines[i], i);
+        WriteLinedefUDMF(text, &Level.Lines[i], i);
     }
 
     for (int i = 0; i < Level.NumSides(); i++) {
-        WriteSidedefUDMF(out, &Level.Sides[i], i);
+        WriteSidedefUDMF(text, &Level.Sides[i], i);
     }
 
     for (int i = 0; i < Level.NumSectors(); i++) {
-        WriteSectorUDMF(out, &Level.Sectors[i], i);
+        WriteSectorUDMF(text, &Level.Sectors[i], i);
     }
+
+    out.StartWritingLump("TEXTMAP");
+    out.AddToLump(text.data(), (int)text.size());
 }
 
 //===========================================================================
@@ -123,8 +123,7 @@ void FRejectBuilder::LoadPortals() {
     portalbytes = ((numportals + 63) & ~63) >> 3;
     portallongs = portalbytes / sizeof(long);
 
-    portals = new VPortal[numportals];
-    memset(portals, 0, numportals * sizeof(VPortal));
+    portals = new VPortal[numportals]();
 
     leafs = new FLeaf[portalclusters];
 
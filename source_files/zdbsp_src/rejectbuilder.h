@@ -1,5 +1,8 @@
 // A slight adaptation of Quake's vis utility.
 
+#include <atomic>
+#include <mutex>
+
 #include "doomdata.h"
 #include "tarray.h"
 #include "zdbsp.h"
@@ -67,7 +70,7 @@ class FRejectBuilder {
         int leaf;    // neighbor
 
         FWinding winding;
-        VStatus status;
+        std::atomic<VStatus> status;  // read by other threads during flow
         BYTE *portalfront;  // [portals], preliminary
         BYTE *portalflood;  // [portals], intermediate
         BYTE *portalvis;    // [portals], final
@@ -105,6 +108,8 @@ class FRejectBuilder {
 #endif
     };
 
+    // per-thread state, allocated once per thread and reused for every
+    // portal that thread processes.
     struct FThreadData {
         VPortal *base;
         int c_chains;
@@ -117,10 +122,11 @@ class FRejectBuilder {
     VPortal *portals;
     FLeaf *leafs;
 
-    int c_portaltest, c_portalpass, c_portalcheck;
-    int c_portalskip, c_leafskip;
-    int c_vistest, c_mighttest;
-    int c_chains;
+    // statistics, bumped from every reject thread
+    std::atomic<int> c_portaltest{0}, c_portalpass{0}, c_portalcheck{0};
+    std::atomic<int> c_portalskip{0}, c_leafskip{0};
+    std::atomic<int> c_vistest{0}, c_mighttest{0};
+    std::atomic<int> c_chains{0};
 
     int testlevel;
 
@@ -136,12 +142,13 @@ class FRejectBuilder {
 
     void LeafFlow(int leafnum);
 
-    void BasePortalVis(int portalnum);
-    void BetterPortalVis(int portalnum);
-    void PortalFlow(int portalnum);
-    void PassagePortalFlow(int portalnum);
-    void CreatePassages(int portalnum);
-    void PassageFlow(int portalnum);
+    void BasePortalVis(int portalnum, FThreadData *thread);
+    void BetterPortalVis(int portalnum, FThreadData *thread);
+    void PortalFlow(int portalnum, FThreadData *thread);
+    void PassagePortalFlow(int portalnum, FThreadData *thread);
+    void CreatePassages(int portalnum, FThreadData *thread);
+    void PassageFlow(int portalnum, FThreadData *thread);
+    void BeginThreadFlow(VPortal *p, FThreadData *thread);
 
     VPortal *sorted_portals[MAX_PORTALS];
 
@@ -162,12 +169,14 @@ class FRejectBuilder {
 
     bool pacifier;
     int workcount;
-    int dispatch;
+    std::atomic<int> dispatch;
     int oldf;
     int oldcount;
+    std::mutex pacifier_mutex;
 
-    void RunThreadsOnIndividual(int workcnt, bool showpacifire,
-                                void (FRejectBuilder::*func)(int));
+    void RunThreadsOnIndividual(int workcnt, bool showpacifier,
+                                void (FRejectBuilder::*func)(int,
+                                                             FThreadData *));
     int GetThreadWork();
 
     void CheckStack(FLeaf *leaf, FThreadData *thread);
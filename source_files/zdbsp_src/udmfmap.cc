@@ -0,0 +1,173 @@
+/*
+    Holds UDMF maps as typed values and writes them as TEXTMAP source.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+
+#include "udmfmap.h"
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+
+#include <charconv>
+
+static const char *const BlockNames[NUM_UDMF_BLOCKS] = {
+    "thing", "vertex", "linedef", "sidedef", "sector"};
+
+FUDMFMap::FUDMFMap() {
+    for (int i = 0; i < NUM_UDMF_BLOCKS; i++) {
+        Counts[i] = 0;
+    }
+}
+
+void FUDMFMap::BeginBlock(EUDMFBlock kind) {
+    FUDMFBlock block;
+
+    block.kind = kind;
+    block.first = (unsigned int)Props.size();
+    block.count = 0;
+
+    Blocks.push_back(block);
+    Counts[kind] += 1;
+}
+
+void FUDMFMap::Add(const FUDMFProp &prop) {
+    if (Blocks.empty()) {
+        Globals.push_back(prop);
+        return;
+    }
+
+    Props.push_back(prop);
+    Blocks.back().count += 1;
+}
+
+void FUDMFMap::AddInt(const char *key, int value) {
+    Add({key, UDMF_Int, value, 0});
+}
+
+void FUDMFMap::AddFloat(const char *key, double value) {
+    Add({key, UDMF_Float, 0, value});
+}
+
+void FUDMFMap::AddBool(const char *key, bool value) {
+    Add({key, UDMF_Bool, value ? 1 : 0, 0});
+}
+
+void FUDMFMap::AddString(const char *key, std::string_view value) {
+    int offset = (int)Strings.size();
+
+    Strings.push_back('"');
+    Strings.append(value);
+    Strings.push_back('"');
+    Strings.push_back(0);
+
+    Add({key, UDMF_String, offset, 0});
+}
+
+int FUDMFMap::NumBlocks(EUDMFBlock kind) const { return Counts[kind]; }
+
+const char *FUDMFMap::StringValue(const FUDMFProp &prop) const {
+    return Strings.c_str() + prop.ival;
+}
+
+void FUDMFMap::AppendValue(std::string &out, const FUDMFProp &prop) const {
+    if (prop.type == UDMF_String) {
+        out.append(StringValue(prop));
+    } else {
+        UDMF_AppendNumber(out, prop);
+    }
+}
+
+//
+// The layout matches what Obsidian has always written: global keys are
+// followed by a blank line, block keys are indented with a tab.
+//
+void FUDMFMap::WriteText(std::string &out) const {
+    // about 16 bytes per key is typical
+    out.reserve(out.size() + (Globals.size() + Props.size()) * 16 +
+                Blocks.size() * 16);
+
+    for (const FUDMFProp &prop : Globals) {
+        out.append(prop.key);
+        out.append(" = ");
+        AppendValue(out, prop);
+        out.append(";\n\n");
+    }
+
+    for (const FUDMFBlock &block : Blocks) {
+        out.push_back('\n');
+        out.append(BlockNames[block.kind]);
+        out.append("\n{\n");
+
+        for (unsigned int i = 0; i < block.count; i++) {
+            const FUDMFProp &prop = Props[block.first + i];
+
+            out.push_back('\t');
+            out.append(prop.key);
+            out.append(" = ");
+            AppendValue(out, prop);
+            out.append(";\n");
+        }
+
+        out.append("}\n");
+    }
+}
+
+void UDMF_AppendInt(std::string &out, int value) {
+    char buffer[16];
+
+    char *end = std::to_chars(buffer, buffer + sizeof(buffer), value).ptr;
+
+    out.append(buffer, end - buffer);
+}
+
+void UDMF_AppendFloat(std::string &out, double value) {
+    // map coordinates are nearly always whole numbers, and "%f" always
+    // gives six decimal places.  Negative zero keeps its sign with "%f",
+    // so it goes the slow way.
+    if (value >= INT_MIN && value <= INT_MAX && value == (int)value &&
+        !(value == 0 && signbit(value))) {
+        UDMF_AppendInt(out, (int)value);
+        out.append(".000000");
+        return;
+    }
+
+    char buffer[512];
+
+    int len = snprintf(buffer, sizeof(buffer), "%f", value);
+
+    out.append(buffer, len);
+}
+
+void UDMF_AppendNumber(std::string &out, const FUDMFProp &prop) {
+    switch (prop.type) {
+        case UDMF_Int:
+            UDMF_AppendInt(out, prop.ival);
+            break;
+
+        case UDMF_Float:
+            UDMF_AppendFloat(out, prop.fval);
+            break;
+
+        case UDMF_Bool:
+            out.append(prop.ival ? "true" : "false");
+            break;
+
+        default:
+            break;
+    }
+}
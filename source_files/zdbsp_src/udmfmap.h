@@ -0,0 +1,92 @@
+#ifndef __UDMFMAP_H__
+#define __UDMFMAP_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A UDMF map which is kept as typed values instead of TEXTMAP source.
+// This lets a map be handed to the node builder without being written
+// out as text and then parsed again, the text is only produced once
+// when the final TEXTMAP is written.
+
+enum EUDMFBlock : unsigned char {
+    UDMF_Thing,
+    UDMF_Vertex,
+    UDMF_Linedef,
+    UDMF_Sidedef,
+    UDMF_Sector,
+
+    NUM_UDMF_BLOCKS
+};
+
+enum EUDMFType : unsigned char { UDMF_Int, UDMF_Float, UDMF_Bool, UDMF_String };
+
+struct FUDMFProp {
+    // keys are not copied, they must outlive the map (normally they
+    // are string literals)
+    const char *key;
+    EUDMFType type;
+
+    // the int or bool value, for strings the offset into Strings
+    int ival;
+    double fval;
+};
+
+struct FUDMFBlock {
+    EUDMFBlock kind;
+
+    // range of the block's properties in FUDMFMap::Props
+    unsigned int first;
+    unsigned int count;
+};
+
+class FUDMFMap {
+   public:
+    FUDMFMap();
+
+    // starts a new thing, linedef (etc) block.  Any properties added
+    // before the first block are global map properties.
+    void BeginBlock(EUDMFBlock kind);
+
+    void AddInt(const char *key, int value);
+    void AddFloat(const char *key, double value);
+    void AddBool(const char *key, bool value);
+    void AddString(const char *key, std::string_view value);
+
+    int NumBlocks(EUDMFBlock kind) const;
+
+    // the value of a UDMF_String property, including the quotes
+    const char *StringValue(const FUDMFProp &prop) const;
+
+    // appends the value as it would appear in a TEXTMAP
+    void AppendValue(std::string &out, const FUDMFProp &prop) const;
+
+    // appends the whole map as TEXTMAP source
+    void WriteText(std::string &out) const;
+
+    std::vector<FUDMFProp> Globals;
+    std::vector<FUDMFProp> Props;
+    std::vector<FUDMFBlock> Blocks;
+
+   private:
+    void Add(const FUDMFProp &prop);
+
+    // string values, each one quoted and NUL terminated
+    std::string Strings;
+
+    int Counts[NUM_UDMF_BLOCKS];
+};
+
+// fast replacements for the "%d" and "%f" formats
+void UDMF_AppendInt(std::string &out, int value);
+void UDMF_AppendFloat(std::string &out, double value);
+
+// appends an int, float or bool value (not a string)
+void UDMF_AppendNumber(std::string &out, const FUDMFProp &prop);
+
+#endif  //__UDMFMAP_H__
@@ -3,7 +3,11 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <algorithm>
 #include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
 
 #include "nodebuild.h"
 #include "rejectbuilder.h"
@@ -23,19 +27,20 @@ GetThreadWork
 =============
 */
 int FRejectBuilder::GetThreadWork() {
-    int r;
-    int f;
+    int r = dispatch.fetch_add(1);
 
-    if (dispatch == workcount) {
+    if (r >= workcount) {
         return -1;
     }
 
     if (pacifier) {
-        if (dispatch >= workcount - 1) {
+        std::lock_guard<std::mutex> lock(pacifier_mutex);
+
+        if (r >= workcount - 1) {
             fprintf(stderr, "100%%\n");
-        } else if (oldcount < 0 || dispatch - oldcount > 200) {
-            oldcount = dispatch;
-            f = 100 * dispatch / workcount;
+        } else if (oldcount < 0 || r - oldcount > 200) {
+            oldcount = r;
+            int f = 100 * r / workcount;
             if (f != oldf) {
                 oldf = f;
                 fprintf(stderr, "% 3d%%\b\b\b\b", f);
@@ -43,22 +48,54 @@ int FRejectBuilder::GetThreadWork() {
         }
     }
 
-    r = dispatch++;
-
     return r;
 }
-void FRejectBuilder::RunThreadsOnIndividual(int workcnt, bool showpacifier,
-                                            void (FRejectBuilder::*func)(int)) {
-    int work;
 
+/*
+=============
+RunThreadsOnIndividual
+
+Calls func for every work item, handing the items out to NumThreads
+threads (the calling thread being one of them).  Each thread owns a
+FThreadData which is reused for every portal it processes.
+=============
+*/
+void FRejectBuilder::RunThreadsOnIndividual(int workcnt, bool showpacifier,
+                                            void (FRejectBuilder::*func)(
+                                                int, FThreadData *)) {
     pacifier = showpacifier;
     workcount = workcnt;
     dispatch = 0;
     oldf = -1;
     oldcount = -1;
 
-    while (-1 != (work = GetThreadWork())) {
-        (this->*func)(work);
+    int numthreads = NumThreads;
+    if (numthreads <= 0) {
+        numthreads = (int)std::thread::hardware_concurrency();
+    }
+    numthreads = std::max(1, std::min(numthreads, workcnt));
+
+    std::vector<std::unique_ptr<FThreadData>> threaddata;
+    for (int i = 0; i < numthreads; i++) {
+        threaddata.emplace_back(new FThreadData());
+    }
+
+    auto worker = [this, func](FThreadData *thread) {
+        int work;
+        while (-1 != (work = GetThreadWork())) {
+            (this->*func)(work, thread);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < numthreads; i++) {
+        threads.emplace_back(worker, threaddata[i].get());
+    }
+
+    worker(threaddata[0].get());
+
+    for (std::thread &t : threads) {
+        t.join();
     }
 }
 
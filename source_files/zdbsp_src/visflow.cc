@@ -42,11 +42,11 @@ int FRejectBuilder::CountBits(BYTE *bits, int numbits) {
     return c;
 }
 
-int c_fullskip;
-int c_portalskip, c_leafskip;
-int c_vistest, c_mighttest;
+std::atomic<int> c_fullskip;
+std::atomic<int> c_portalskip, c_leafskip;
+std::atomic<int> c_vistest, c_mighttest;
 
-int c_chop, c_nochop;
+std::atomic<int> c_chop, c_nochop;
 
 int active;
 
@@ -428,6 +428,34 @@ void FRejectBuilder::RecursiveLeafFlow(int leafnum, FThreadData *thread,
     }
 }
 
+/*
+===============
+BeginThreadFlow
+
+resets a thread's stack head to start flowing from the given portal
+===============
+*/
+void FRejectBuilder::BeginThreadFlow(VPortal *p, FThreadData *thread) {
+    thread->base = p;
+    thread->c_chains = 0;
+
+    PStack &head = thread->pstack_head;
+
+    head.next = NULL;
+    head.leaf = NULL;
+    head.portal = p;
+    head.source = &p->winding;
+    head.pass = NULL;
+    head.portalline = p->line;
+    head.depth = 0;
+    for (int i = 0; i < 3; i++) {
+        head.freewindings[i] = false;
+    }
+    for (int i = 0; i < portallongs; i++) {
+        ((long *)head.mightsee)[i] = ((long *)p->portalflood)[i];
+    }
+}
+
 /*
 ===============
 PortalFlow
@@ -435,9 +463,7 @@ PortalFlow
 generates the portalvis bit vector
 ===============
 */
-void FRejectBuilder::PortalFlow(int portalnum) {
-    FThreadData data;
-    int i;
+void FRejectBuilder::PortalFlow(int portalnum, FThreadData *thread) {
     VPortal *p;
     int c_might, c_can;
 
@@ -461,25 +487,15 @@ void FRejectBuilder::PortalFlow(int portalnum) {
 
     c_might = p->nummightsee;  // CountBits (p->portalflood, numportals);
 
-    memset(&data, 0, sizeof(data));
-    data.base = p;
-
-    data.pstack_head.portal = p;
-    data.pstack_head.source = &p->winding;
-    data.pstack_head.portalline = p->line;
-    data.pstack_head.depth = 0;
-    for (i = 0; i < portallongs; i++) {
-        ((long *)data.pstack_head.mightsee)[i] = ((long *)p->portalflood)[i];
-    }
-
-    RecursiveLeafFlow(p->leaf, &data, &data.pstack_head);
+    BeginThreadFlow(p, thread);
+    RecursiveLeafFlow(p->leaf, thread, &thread->pstack_head);
 
     p->status = STAT_Done;
 
     c_can = CountBits(p->portalvis, numportals);
 
     // printf ("portal:%4i  mightsee:%4i  cansee:%4i (%i chains)\n",
-    //	(int)(p - portals),	c_might, c_can, data.c_chains);
+    //	(int)(p - portals),	c_might, c_can, thread->c_chains);
 }
 
 /*
@@ -561,9 +577,7 @@ void FRejectBuilder::RecursivePassageFlow(VPortal *portal, FThreadData *thread,
 PassageFlow
 ===============
 */
-void FRejectBuilder::PassageFlow(int portalnum) {
-    FThreadData data;
-    int i;
+void FRejectBuilder::PassageFlow(int portalnum, FThreadData *thread) {
     VPortal *p;
     //	int				c_might, c_can;
 
@@ -582,18 +596,8 @@ void FRejectBuilder::PassageFlow(int portalnum) {
 
     //	c_might = CountBits (p->portalflood, numportals);
 
-    memset(&data, 0, sizeof(data));
-    data.base = p;
-
-    data.pstack_head.portal = p;
-    data.pstack_head.source = &p->winding;
-    data.pstack_head.portalline = p->line;
-    data.pstack_head.depth = 0;
-    for (i = 0; i < portallongs; i++) {
-        ((long *)data.pstack_head.mightsee)[i] = ((long *)p->portalflood)[i];
-    }
-
-    RecursivePassageFlow(p, &data, &data.pstack_head);
+    BeginThreadFlow(p, thread);
+    RecursivePassageFlow(p, thread, &thread->pstack_head);
 
     p->status = STAT_Done;
 
@@ -601,7 +605,7 @@ void FRejectBuilder::PassageFlow(int portalnum) {
     c_can = CountBits (p->portalvis, numportals);
 
     qprintf ("portal:%4i  mightsee:%4i  cansee:%4i (%i chains)\n",
-            (int)(p - portals),	c_might, c_can, data.c_chains);
+            (int)(p - portals),	c_might, c_can, thread->c_chains);
     */
 }
 
@@ -754,9 +758,7 @@ void FRejectBuilder::RecursivePassagePortalFlow(VPortal *portal,
 PassagePortalFlow
 ===============
 */
-void FRejectBuilder::PassagePortalFlow(int portalnum) {
-    FThreadData data;
-    int i;
+void FRejectBuilder::PassagePortalFlow(int portalnum, FThreadData *thread) {
     VPortal *p;
     //	int				c_might, c_can;
 
@@ -775,18 +777,8 @@ void FRejectBuilder::PassagePortalFlow(int portalnum) {
 
     //	c_might = CountBits (p->portalflood, numportals);
 
-    memset(&data, 0, sizeof(data));
-    data.base = p;
-
-    data.pstack_head.portal = p;
-    data.pstack_head.source = &p->winding;
-    data.pstack_head.portalline = p->line;
-    data.pstack_head.depth = 0;
-    for (i = 0; i < portallongs; i++) {
-        ((long *)data.pstack_head.mightsee)[i] = ((long *)p->portalflood)[i];
-    }
-
-    RecursivePassagePortalFlow(p, &data, &data.pstack_head);
+    BeginThreadFlow(p, thread);
+    RecursivePassagePortalFlow(p, thread, &thread->pstack_head);
 
     p->status = STAT_Done;
 
@@ -794,7 +786,7 @@ void FRejectBuilder::PassagePortalFlow(int portalnum) {
     c_can = CountBits (p->portalvis, numportals);
 
     qprintf ("portal:%4i  mightsee:%4i  cansee:%4i (%i chains)\n",
-            (int)(p - portals),	c_might, c_can, data.c_chains);
+            (int)(p - portals),	c_might, c_can, thread->c_chains);
     */
 }
 
@@ -943,7 +935,7 @@ leads to every passage has a cansee bit string with all the portals that can be
          seen through the passage
 ===============
 */
-void FRejectBuilder::CreatePassages(int portalnum) {
+void FRejectBuilder::CreatePassages(int portalnum, FThreadData *thread) {
     int i, j, k, numseperators, numsee;
     VPortal *portal, *p, *target;
     FLeaf *leaf;
@@ -1082,7 +1074,7 @@ all seperating planes, and both portals must be behind the new portal
 ===============================================================================
 */
 
-int c_flood, c_vis;
+std::atomic<int> c_flood, c_vis;
 
 /*
 ==================
@@ -1115,7 +1107,7 @@ void FRejectBuilder::SimpleFlood(VPortal *srcportal, int leafnum) {
 BasePortalVis
 ==============
 */
-void FRejectBuilder::BasePortalVis(int portalnum) {
+void FRejectBuilder::BasePortalVis(int portalnum, FThreadData *thread) {
     int j, p1, p2;
     VPortal *tp, *p;
 
@@ -1225,7 +1217,7 @@ void FRejectBuilder::RecursiveLeafBitFlow(int leafnum, BYTE *mightsee,
 BetterPortalVis
 ==============
 */
-void FRejectBuilder::BetterPortalVis(int portalnum) {
+void FRejectBuilder::BetterPortalVis(int portalnum, FThreadData *thread) {
     VPortal *p;
 
     p = portals + portalnum;
@@ -42,6 +42,7 @@ extern int AAPreference;
 extern bool CheckPolyobjs;
 extern bool ShowMap;
 extern bool CompressNodes, CompressGLNodes, ForceCompression, V5GLNodes;
+extern int NumThreads;  // for the reject builder, <= 0 means all cores
 
 #define FIXED_MAX INT_MAX
 #define FIXED_MIN INT_MIN
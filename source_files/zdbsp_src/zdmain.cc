@@ -58,6 +58,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <filesystem>
+#include <functional>
 
 #include "processor.h"
 #include "zdwad.h"
@@ -80,6 +81,10 @@
 // PRIVATE FUNCTION PROTOTYPES ---------------------------------------------
 
 static void ShowVersion();
+static void SetupOptions(std::string current_engine, bool UDMF_mode,
+                         bool build_reject);
+static void ProcessWad(FWadReader &inwad, FWadWriter &outwad);
+static int RunProtected(const std::function<void()> &func);
 
 // PUBLIC DATA DEFINITIONS -------------------------------------------------
 
@@ -104,113 +109,23 @@ bool CompressGLNodes = true;
 bool ForceCompression = false;
 bool GLOnly = false;
 bool V5GLNodes = false;
+int NumThreads = 0;
 
 // CODE --------------------------------------------------------------------
 
 int zdmain(std::filesystem::path filename, std::string current_engine, bool UDMF_mode, bool build_reject) {
-
-    if (StringCaseCmp(current_engine, "vanilla") == 0 || StringCaseCmp(current_engine, "nolimit") == 0 ||
-            StringCaseCmp(current_engine, "boom") == 0) {
-            BuildGLNodes = false;
-            GLOnly = false;
-            if (build_reject) {
-                RejectMode = ERM_Rebuild_NoGL;
-            } else {
-                RejectMode = ERM_CreateZeroes;
-            }
-            CheckPolyobjs = false;
-            CompressNodes = false;
-            CompressGLNodes = false;
-            ForceCompression = false;
-        } else if (StringCaseCmp(current_engine, "prboom") == 0) {
-            BuildGLNodes = false;
-            GLOnly = false;
-            if (build_reject) {
-                RejectMode = ERM_Rebuild_NoGL;
-            } else {
-                RejectMode = ERM_CreateZeroes;
-            }
-            CheckPolyobjs = false;
-            CompressNodes = true;
-            CompressGLNodes = false;
-            ForceCompression = false;
-        } else if (StringCaseCmp(current_engine, "eternity") == 0) {
-            if (UDMF_mode) {
-                BuildGLNodes = true;
-                GLOnly = true;
-            } else {
-                BuildGLNodes = false;
-                GLOnly = false;
-            }
-            RejectMode = ERM_DontTouch;  // Eternity might not play well
-                                                // with ZDBSP's reject builder
-            CheckPolyobjs = true;
-            CompressNodes = true;
-            CompressGLNodes = false;
-            ForceCompression = false;
-        } else if (StringCaseCmp(current_engine, "edge") == 0) {
-            BuildGLNodes = true;
-            GLOnly = true;
-            if (!build_reject || UDMF_mode) {
-                RejectMode = ERM_DontTouch;
-            } else {
-                RejectMode = ERM_Rebuild;
-            }
-            CheckPolyobjs = true;
-            CompressNodes = true;
-            CompressGLNodes = false;
-            ForceCompression = false;
-        } else { // ZDoom is the only choice left, so customize for it
-            BuildGLNodes = true;
-            GLOnly = true;
-            if (!build_reject || UDMF_mode) {
-                RejectMode = ERM_DontTouch;
-            } else {
-                RejectMode = ERM_Rebuild;
-            }
-            CheckPolyobjs = true;
-            CompressNodes = true;
-            CompressGLNodes = true;
-            ForceCompression = true;
-        }
+    SetupOptions(current_engine, UDMF_mode, build_reject);
 
     ShowVersion();
 
-    try {
+    return RunProtected([&]() {
         START_COUNTER(t1a, t1b, t1c)
 
         if (std::filesystem::exists(OutName)) { std::filesystem::remove(OutName); }
         FWadReader inwad(filename);
         FWadWriter outwad(OutName, inwad.IsIWAD());
 
-        int lump = 0;
-        int max = inwad.NumLumps();
-
-        while (lump < max) {
-            if (inwad.IsMap(lump) &&
-                (!Map || strcasecmp(inwad.LumpName(lump), Map) == 0)) {
-                START_COUNTER(t2a, t2b, t2c)
-                FProcessor builder(inwad, lump);
-                builder.Write(outwad);
-                END_COUNTER(t2a, t2b, t2c, "   %.3f seconds.\n")
-
-                lump = inwad.LumpAfterMap(lump);
-            } else if (inwad.IsGLNodes(lump)) {
-                // Ignore GL nodes from the input for any maps we process.
-                if (BuildNodes &&
-                    (Map == NULL ||
-                     strcasecmp(inwad.LumpName(lump) + 3, Map) == 0)) {
-                    lump = inwad.SkipGLNodes(lump);
-                } else {
-                    outwad.CopyLump(inwad, lump);
-                    ++lump;
-                }
-            } else {
-                // printf ("copy %s\n", inwad.LumpName (lump));
-                outwad.CopyLump(inwad, lump);
-                ++lump;
-            }
-        }
+        ProcessWad(inwad, outwad);
 
         outwad.Close();
         inwad.Close();
@@ -218,7 +133,159 @@ int zdmain(std::filesystem::path filename, std::string current_engine, bool UDMF
         std::filesystem::rename(OutName, filename);
 
         END_COUNTER(t1a, t1b, t1c, "\nTotal time: %.3f seconds.\n");
+    });
+}
+
+int zdmain(const std::vector<FMemoryLump> &lumps, const FLumpOutput &output,
+           std::string current_engine, bool UDMF_mode, bool build_reject) {
+    SetupOptions(current_engine, UDMF_mode, build_reject);
+
+    ShowVersion();
+
+    return RunProtected([&]() {
+        START_COUNTER(t1a, t1b, t1c)
+
+        FWadReader inwad(lumps);
+        FWadWriter outwad(inwad.IsIWAD());
+
+        ProcessWad(inwad, outwad);
+
+        outwad.Close();
+        inwad.Close();
+
+        for (int i = 0; i < outwad.NumLumps(); ++i) {
+            output(outwad.GetLump(i));
+        }
+
+        END_COUNTER(t1a, t1b, t1c, "\nTotal time: %.3f seconds.\n");
+    });
+}
+
+//==========================================================================
+//
+// SetupOptions
+//
+//==========================================================================
+
+static void SetupOptions(std::string current_engine, bool UDMF_mode,
+                         bool build_reject) {
+    if (StringCaseCmp(current_engine, "vanilla") == 0 ||
+        StringCaseCmp(current_engine, "nolimit") == 0 ||
+        StringCaseCmp(current_engine, "boom") == 0) {
+        BuildGLNodes = false;
+        GLOnly = false;
+        if (build_reject) {
+            RejectMode = ERM_Rebuild_NoGL;
+        } else {
+            RejectMode = ERM_CreateZeroes;
+        }
+        CheckPolyobjs = false;
+        CompressNodes = false;
+        CompressGLNodes = false;
+        ForceCompression = false;
+    } else if (StringCaseCmp(current_engine, "prboom") == 0) {
+        BuildGLNodes = false;
+        GLOnly = false;
+        if (build_reject) {
+            RejectMode = ERM_Rebuild_NoGL;
+        } else {
+            RejectMode = ERM_CreateZeroes;
+        }
+        CheckPolyobjs = false;
+        CompressNodes = true;
+        CompressGLNodes = false;
+        ForceCompression = false;
+    } else if (StringCaseCmp(current_engine, "eternity") == 0) {
+        if (UDMF_mode) {
+            BuildGLNodes = true;
+            GLOnly = true;
+        } else {
+            BuildGLNodes = false;
+            GLOnly = false;
+        }
+        RejectMode = ERM_DontTouch;  // Eternity might not play well
+                                     // with ZDBSP's reject builder
+        CheckPolyobjs = true;
+        CompressNodes = true;
+        CompressGLNodes = false;
+        ForceCompression = false;
+    } else if (StringCaseCmp(current_engine, "edge") == 0) {
+        BuildGLNodes = true;
+        GLOnly = true;
+        if (!build_reject || UDMF_mode) {
+            RejectMode = ERM_DontTouch;
+        } else {
+            RejectMode = ERM_Rebuild;
+        }
+        CheckPolyobjs = true;
+        CompressNodes = true;
+        CompressGLNodes = false;
+        ForceCompression = false;
+    } else { // ZDoom is the only choice left, so customize for it
+        BuildGLNodes = true;
+        GLOnly = true;
+        if (!build_reject || UDMF_mode) {
+            RejectMode = ERM_DontTouch;
+        } else {
+            RejectMode = ERM_Rebuild;
+        }
+        CheckPolyobjs = true;
+        CompressNodes = true;
+        CompressGLNodes = true;
+        ForceCompression = true;
+    }
+}
+
+//==========================================================================
+//
+// ProcessWad
+//
+// Builds the nodes for every map in inwad, copying the other lumps.
+//
+//==========================================================================
+
+static void ProcessWad(FWadReader &inwad, FWadWriter &outwad) {
+    int lump = 0;
+    int max = inwad.NumLumps();
+
+    while (lump < max) {
+        if (inwad.IsMap(lump) &&
+            (!Map || strcasecmp(inwad.LumpName(lump), Map) == 0)) {
+            START_COUNTER(t2a, t2b, t2c)
+            FProcessor builder(inwad, lump);
+            builder.Write(outwad);
+            END_COUNTER(t2a, t2b, t2c, "   %.3f seconds.\n")
+
+            lump = inwad.LumpAfterMap(lump);
+        } else if (inwad.IsGLNodes(lump)) {
+            // Ignore GL nodes from the input for any maps we process.
+            if (BuildNodes &&
+                (Map == NULL ||
+                 strcasecmp(inwad.LumpName(lump) + 3, Map) == 0)) {
+                lump = inwad.SkipGLNodes(lump);
+            } else {
+                outwad.CopyLump(inwad, lump);
+                ++lump;
+            }
+        } else {
+            // printf ("copy %s\n", inwad.LumpName (lump));
+            outwad.CopyLump(inwad, lump);
+            ++lump;
+        }
+    }
+}
+
+//==========================================================================
+//
+// RunProtected
+//
+// Runs func, turning any exception into an error code.
+//
+//==========================================================================
 
+static int RunProtected(const std::function<void()> &func) {
+    try {
+        func();
     } catch (std::runtime_error &msg) {
         printf("%s\n", msg.what());
         return 20;
@@ -1,2 +1,33 @@
+#ifndef __ZDMAIN_H__
+#define __ZDMAIN_H__
+
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "udmfmap.h"
+
+// a lump of a wad which is held in memory rather than in a file
+struct FMemoryLump {
+    std::string Name;
+    const void *Data;
+    int Size;
+
+    // when set, a TEXTMAP lump is taken from here instead of Data
+    const FUDMFMap *UDMF = nullptr;
+};
+
+typedef std::function<void(const FMemoryLump &lump)> FLumpOutput;
 
 int zdmain(std::filesystem::path filename, std::string current_engine, bool UDMF_mode, bool build_reject);
+
+// builds the nodes for every map in the given lumps, without going
+// through a temporary file.  The resulting lumps are passed to output
+// in wad order, their data is only valid during that call.
+int zdmain(const std::vector<FMemoryLump> &lumps, const FLumpOutput &output,
+           std::string current_engine, bool UDMF_mode, bool build_reject);
+
+extern int NumThreads;  // for the reject builder, <= 0 means all cores
+
+#endif  // __ZDMAIN_H__
@@ -41,7 +41,8 @@ static const bool MapLumpRequired[12] = {
 static const char GLLumpNames[5][9] = {"GL_VERT", "GL_SEGS", "GL_SSECT",
                                        "GL_NODES", "GL_PVS"};
 
-FWadReader::FWadReader(std::filesystem::path filename) : Lumps(NULL) {
+FWadReader::FWadReader(std::filesystem::path filename)
+    : Lumps(NULL), Memory(NULL) {
     File.open(filename, std::ios::binary);
     
     if (!File.is_open()) {
@@ -81,6 +82,21 @@ FWadReader::FWadReader(std::filesystem::path filename) : Lumps(NULL) {
     }
 }
 
+FWadReader::FWadReader(const std::vector<FMemoryLump> &lumps)
+    : Lumps(NULL), Memory(lumps.data()) {
+    memcpy(Header.Magic, "PWAD", 4);
+    Header.NumLumps = (int32_t)lumps.size();
+    Header.Directory = 0;
+
+    Lumps = new WadLump[Header.NumLumps];
+
+    for (int i = 0; i < Header.NumLumps; ++i) {
+        Lumps[i].FilePos = 0;
+        Lumps[i].Size = lumps[i].Size;
+        strncpy(Lumps[i].Name, lumps[i].Name.c_str(), 8);
+    }
+}
+
 void FWadReader::Close() {
 	if (File.is_open()) File.close();
 	if (Lumps) delete[] Lumps;
@@ -118,7 +134,7 @@ int FWadReader::FindMapLump(const char *name, int map) const {
         return -1;
     }
 
-    for (j = k = 0; j < 12; ++j) {
+    for (j = k = 0; j < 12 && map + k < Header.NumLumps; ++j) {
         if (strncasecmp(Lumps[map + k].Name, MapLumpNames[j], 8) == 0) {
             if (i == j) {
                 return map + k;
@@ -132,6 +148,10 @@ int FWadReader::FindMapLump(const char *name, int map) const {
 bool FWadReader::isUDMF(int index) const {
     index++;
 
+    if (index >= Header.NumLumps) {
+        return false;
+    }
+
     if (strncasecmp(Lumps[index].Name, "TEXTMAP", 8) == 0) {
         // UDMF map
         return true;
@@ -139,6 +159,13 @@ bool FWadReader::isUDMF(int index) const {
     return false;
 }
 
+const FUDMFMap *FWadReader::LumpUDMF(int index) const {
+    if (Memory == NULL || (unsigned)index >= (unsigned)Header.NumLumps) {
+        return NULL;
+    }
+    return Memory[index].UDMF;
+}
+
 bool FWadReader::IsMap(int index) const {
     int i, j;
 
@@ -147,7 +174,8 @@ bool FWadReader::IsMap(int index) const {
     index++;
 
     for (i = j = 0; i < 12; ++i) {
-        if (strncasecmp(Lumps[index + j].Name, MapLumpNames[i], 8) != 0) {
+        if (index + j >= Header.NumLumps ||
+            strncasecmp(Lumps[index + j].Name, MapLumpNames[i], 8) != 0) {
             if (MapLumpRequired[i]) {
                 return false;
             }
@@ -233,8 +261,8 @@ int FWadReader::LumpAfterMap(int i) const {
     if (isUDMF(i)) {
         // UDMF map
         i += 2;
-        while (strncasecmp(Lumps[i].Name, "ENDMAP", 8) != 0 &&
-               i < Header.NumLumps) {
+        while (i < Header.NumLumps &&
+               strncasecmp(Lumps[i].Name, "ENDMAP", 8) != 0) {
             i++;
         }
         return i + 1;  // one lump after ENDMAP
@@ -242,7 +270,8 @@ int FWadReader::LumpAfterMap(int i) const {
 
     i++;
     for (j = k = 0; j < 12; ++j) {
-        if (strncasecmp(Lumps[i + k].Name, MapLumpNames[j], 8) != 0) {
+        if (i + k >= Header.NumLumps ||
+            strncasecmp(Lumps[i + k].Name, MapLumpNames[j], 8) != 0) {
             if (MapLumpRequired[j]) {
                 break;
             }
@@ -260,66 +289,73 @@ const char *FWadReader::LumpName(int lump) {
     return name;
 }
 
-FWadWriter::FWadWriter(std::filesystem::path filename, bool iwad) {
-
+FWadWriter::FWadWriter(std::filesystem::path filename, bool iwad)
+    : IWAD(iwad) {
     File.open(filename, std::ios::binary);
     if (!File.is_open()) {
         throw std::runtime_error("Could not open output file");
     }
+}
 
-    WadHeader head;
+FWadWriter::FWadWriter(bool iwad) : IWAD(iwad) {}
 
-    if (iwad) {
-        head.Magic[0] = 'I';
-    } else {
-        head.Magic[0] = 'P';
-    }
-    head.Magic[1] = 'W';
-    head.Magic[2] = 'A';
-    head.Magic[3] = 'D';
+FWadWriter::~FWadWriter() {}
+
+void FWadWriter::Close() {
+    if (File.is_open()) {
+        WadHeader head;
 
-    File.write(reinterpret_cast<char *>(&head), sizeof(head));
-    File << std::flush;
+        memcpy(head.Magic, IWAD ? "IWAD" : "PWAD", 4);
+        head.NumLumps = LittleLong(Lumps.Size());
+        head.Directory = LittleLong(int32_t(sizeof(head) + Data.size()));
 
-}
+        File.write(reinterpret_cast<char *>(&head), sizeof(head));
+        File.write(reinterpret_cast<char *>(Data.data()), Data.size());
 
-FWadWriter::~FWadWriter() { }
+        for (unsigned int i = 0; i < Lumps.Size(); ++i) {
+            WadLump lump = Lumps[i];
 
-void FWadWriter::Close() {
-    if (File.is_open()) {
-        int32_t head[2];
+            lump.FilePos = LittleLong(lump.FilePos);
+            lump.Size = LittleLong(lump.Size);
 
-        head[0] = LittleLong(Lumps.Size());
-        head[1] = LittleLong(File.tellp());
+            File.write(reinterpret_cast<char *>(&lump), sizeof(lump));
+        }
 
-        File.write(reinterpret_cast<char *>(&Lumps[0]), sizeof(WadLump) * Lumps.Size());
-        File << std::flush;
-        File.seekp(4);
-        File.write(reinterpret_cast<char *>(head), 8);
-        File << std::flush;
         File.close();
     }
 }
 
+int FWadWriter::NumLumps() const { return Lumps.Size(); }
+
+FMemoryLump FWadWriter::GetLump(int index) const {
+    const WadLump &lump = Lumps[index];
+
+    FMemoryLump result;
+
+    result.Name.assign(lump.Name, strnlen(lump.Name, 8));
+    result.Data = Data.data() + (lump.FilePos - sizeof(WadHeader));
+    result.Size = lump.Size;
+
+    return result;
+}
+
+void FWadWriter::Append(const void *data, int len) {
+    const BYTE *bytes = reinterpret_cast<const BYTE *>(data);
+    Data.insert(Data.end(), bytes, bytes + len);
+}
+
 void FWadWriter::CreateLabel(const char *name) {
     WadLump lump;
 
     strncpy(lump.Name, name, 8);
-    lump.FilePos = LittleLong(File.tellp());
+    lump.FilePos = int32_t(sizeof(WadHeader) + Data.size());
     lump.Size = 0;
     Lumps.Push(lump);
 }
 
 void FWadWriter::WriteLump(const char *name, const void *data, int len) {
-    WadLump lump;
-
-    strncpy(lump.Name, name, 8);
-    lump.FilePos = LittleLong(File.tellp());
-    lump.Size = LittleLong(len);
-    Lumps.Push(lump);
-
-    File.write(reinterpret_cast<const char *>(data), len);
-    File << std::flush;
+    CreateLabel(name);
+    AddToLump(data, len);
 }
 
 void FWadWriter::CopyLump(FWadReader &wad, int lump) {
@@ -336,8 +372,7 @@ void FWadWriter::CopyLump(FWadReader &wad, int lump) {
 void FWadWriter::StartWritingLump(const char *name) { CreateLabel(name); }
 
 void FWadWriter::AddToLump(const void *data, int len) {
-    File.write(reinterpret_cast<const char *>(data), len);
-    File << std::flush;
+    Append(data, len);
     Lumps[Lumps.Size() - 1].Size += len;
 }
 
@@ -9,9 +9,11 @@
 #include <string.h>
 #include <filesystem>
 #include <fstream>
+#include <vector>
 
 #include "tarray.h"
 #include "zdbsp.h"
+#include "zdmain.h"
 #include "lib_util.h"
 
 struct WadHeader {
@@ -29,10 +31,14 @@ struct WadLump {
 class FWadReader {
    public:
     FWadReader(std::filesystem::path filename);
+    // reads lumps from memory, they must stay valid until Close()
+    FWadReader(const std::vector<FMemoryLump> &lumps);
     ~FWadReader();
 
     bool IsIWAD() const;
     bool isUDMF(int lump) const;
+    // the typed form of a TEXTMAP lump, NULL if it only exists as text
+    const FUDMFMap *LumpUDMF(int lump) const;
     int FindLump(const char *name, int index = 0) const;
     int FindMapLump(const char *name, int map) const;
     int FindGLLump(const char *name, int glheader) const;
@@ -55,6 +61,7 @@ class FWadReader {
     WadHeader Header;
     WadLump *Lumps;
     std::ifstream File;
+    const FMemoryLump *Memory;  // NULL when reading from File
 };
 
 template <class T>
@@ -64,6 +71,12 @@ void ReadLump(FWadReader &wad, int index, T *&data, int &size) {
         size = 0;
         return;
     }
+    if (wad.Memory) {
+        size = wad.Memory[index].Size / sizeof(T);
+        data = new T[size];
+        memcpy(data, wad.Memory[index].Data, size * sizeof(T));
+        return;
+    }
     wad.File.seekg(wad.Lumps[index].FilePos);
     if (wad.File.tellg() != wad.Lumps[index].FilePos) {
         throw std::runtime_error("Failed to seek");        
@@ -85,6 +98,8 @@ void ReadMapLump(FWadReader &wad, const char *name, int index, T *&data,
 class FWadWriter {
    public:
     FWadWriter(std::filesystem::path filename, bool iwad);
+    // keeps the lumps in memory, see NumLumps() and GetLump()
+    FWadWriter(bool iwad);
     ~FWadWriter();
 
     void CreateLabel(const char *name);
@@ -92,6 +107,9 @@ class FWadWriter {
     void CopyLump(FWadReader &wad, int lump);
     void Close();
 
+    int NumLumps() const;
+    FMemoryLump GetLump(int index) const;
+
     // Routines to write a lump in segments.
     void StartWritingLump(const char *name);
     void AddToLump(const void *data, int len);
@@ -103,7 +121,13 @@ class FWadWriter {
     FWadWriter &operator<<(fixed_t);
 
    private:
+    void Append(const void *data, int len);
+
+    // lumps are collected in memory and the file is written in one go
+    // by Close().  FilePos and Size are in native byte order here.
     TArray<WadLump> Lumps;
+    std::vector<BYTE> Data;
+    bool IWAD;
     std::ofstream File;
 };
 